@@ -1,29 +1,52 @@
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
 #include "Welcome.h"
 #include "TExaS.h"
 #include "low_level_funcs_tiva.h"
 #include "mid_level_funcs.h"
 #include "high_level_funcs.h"
+#include "flash_log.h"
+#include "boot_timeline.h"
+#include "metrics.h"
 
-// ------------------- Flash memory definitions ----------------------
-//Define Flash
-#define FMA       (*((volatile unsigned long *)0x400FD000))  // Page 542, Base 0x400F.D000, Offset 0X000, flash memory address
-#define FMD       (*((volatile unsigned long *)0x400FD004))  // Page 543, Base 0x400F.D000, Offset 0x004, flash memory data
-#define FMC       (*((volatile unsigned long *)0x400FD008))  // Page 544, Base 0x400F.D000, Offset 0x008, flash memory control
-#define BOOTCFG   (*((volatile unsigned long *)0x400FE1D0))  // Page 581, Base 0x400F.E000, Offset 0x1D0, boot configuration
 #define INPUT_SIZE	17
 
+// ------------------- Flash memory definitions ----------------------
+static FlashLog password_log;  // Records of the password, see flash_log.h
+static int stored_password = PASSWORD_DEFAULT;  // Newest in the log
+
+static void ShowMetrics( void )
+// One metric a screen: any key for the next, # to leave. See metrics.h.
+{
+	char name[METRIC_NAME_SIZE];
+	char value[METRIC_NAME_SIZE];
+	for (int id = 0; id < METRIC_N; id++) {
+		if (!MetricGetName(id, name)) {
+			continue;
+		}
+		MetricGetValue(id, value);
+		ClearDisplay();
+		PrintString( 1, 1, name);
+		PrintString( 2, 1, value);
+		if (GetKeyboardChar() == '#') {
+			break;
+		}
+	}
+	ClearDisplay();
+} // ShowMetrics
+
 void Welcome()
 {
 	TurnCursorOnOff(0);
 	int menu = 1;
   PrintString( 1, 1, ">>>Welcome To<<<");
 	PrintString( 2, 1, ">>>Calculator<<<");
-	WaitMicrosec(3000000);  // Wait 3 s
+	GetKeyboardCharWithin(WELCOME_BANNER_US);  // Up to 3 s, or until any key
+	BootMark("Banner");
 	ClearDisplay();
 	
-	int password = 6666;  // Set default password
-	WritePasswordToFlash(password);
-	Password();
+	Password();  // The default password is used until one is stored
 
 	while(menu == 1) {
 		PrintString( 1, 1, "1->Calculator");
@@ -35,6 +58,8 @@ void Welcome()
 			ClearDisplay();
 		} else if (key == '2') {
 			Reset();
+		} else if (key == 'D') {  // Not offered: for the developers
+			ShowMetrics();
 		}
 	}
 }
@@ -46,14 +71,17 @@ void Password()
 	int word = ReadPasswordFromFlash();
 	char password[5];
 	
-	sprintf( password, "%i", word );
+	for (int i = 3; i >= 0; i--, word /= 10) {  // As typed, with any leading zeros
+		password[i] = '0' + word % 10;
+	}
+	password[4] = '\0';
 	TurnCursorOnOff(0);
 	PrintString( 1, 1, "Enter Password,");
 	PrintString( 2, 1, " Use * to end. ");
 	
 	while(pass == 1) {
 		int check = 0;
-		for(int i = INPUT_SIZE; i >= 0;  i--) {  // Clean the input
+		for(int i = INPUT_SIZE - 1; i >= 0;  i--) {  // Clean the input
         input[i] = '\0';
 		}
 
@@ -61,7 +89,7 @@ void Password()
 		check = CheckValid(input);
 		if (check == 1) {
 /*--------------------------------------------------------------------------------------- */	
-			if (strncmp(input, password) == 0) {
+			if (strcmp(input, password) == 0) {
 				pass = 0;
 				ClearDisplay();
 			} else { 
@@ -98,7 +126,7 @@ void Reset()
 		if (valid == 1) {
 			success = 1;
 			buffer = atoi(reset);
-			WriteDoubleToFlash(buffer);
+			WritePasswordToFlash(buffer);
 			WaitMicrosec(200);
 		} else if (valid == 2) {
 			ClearDisplay();
@@ -140,20 +168,27 @@ int CheckValid(char *word)
 	return result;
 }
 
+void InitPassword()
+{
+	long long value;
+	if (FlashLogOpen(&password_log, PASSWORD_FLASH_ADDRESS, PASSWORD_FLASH_PAGES, &value, sizeof value)) {
+		stored_password = (int)value;
+	} else {
+		stored_password = PASSWORD_DEFAULT;  // Never changed: nothing written
+	}
+} // InitPassword
+
 void WritePasswordToFlash( int number )
 {
-	FMD = number;  // Write the number to the FMD
-	Done_Check(3);
-	FMA = PASSWORD_ADDRESS;  // Choose the flash memory address to store to number
-	FMC |= 0xA4420001;  // Write the value into WRKEY and WRITE field to process the write operation
-	Done_Check(1);
-} // WriteFloatToFlash
+	long long value = number;
+	if (number == stored_password) {
+		return;  // Unchanged: save the flash the wear
+	}
+	FlashLogAppend(&password_log, &value);  // Appends, erasing only when a page fills
+	stored_password = number;
+} // WritePasswordToFlash
 
 int ReadPasswordFromFlash()
 {
-	int read;
-	FMA |= PASSWORD_ADDRESS;  // Choose the flash memory adress
-	Done_Check(1);
-	read = FMD;
-	return read;       // Return the number
-} // ReadFloatFromFlash
\ No newline at end of file
+	return stored_password;  // Found in the log by InitPassword()
+} // ReadPasswordFromFlash
\ No newline at end of file
@@ -1,8 +1,15 @@
 /*! \file Welcome.h
 */
 
+/*! How long the welcome banner is shown, unless a key is pressed
+ *
+ */
+#define WELCOME_BANNER_US	3000000
+
 /*! Display the welcome page and access to password mode
  *
+ * Any key skips the banner. D at the menu, which does not offer it, shows
+ * the metrics (see \a metrics).
  */
 void Welcome( void );
 
@@ -13,11 +20,26 @@ void Password( void );
 
 /*! Address in flash where the password is stored
  *
+ * It is kept in a log of records (see \a flash_log) in the 
+ * PASSWORD_FLASH_PAGES pages from here, just below the answer log.
+ */
+#define PASSWORD_FLASH_ADDRESS	0x0003E800
+#define PASSWORD_FLASH_PAGES	2
+
+/*! The password until the user sets one
+ *
+ */
+#define PASSWORD_DEFAULT	6666
+
+/*! Find the stored password in flash, or use PASSWORD_DEFAULT
+ *
+ * Called by InitAllHardware() while the LCD powers up.
  */
-#define PASSWORD_ADDRESS	0x10
+void InitPassword( void );
 
 /*! Write password to flash memory
  *
+ * Nothing is written if it is the same as the stored one.
  */
 void WritePasswordToFlash( int number );
 
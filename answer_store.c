@@ -0,0 +1,75 @@
+/* answer_store.c
+ *
+ * The last answer, kept in flash with deferred, coalesced writes.
+ *
+ * For documentation, see the corresponding .h file.
+ */
+
+#include <string.h>
+#include "time_source.h"
+#include "flash_log.h"
+#include "low_level_funcs_tiva.h"
+#include "answer_store.h"
+
+#define COMMIT_RETRY_US		1000	// If the flash is still busy.
+
+static FlashLog	answer_log;
+static double	answer = 0.0;	// The newest answer,
+static double	committed = 0.0;	// and the newest in the log.
+static volatile int	pending = 0;
+static SoftTimer	commit_timer;
+
+static void Commit( void )
+// Commit timer callback: start writing the newest answer.
+{
+	if (! pending)
+		return;
+	if (FlashLogBusy( 0 )) { // Do not wait for it in an interrupt.
+		TimerStart( &commit_timer, COMMIT_RETRY_US, Commit );
+		return;
+	}
+	pending = 0;
+	if (memcmp( &answer, &committed, sizeof answer ) == 0)
+		return; // Already there.
+	committed = answer;
+	FlashLogAppendStart( &answer_log, &committed );
+} // Commit
+
+void AnswerStoreOpen( void )
+{
+	TimerStop( &commit_timer );
+	pending = 0;
+	if (! FlashLogOpen( &answer_log, ANSWER_FLASH_ADDRESS, ANSWER_FLASH_PAGES,
+			    &committed, sizeof committed ))
+		committed = 0.0;  // Nothing stored yet
+	answer = committed;
+} // AnswerStoreOpen
+
+void AnswerStoreSet( double value )
+{
+	long	sr = StartCritical();
+	answer = value;
+	pending = 1;
+	TimerStart( &commit_timer, ANSWER_COMMIT_IDLE_US, Commit );
+	EndCritical( sr );
+} // AnswerStoreSet
+
+double AnswerStoreGet( void )
+{
+	return answer;
+} // AnswerStoreGet
+
+int AnswerStorePending( void )
+{
+	return pending || FlashLogBusy( &answer_log );
+} // AnswerStorePending
+
+void AnswerStoreFlush( void )
+{
+	long	sr = StartCritical();
+	TimerStop( &commit_timer );
+	Commit();
+	EndCritical( sr );
+	while (AnswerStorePending())
+		WaitMicrosec( 10 );
+} // AnswerStoreFlush
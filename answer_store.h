@@ -0,0 +1,50 @@
+/*! \file answer_store.h
+ * The last answer, kept in flash across power cycles, with the writes
+ * deferred and coalesced.
+ *
+ * main() stores the answer after every '=' (WriteDoubleToFlash()).
+ * Writing it at once would keep the user waiting for the flash: four word
+ * programs, and sometimes a page erase. Instead the answer is held in RAM
+ * and a commit timer is (re)started. Only when ANSWER_COMMIT_IDLE_US has
+ * passed with no newer answer is the newest one appended to the log in
+ * \a flash_log, and then without waiting: the flash interrupt writes the
+ * record while the user types. So a burst of '=' presses costs one write,
+ * and an answer equal to the one in flash costs none.
+ *
+ * The processor sleeps deeply until the commit timer, and lightly while
+ * the flash is busy, so the RAM copy survives sleep. AnswerStoreFlush()
+ * commits at once, for when power is about to be lost.
+ */
+
+#ifndef ANSWER_STORE_H
+#define ANSWER_STORE_H
+
+#ifndef ANSWER_COMMIT_IDLE_US
+#define ANSWER_COMMIT_IDLE_US	2000000	/* Commit once there has been no
+				 * newer answer for this long. */
+#endif
+
+/*! Find the newest answer in the log. Called by InitFlash().
+ */
+void AnswerStoreOpen( void );
+
+/*! Store an answer: it is written to flash later.
+ *
+ * \param [in] answer The answer.
+ */
+void AnswerStoreSet( double answer );
+
+/*! The newest answer, whether or not it has been written yet.
+ */
+double AnswerStoreGet( void );
+
+/*! Non-zero if the newest answer is not yet (completely) in flash.
+ */
+int AnswerStorePending( void );
+
+/*! Write the newest answer now, if it is pending, and wait until it is in
+ * flash.
+ */
+void AnswerStoreFlush( void );
+
+#endif // of #ifndef ANSWER_STORE_H
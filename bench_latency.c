@@ -0,0 +1,377 @@
+/* bench_latency.c
+ *
+ * Key-to-pixel latency benchmark: main()'s own loop, run on the simulated
+ * hardware in \a host_sim through standard typing scripts, timed in
+ * simulated device microseconds.
+ *
+ * main.c is #included below with its calls renamed to timed wrappers, so
+ * the loop measured is the real one, unmodified. Each script is typed on
+ * freshly powered-up hardware until the keys run out; the key trace (see
+ * \a key_trace) then gives, for every key, the time from its contact
+ * closing to the last byte of its response reaching the LCD:
+ * 	- key to echo, for every key but '=';
+ * 	- '=' to result, broken down along main()'s loop: debouncing the
+ * 		'=', the rest of ReadAndEchoInput(), CalculateAnswer(),
+ * 		DisplayResult() (or DisplayErrorMessage()), the flash write,
+ * 		and the LCD finishing the result (which overlaps the flash
+ * 		write).
+ * The simulator times waits and bus accesses, not computation, so the
+ * calculation itself shows as 0 us.
+ *
+ * The report goes to standard output and to bench_output.txt.
+ *
+ * Build with
+ * 	gcc -std=c99 -DKEY_TRACE_RECORDS=32768 -o bench_latency bench_latency.c
+ * 		host_sim.c virtual_clock.c time_source.c key_events.c crc.c
+ * 		flash_log.c answer_store.c boot_timeline.c ui_snapshot.c
+ * 		format_double.c input_editor.c scheduler.c display_task.c
+ * 		key_trace.c Welcome.c low_level_funcs_tiva.c hal_host.c mid_level_funcs.c
+ * 		high_level_funcs.c calculate_answer.c metrics.c -lm
+ * and run "bench_latency".
+ *
+ * Built with -DSOFT_FLOAT_COUNT and soft_float.c as well, each script's
+ * report ends with the double-precision operations of its calculations and
+ * displays, and their estimated Tiva cycles per expression (see
+ * soft_float.h), which the simulated times above leave out. The cycles of
+ * each operation can be given in a file, e.g. measured on the board, as in
+ * "bench_latency costs.txt"; see SoftFloatSetCosts() for its format.
+ */
+
+#define PROG_NAME_VER		"bench_latency v1.0"
+#define BENCH_REPEATS		50	// Times each script is typed.
+#define BENCH_MAX_CYCLES	400	// Expressions in the longest session.
+#define KEY_HOLD_US		50000	// As test_host_sim: a quick press,
+#define KEY_GAP_US		50000	// ten keys a second.
+#define BENCH_OUTPUT_FILE	"bench_output.txt"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <setjmp.h>
+#include "host_sim.h"
+#include "time_source.h"
+#include "key_events.h"
+#include "key_trace.h"
+#include "high_level_funcs.h"
+#include "low_level_funcs_tiva.h"
+#include "calculate_answer.h"
+#include "soft_float.h"
+
+#if KEY_TRACE_RECORDS < 32768
+#error "Build with -DKEY_TRACE_RECORDS=32768, to trace a whole session."
+#endif
+
+void TimedInitAllHardware( void );
+void TimedReadAndEchoInput( char *input_buffer, int input_buffer_size );
+double TimedCalculateAnswer( char *input_buffer, int input_buffer_size,
+			     int *error_ref_no );
+void TimedDisplayResult( double answer );
+void TimedDisplayErrorMessage( const char *error_message_line1,
+			       const char *error_message_line2 );
+void TimedWriteDoubleToFlash( double number );
+
+#define main			CalculatorMain
+#define InitAllHardware		TimedInitAllHardware
+#define ReadAndEchoInput	TimedReadAndEchoInput
+#define CalculateAnswer		TimedCalculateAnswer
+#define DisplayResult		TimedDisplayResult
+#define DisplayErrorMessage	TimedDisplayErrorMessage
+#define WriteDoubleToFlash	TimedWriteDoubleToFlash
+#include "main.c"
+#undef main
+#undef InitAllHardware
+#undef ReadAndEchoInput
+#undef CalculateAnswer
+#undef DisplayResult
+#undef DisplayErrorMessage
+#undef WriteDoubleToFlash
+
+/* The scripts: each string is typed BENCH_REPEATS times. On the keypad A
+ * is +, B is -, C is ., * is = and # is Rubout; D is Shift, under which A
+ * is x, B is /, C is E and # deletes the whole input. */
+static const struct {
+	const char	*name;
+	const char	*keys;
+} scripts[] = {
+	{ "Short sums",			"12A3*" "45A67*" "8A9B1*" },
+	{ "16-character scientific",	"1C2345DCD6DAD2C55DCDB3*"	// 1.2345E6x2.55E-3
+					"6C02214DCD23DBD1C5DCD1*" },	// 6.02214E23/1.5E1
+	{ "Rubout-heavy edits",		"123##45#6A78##9*" "9876D#D5A4#3*" }
+};
+
+/* Times along each cycle of main()'s loop, in simulated microseconds. */
+typedef struct {
+	unsigned long long	read_end_us;	// ReadAndEchoInput() returned.
+	unsigned long long	calculate_us;	// CalculateAnswer() took.
+	unsigned long long	display_start_us, display_end_us;	// DisplayResult().
+	unsigned long long	flash_us;	// WriteDoubleToFlash() took.
+	int	error_ref_no;
+} Cycle;
+
+static Cycle	cycles[ BENCH_MAX_CYCLES + 1 ];
+static int	n_cycles;
+static const char	*typing;	// The keys to script once booted.
+static unsigned long long	trace_start_us;
+static jmp_buf	idle_jump;
+static FILE	*output;
+
+void Report( const char *format, ... )
+// printf() to standard output and to the output file.
+{
+va_list	args;
+
+	va_start( args, format );
+	vprintf( format, args );
+	va_end( args );
+	if (output != NULL) {
+		va_start( args, format );
+		vfprintf( output, format, args );
+		va_end( args );
+	}
+} // Report
+
+void IdleJump( void )
+{
+	longjmp( idle_jump, 1 );
+} // IdleJump
+
+void TimedInitAllHardware( void )
+{
+	int	i;
+
+	InitAllHardware();
+	KeyTraceStart(); // As InitAllHardware() did, with no time passing.
+	trace_start_us = TimeNowMicrosec();
+	for (i = 0; i < BENCH_REPEATS; i++)
+		SimKeypadType( typing, KEY_GAP_US, KEY_HOLD_US );
+} // TimedInitAllHardware
+
+void TimedReadAndEchoInput( char *input_buffer, int input_buffer_size )
+{
+	ReadAndEchoInput( input_buffer, input_buffer_size );
+	if (n_cycles == BENCH_MAX_CYCLES)
+		IdleJump(); // A script too long for the tables.
+	memset( &cycles[ n_cycles ], 0, sizeof cycles[0] );
+	cycles[ n_cycles ].read_end_us = TimeNowMicrosec();
+} // TimedReadAndEchoInput
+
+double TimedCalculateAnswer( char *input_buffer, int input_buffer_size,
+			     int *error_ref_no )
+{
+	unsigned long long	start_us = TimeNowMicrosec();
+	double	answer = CalculateAnswer( input_buffer, input_buffer_size, error_ref_no );
+
+	cycles[ n_cycles ].calculate_us = TimeNowMicrosec() - start_us;
+	cycles[ n_cycles ].error_ref_no = *error_ref_no;
+	return answer;
+} // TimedCalculateAnswer
+
+void TimedDisplayResult( double answer )
+{
+	cycles[ n_cycles ].display_start_us = TimeNowMicrosec();
+	DisplayResult( answer );
+	cycles[ n_cycles ].display_end_us = TimeNowMicrosec();
+	// The boot answer is displayed before any cycle: WriteDoubleToFlash() ends one.
+} // TimedDisplayResult
+
+void TimedDisplayErrorMessage( const char *error_message_line1,
+			       const char *error_message_line2 )
+{
+	cycles[ n_cycles ].display_start_us = TimeNowMicrosec();
+	DisplayErrorMessage( error_message_line1, error_message_line2 );
+	cycles[ n_cycles ].display_end_us = TimeNowMicrosec();
+	n_cycles ++; // Nothing is written to flash after an error.
+} // TimedDisplayErrorMessage
+
+void TimedWriteDoubleToFlash( double number )
+{
+	unsigned long long	start_us = TimeNowMicrosec();
+
+	WriteDoubleToFlash( number );
+	cycles[ n_cycles++ ].flash_us = TimeNowMicrosec() - start_us;
+} // TimedWriteDoubleToFlash
+
+int CompareTimes( const void *a, const void *b )
+{
+	unsigned long	x = *(const unsigned long *)a, y = *(const unsigned long *)b;
+	return (x > y) - (x < y);
+} // CompareTimes
+
+void ReportRow( const char *what, unsigned long *times, int n )
+// One line of the table: the median and 99th percentile of n times.
+{
+	qsort( times, n, sizeof times[0], CompareTimes );
+	if (n == 0)
+		Report( "\t%-34s%10s%10s\n", what, "-", "-" );
+	else
+		Report( "\t%-34s%10lu%10lu\n", what, times[ (n - 1) / 2 ],
+			times[ (n - 1) * 99 / 100 ] );
+} // ReportRow
+
+unsigned long ResponseEnd( const unsigned char *trace, unsigned long first,
+			   unsigned long n_records, uint32_t from_us, uint32_t to_us,
+			   int bounded )
+/* When the LCD was sent the last byte queued from from_us up to to_us (if
+ * bounded) in trace time, or 0 if none was. Records before first were all
+ * sent before from_us. */
+{
+KeyTraceRecord	record;
+unsigned long	i;
+uint32_t	end_us = 0;
+
+	for (i = first; i < n_records; i++) {
+		uint32_t	queued_us;
+
+		KeyTraceGetRecord( trace, i, &record );
+		if (record.type <= KEY_TRACE_REPEAT)
+			continue;
+		queued_us = record.time_us - record.wait_us;
+		if (bounded && queued_us >= to_us)
+			break; // The LCD's queue is in order: none later is in range.
+		if (queued_us >= from_us)
+			end_us = record.time_us;
+	}
+	return end_us;
+} // ResponseEnd
+
+void RunScript( int s )
+{
+static unsigned char	trace[ KEY_TRACE_EXPORT_SIZE ];
+static unsigned long	times[10][ KEY_TRACE_RECORDS ];
+enum { ECHO, ECHO_READ, ECHO_LCD, RESULT, RESULT_READ, RESULT_EDIT,
+	RESULT_CALCULATE, RESULT_DISPLAY, RESULT_FLASH, RESULT_LCD };
+int	n[10] = { 0 };
+volatile int	n_keys = 0, n_errors = 0, cycle = 0;	// Locals of a setjmp() caller.
+KeyTraceHeader	header;
+KeyTraceRecord	key, next;
+unsigned long	i, j;
+
+	n_cycles = 0;
+	typing = scripts[s].keys;
+#ifdef SOFT_FLOAT_COUNT
+	SoftFloatReset();
+#endif
+	SimReset();
+	SimFlashReset();
+	SimSetIdleHandler( IdleJump );
+	if (setjmp( idle_jump ) == 0)
+		CalculatorMain();
+	KeyTraceParse( trace, KeyTraceExport( trace, sizeof trace ), &header );
+
+	for (i = 0; i < header.n_records; i++) {
+		uint32_t	read_us, next_read_us = 0, end_us;
+		int	bounded = 0;
+
+		KeyTraceGetRecord( trace, i, &key );
+		if (key.type != KEY_TRACE_PRESS && key.type != KEY_TRACE_REPEAT)
+			continue;
+		n_keys ++;
+		read_us = key.time_us + key.wait_us;
+		for (j = i + 1; j < header.n_records && ! bounded; j++) {
+			KeyTraceGetRecord( trace, j, &next );
+			if (next.type <= KEY_TRACE_REPEAT) {
+				next_read_us = next.time_us + next.wait_us;
+				bounded = 1;
+			}
+		}
+		if (key.value != '*') {
+			end_us = ResponseEnd( trace, i + 1, header.n_records, read_us, next_read_us, bounded );
+			if (end_us == 0)
+				continue; // Shift shows nothing.
+			times[ ECHO ][ n[ECHO]++ ] = end_us - key.time_us;
+			times[ ECHO_READ ][ n[ECHO_READ]++ ] = key.wait_us;
+			times[ ECHO_LCD ][ n[ECHO_LCD]++ ] = end_us - read_us;
+		} else if (cycle < n_cycles) {
+			const Cycle	*c = &cycles[ cycle++ ];
+			uint32_t	display_start_us = (uint32_t)(c->display_start_us - trace_start_us);
+			uint32_t	display_end_us = (uint32_t)(c->display_end_us - trace_start_us);
+
+			n_errors += c->error_ref_no != 0;
+			end_us = ResponseEnd( trace, i + 1, header.n_records, display_start_us,
+					      display_end_us + 1, 1 );
+			times[ RESULT ][ n[RESULT]++ ] = end_us - key.time_us;
+			times[ RESULT_READ ][ n[RESULT_READ]++ ] = key.wait_us;
+			times[ RESULT_EDIT ][ n[RESULT_EDIT]++ ] =
+				(unsigned long)(c->read_end_us - trace_start_us) - read_us;
+			times[ RESULT_CALCULATE ][ n[RESULT_CALCULATE]++ ] = c->calculate_us;
+			times[ RESULT_DISPLAY ][ n[RESULT_DISPLAY]++ ] =
+				c->display_end_us - c->display_start_us;
+			times[ RESULT_FLASH ][ n[RESULT_FLASH]++ ] = c->flash_us;
+			times[ RESULT_LCD ][ n[RESULT_LCD]++ ] = end_us - display_end_us;
+		}
+	}
+
+	Report( "\n%s: %d expressions, %d keys, %d errors\n",
+		scripts[s].name, n_cycles, n_keys, n_errors );
+	Report( "\t%-34s%10s%10s\n", "(simulated us)", "p50", "p99" );
+	ReportRow( "Key to echo", times[ ECHO ], n[ECHO] );
+	ReportRow( "  debounced and read", times[ ECHO_READ ], n[ECHO_READ] );
+	ReportRow( "  then on the LCD", times[ ECHO_LCD ], n[ECHO_LCD] );
+	ReportRow( "'=' to result", times[ RESULT ], n[RESULT] );
+	ReportRow( "  debounced and read", times[ RESULT_READ ], n[RESULT_READ] );
+	ReportRow( "  rest of ReadAndEchoInput()", times[ RESULT_EDIT ], n[RESULT_EDIT] );
+	ReportRow( "  CalculateAnswer()", times[ RESULT_CALCULATE ], n[RESULT_CALCULATE] );
+	ReportRow( "  DisplayResult()", times[ RESULT_DISPLAY ], n[RESULT_DISPLAY] );
+	ReportRow( "  WriteDoubleToFlash()", times[ RESULT_FLASH ], n[RESULT_FLASH] );
+	ReportRow( "  then on the LCD", times[ RESULT_LCD ], n[RESULT_LCD] );
+#ifdef SOFT_FLOAT_COUNT
+	{
+		char	report[ 1024 ];
+
+		SoftFloatReport( report, sizeof report );
+		Report( "Soft float, estimated Tiva cycles:\n%s", report );
+	}
+#endif
+} // RunScript
+
+#ifdef SOFT_FLOAT_COUNT
+int ReadCosts( const char *file_name )
+/* Give SoftFloatSetCosts() the text of the file. Returns 0 if it cannot be
+ * read or is not understood. */
+{
+	static char	text[ 4096 ];
+	FILE	*file = fopen( file_name, "r" );
+	size_t	n;
+
+	if (file == NULL)
+		return 0;
+	n = fread( text, 1, sizeof text - 1, file );
+	fclose( file );
+	text[n] = '\0';
+	return SoftFloatSetCosts( text );
+} // ReadCosts
+#endif
+
+int main( int argc, char *argv[] )
+{
+	int	s;
+
+#ifdef SOFT_FLOAT_COUNT
+	if (argc > 2 || (argc == 2 && ! ReadCosts( argv[1] ))) {
+		puts( "FATAL: usage is bench_latency [costs], where the file costs" );
+		puts( "has pairs of an operation and its cycles, e.g. \"div 180\"." );
+		return EXIT_FAILURE;
+	}
+#else
+	(void)argv;
+	if (argc > 1) {
+		puts( "FATAL: usage is bench_latency; build with -DSOFT_FLOAT_COUNT" );
+		puts( "and soft_float.c to give it a file of soft-float costs." );
+		return EXIT_FAILURE;
+	}
+#endif
+	output = fopen( BENCH_OUTPUT_FILE, "w" );
+	Report( "%s\n", PROG_NAME_VER );
+	Report( "Key-to-pixel latency through main()'s loop on simulated hardware.\n" );
+	Report( "Keys held %d us, %d us apart; each script typed %d times.\n",
+		KEY_HOLD_US, KEY_GAP_US, BENCH_REPEATS );
+	for (s = 0; s < (int)(sizeof scripts / sizeof scripts[0]); s++)
+		RunScript( s );
+	if (output == NULL) {
+		printf( "FATAL: cannot write %s\n", BENCH_OUTPUT_FILE );
+		return EXIT_FAILURE;
+	}
+	fclose( output );
+	return EXIT_SUCCESS;
+} // main
@@ -0,0 +1,32 @@
+/* boot_timeline.c
+ *
+ * Marks of when each boot step finished.
+ *
+ * For documentation, see the corresponding .h file.
+ */
+
+#include "time_source.h"
+#include "boot_timeline.h"
+
+static BootStep	steps[ BOOT_MAX_STEPS ];
+static int	n_steps = 0;
+
+void BootTimelineReset( void )
+{
+	n_steps = 0;
+} // BootTimelineReset
+
+void BootMark( const char *name )
+{
+	if (n_steps >= BOOT_MAX_STEPS)
+		return;
+	steps[ n_steps ].name = name;
+	steps[ n_steps ].done_us = TimeNowMicrosec();
+	n_steps ++;
+} // BootMark
+
+int BootGetTimeline( const BootStep **steps_out )
+{
+	*steps_out = steps;
+	return n_steps;
+} // BootGetTimeline
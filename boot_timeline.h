@@ -0,0 +1,45 @@
+/*! \file boot_timeline.h
+ * When each step of the boot sequence finished.
+ *
+ * InitAllHardware() marks the end of each of its steps with BootMark(),
+ * and Welcome() marks the end of the banner. The marks are times on the
+ * time source's clock, which starts in InitTimeSource(), so the first step
+ * (the clock itself) is at or near 0. They show how long power-on takes to
+ * reach the first usable keystroke, and where that time goes.
+ *
+ * The steps are ordered so that the slow one, the LCD's power-up wait, is
+ * overlapped with the others: InitLCD() waits until LCD_POWER_ON_US after
+ * the clock started, not for a fixed time after it is called.
+ */
+
+#ifndef BOOT_TIMELINE_H
+#define BOOT_TIMELINE_H
+
+#define BOOT_MAX_STEPS	12
+
+/*! One step of the boot sequence.
+ */
+typedef struct {
+	const char	*name;		//!< What was done.
+	unsigned long long	done_us;	//!< TimeNowMicrosec() when it finished.
+} BootStep;
+
+/*! Forget the marks: the start of a boot.
+ */
+void BootTimelineReset( void );
+
+/*! Record that a step has just finished. Steps beyond BOOT_MAX_STEPS are
+ * ignored.
+ *
+ * \param [in] name What was done: a string constant, which is not copied.
+ */
+void BootMark( const char *name );
+
+/*! Get the timeline.
+ *
+ * \param [out] steps The steps, in the order they finished.
+ * \return How many there are.
+ */
+int BootGetTimeline( const BootStep **steps );
+
+#endif // of #ifndef BOOT_TIMELINE_H
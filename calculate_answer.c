@@ -62,9 +62,18 @@
 #endif
 #include <string.h>
 #include <math.h>
+#include <stdint.h>
 #include "calculate_answer.h"
+#include "metrics.h"
+#include "trace_events.h"
+#include "soft_float.h"
 
 
+#ifdef INPUT_BUFFER_SIZE	/* Set for the whole build (see main.c), for 
+		inputs longer than a line: at most a number and an operator 
+		in every two characters. */
+#define MAX_NUMS_AND_OPS	(INPUT_BUFFER_SIZE / 2 + 4)
+#else
 #define MAX_NUMS_AND_OPS	20	/* Maximum number of numbers, 
 		which is also the maximum number of operators, which function 
 		CalculateAnswer() can handle. The densest these can be is with 
@@ -76,14 +85,41 @@
 		than 16 numbers and 16 operators. Setting MAX_NUMS_AND_OPS to 
 		this, or slightly more for caution (minor effects not properly 
 		understood), is safe. */
+#endif
+#ifdef INPUT_BUFFER_SIZE
+#define NUMBER_CHARS	(INPUT_BUFFER_SIZE + 1)	// A number as long as the input, and a null.
+#else
+#define NUMBER_CHARS	100	// Far more than enough for a line.
+#endif
+#define TOKEN_LOOP_LIMIT	(2 * MAX_NUMS_AND_OPS + 2)	/* Passes of 
+		IdentifyTokens(), which would each take a number and an 
+		operator. */
+#if MAX_NUMS_AND_OPS > 255
+#error "MAX_NUMS_AND_OPS must fit the unsigned char counts of ParsedExpression."
+#endif
+#define USED_BITS	32	// In each word of ParsedExpression.used.
+#define USED_WORDS	((MAX_NUMS_AND_OPS + USED_BITS - 1) / USED_BITS)
+
+/* The numbers and operators, packed: number i is followed in the input by 
+ * infix_operator[i], so a number and its operator share an index, as does 
+ * its bit in used. The doubles come first, so there is no padding between 
+ * them and the bytes; the counts are bytes, and the used flags one bit 
+ * each, in 32-bit words whatever the width of long. A word is cleared by 
+ * ExtractNumber() as its first number arrives, so there is no separate 
+ * reset. The structure is only ever passed by pointer, never copied. */
 typedef struct {
 	double	number[ MAX_NUMS_AND_OPS ];
-	int	n_numbers;
 	char	infix_operator[ MAX_NUMS_AND_OPS ];
-	int	n_infix_operators;
-	char	num_and_op_used[ MAX_NUMS_AND_OPS ]; // char used as Boolean.
+	unsigned char	n_numbers;
+	unsigned char	n_infix_operators;
+	uint32_t	used[ USED_WORDS ];	// Bit per number and its operator.
 } ParsedExpression;
 
+#define IsUsed( parsed_expression, i ) \
+	(((parsed_expression)->used[ (i) / USED_BITS ] >> ((i) % USED_BITS)) & 1)
+#define SetUsed( parsed_expression, i ) \
+	((parsed_expression)->used[ (i) / USED_BITS ] |= (uint32_t)1 << ((i) % USED_BITS))
+
 
 int IsOperator( char ch )
 {
@@ -204,7 +240,7 @@ void ExtractNumber( char *input_buffer, int *ch_no, int buf_len,
  * then use sscanf to convert it froom string to double.
  */
 {
-char	num_as_string[100] = ""; // Far more than enough.
+char	num_as_string[ NUMBER_CHARS ] = "";
 int	next_ch_no = 0,		// Position within num_as_string.
 	n_dots_found = 0, num_is_ended = 0, n_convs;
 double	number_read;
@@ -248,6 +284,11 @@ double	number_read;
 				 * the digit stuff: */
 			case '0': case '1': case '2': case '3': case '4':
 			case '5': case '6': case '7': case '8': case '9': 
+				if (next_ch_no >= NUMBER_CHARS - 1) { /* Longer 
+						than any input can be. */
+					*error_ref_no = 6; // "Invalid number" ""
+					return;
+				}
 				num_as_string[ next_ch_no++ ] = this_ch;
 				(*ch_no) ++; /* Only if still going, note, 
 						not in the default: below. */
@@ -282,13 +323,16 @@ double	number_read;
 	}
 	
 	// Valid number: convert from string to double:
+	SoftFloatCount( SOFT_SSCANF ); // See soft_float.h
 	n_convs = sscanf( num_as_string, "%lf", &number_read );
 	if (n_convs != 1) { // Invalid number
 		*error_ref_no = 6; // "Invalid number" ""
 		return;
 	}
 	
-	// Valid: record it:
+	// Valid: record it, starting its word of used bits if it is the first:
+	if (parsed_expression->n_numbers % USED_BITS == 0)
+		parsed_expression->used[ parsed_expression->n_numbers / USED_BITS ] = 0;
 	parsed_expression->number[ parsed_expression->n_numbers++ ] = number_read;
 } // ExtractNumber
 
@@ -327,22 +371,22 @@ void ExtractOperator( char *input_buffer, int *ch_no, int buf_len,
 } // ExtractOperator
 
 #if RUNNING_ON_PC
-void PrintTokens( ParsedExpression parsed_expression )
+void PrintTokens( const ParsedExpression *parsed_expression )
 // Useful debugging routine.
 {
 int	i;
-	printf( "%d numbers:", parsed_expression.n_numbers );
-	for (i=0; i < parsed_expression.n_numbers; i++ ) {
+	printf( "%d numbers:", parsed_expression->n_numbers );
+	for (i=0; i < parsed_expression->n_numbers; i++ ) {
 		/* Print the number, but with square brackets round it 
 		 * if it has been used. */
 	char	brack1 = '[', brack2 = ']';
-		if (! parsed_expression.num_and_op_used[i])
+		if (! IsUsed( parsed_expression, i ))
 			brack1 = brack2 = ' ';
-		printf( "\t%c%g%c", brack1, parsed_expression.number[i], brack2 );
+		printf( "\t%c%g%c", brack1, parsed_expression->number[i], brack2 );
 	}
-	printf( "\n%d operators:", parsed_expression.n_infix_operators );
-	for (i=0; i < parsed_expression.n_infix_operators; i++ )
-		printf( "\t    \'%c\'", parsed_expression.infix_operator[i] );
+	printf( "\n%d operators:", parsed_expression->n_infix_operators );
+	for (i=0; i < parsed_expression->n_infix_operators; i++ )
+		printf( "\t    \'%c\'", parsed_expression->infix_operator[i] );
 	putchar( '\n' );
 } // PrintTokens
 #endif
@@ -359,10 +403,10 @@ int	i, ch_no = 0, buf_len = strlen( input_buffer ); /* SyntaxCheckStage1
 	 * As an extra precaution against looping infinitely, however, it is 
 	 * a for loop which quits if it goes round too often. The maximum 
 	 * number of times it should be able to go round is for one number 
-	 * or operator per character of the input buffer. That buffer can be at 
-	 * most 32 chars (2x16 display). The for loop limit is slightly more 
-	 * than this. */
-	for (i=1; i < 35; i++) { // Normally breaks from inside.
+	 * or operator per character of the input buffer, which is at most 
+	 * MAX_NUMS_AND_OPS numbers and as many operators. The for loop limit 
+	 * is slightly more than this. */
+	for (i=1; i < TOKEN_LOOP_LIMIT; i++) { // Normally breaks from inside.
 	//while(1) { // Breaks from inside.
 		ExtractNumber( input_buffer, &ch_no, buf_len, 
 			       parsed_expression, error_ref_no );
@@ -374,7 +418,7 @@ int	i, ch_no = 0, buf_len = strlen( input_buffer ); /* SyntaxCheckStage1
 		if (*error_ref_no != 0) return;	// No point in further processing.
 		if (ch_no >= buf_len) break;	// Input finished.
 	} // for
-	if (i >= 35) { // Software bug: loop ended.
+	if (i >= TOKEN_LOOP_LIMIT) { // Software bug: loop ended.
 #if RUNNING_ON_PC
 		puts( "SOFTWARE BUG: calculate_answer/IdentifyTokens() "
 			"loop ends." )
@@ -385,20 +429,20 @@ int	i, ch_no = 0, buf_len = strlen( input_buffer ); /* SyntaxCheckStage1
 	}
 	
 #if DEBUG >= 5
-	PrintTokens( *parsed_expression );
+	PrintTokens( parsed_expression );
 #endif
 } // IdentifyTokens
 
-void SyntaxCheckStage3( ParsedExpression parsed_expression, int *error_ref_no )
+void SyntaxCheckStage3( const ParsedExpression *parsed_expression, int *error_ref_no )
 /* Highly specific check: for two adjacent Es.
  * NB - whereas the previous SyntaxChecks examined the input buffer, 
  * this one examines the parsed_expression list of operators.
  */
 {
 int	i;
-	for (i=0; i < parsed_expression.n_infix_operators-1; i++)
-		if (  parsed_expression.infix_operator[i] == 'E'
-		   && parsed_expression.infix_operator[i+1] == 'E') {
+	for (i=0; i < parsed_expression->n_infix_operators-1; i++)
+		if (  parsed_expression->infix_operator[i] == 'E'
+		   && parsed_expression->infix_operator[i+1] == 'E') {
 			*error_ref_no = 10;
 			return;
 		}
@@ -421,19 +465,18 @@ double	num1 = parsed_expression->number[ this_index ],
 	num2 = parsed_expression->number[ next_index ];
 	switch (op) {
 		case '+':
-			parsed_expression->number[ next_index ] = num1 + num2;
+			parsed_expression->number[ next_index ] = DAdd( num1, num2 );
 			break;
 		case '-':
-			parsed_expression->number[ next_index ] = num1 - num2;
+			parsed_expression->number[ next_index ] = DSub( num1, num2 );
 			break;
 		case 'x':
-			parsed_expression->number[ next_index ] = num1 * num2;
+			parsed_expression->number[ next_index ] = DMul( num1, num2 );
 			break;
 		case '/':
-			parsed_expression->number[ next_index ] = num1 / num2;
+			parsed_expression->number[ next_index ] = DDiv( num1, num2 );
 			break;
 		case 'E': 
-			parsed_expression->number[ next_index ] = num1 *
 /* TO-DO: replace this by loop:	/* There is now an annoying detail.
 				 * This operator requires a way of raising 
 				 * 10 to an integer power. The simple way is 
@@ -445,18 +488,19 @@ double	num1 = parsed_expression->number[ this_index ],
 				 * See the definition of USE_TEN_TO_POWER 
 				 * above. */
 #if USE_TEN_TO_POWER
-							 pow( 10.0, num2 ); 
+			parsed_expression->number[ next_index ] = DMul( num1,
+							 DPow( 10.0, num2 ) );
 #else
-							 1.0;
+			parsed_expression->number[ next_index ] = DMul( num1, 1.0 );
 #endif
 			break;
 	} // switch
 	
-	parsed_expression->num_and_op_used[ this_index ] = 1; // Record as used.
+	SetUsed( parsed_expression, this_index ); // Record as used.
 	
 #if DEBUG >= 6
 	printf( "After merge t=%d, n=%d, %c:\n", this_index, next_index, op );
-	PrintTokens( *parsed_expression );
+	PrintTokens( parsed_expression );
 #endif
 } // MergeNumbers
 
@@ -473,9 +517,9 @@ int	this_index, next_index, found;
 		// Find the next unused number to merge into it:
 		found = 0;
 		for (next_index=this_index+1; 
-		     		next_index <= parsed_expression->n_numbers;
+		     		next_index < parsed_expression->n_numbers;
 		     				next_index++) {
-			if (! parsed_expression->num_and_op_used[ next_index ] ) {
+			if (! IsUsed( parsed_expression, next_index )) {
 				found = 1;
 				break;
 			} // if
@@ -498,57 +542,37 @@ int	this_index, next_index, found;
 	} // outer for
 } // EvaluateExpressionForOneOperator
 
-double EvaluateExpression( ParsedExpression parsed_expression, int *error_ref_no )
+double EvaluateExpression( ParsedExpression *parsed_expression, int *error_ref_no )
 /* The algorithm is to go along the set of numbers linked by binary operators 
  * repeatedly, merging two adjacent numbers with the operator.
  * E.g. 2+3 becomes <used>+5.
  * Numbers which have already been used are ignored; the fact that they 
- * are used is known by an extra array (also in parsed_expression) called 
- * num_and_op_used.
+ * are used is known by an extra bit set (also in parsed_expression) called 
+ * used.
  * It applies to each number and the following operator (which has the same 
  * array index.)
  * This is done in the order of execution: E, /, x, +, -.
  * Within each of these it is left-to-right.
  */
 {
-int	i;
-	// Init the number_used array to show no numbers have been used.
-	for (i=0; i < MAX_NUMS_AND_OPS/*Init all, not just those used.*/; i++) 
-		parsed_expression.num_and_op_used[i] = 0;
+	/* The used bits already show no numbers have been used: ExtractNumber() 
+	 * cleared them. */
 	
 	// Evaluate in order:
-	EvaluateExpressionForOneOperator( &parsed_expression, 'E', error_ref_no );
-	EvaluateExpressionForOneOperator( &parsed_expression, '/', error_ref_no );
-	EvaluateExpressionForOneOperator( &parsed_expression, 'x', error_ref_no );
-	EvaluateExpressionForOneOperator( &parsed_expression, '+', error_ref_no );
-	EvaluateExpressionForOneOperator( &parsed_expression, '-', error_ref_no );
+	EvaluateExpressionForOneOperator( parsed_expression, 'E', error_ref_no );
+	EvaluateExpressionForOneOperator( parsed_expression, '/', error_ref_no );
+	EvaluateExpressionForOneOperator( parsed_expression, 'x', error_ref_no );
+	EvaluateExpressionForOneOperator( parsed_expression, '+', error_ref_no );
+	EvaluateExpressionForOneOperator( parsed_expression, '-', error_ref_no );
 	
 	/* There should now be nothing left except the number in the last 
-	 * element of parsed_expression.number, which is the answer.
+	 * element of parsed_expression->number, which is the answer.
 	 */
-	return parsed_expression.number[ parsed_expression.n_numbers-1 ];
+	return parsed_expression->number[ parsed_expression->n_numbers-1 ];
 } // EvaluateExpression
 
-/*! Parse the input from keyboard and produce either the answer or an error message.
- * 
- * \param [in] input_buffer A string with the characters read from keyboard.
- * 		This should be C-format, i.e. an array of \a char terminated with 
- * 		a null.
- * \param [in] input_buffer_size The size of the \a input_buffer array. The software 
- * 		will not read \a input_buffer beyond this. This is a precaution 
- * 		agains \a input_buffer lacking its terminating null.
- * \param [out] error_ref_no The reference number of the error, if any. 
- * 		If there is no error, this is set to zero. If there is an error, 
- * 		this number can be used to subscript the two arrays 
- * 		\a error_message_line1 and \a error_message_line2 to produce an 
- * 		error message.
- * \return If there was no error, the result of the calculation is returned. 
- * 		If there was an error, 0.0 is returned.
- * 
- * For the functional specification, see the documentation of this function 
- * in calculate_answer.h.
- */
-double CalculateAnswer( char *input_buffer, int input_buffer_size, int *error_ref_no )
+static double Calculate( char *input_buffer, int input_buffer_size, int *error_ref_no )
+// CalculateAnswer(), less the metrics.
 {
 double	answer = 0.0;	// Initialise to something safe.
 ParsedExpression	parsed_expression;
@@ -556,30 +580,77 @@ ParsedExpression	parsed_expression;
 	*error_ref_no = 0; // Presumed innocent until found guilty.
 
 	// Basic syntax checks:
+	TraceBegin( "SyntaxCheckStage1" );
 	SyntaxCheckStage1( input_buffer, input_buffer_size, error_ref_no );
+	TraceEnd( "SyntaxCheckStage1" );
 	if (*error_ref_no != 0)
 		return 0.0; // Even if it won't be used, the result should be defined.
 	
 	// No operator errors (e.g. two together):
+	TraceBegin( "SyntaxCheckStage2" );
 	SyntaxCheckStage2( input_buffer, error_ref_no );
+	TraceEnd( "SyntaxCheckStage2" );
 	if (*error_ref_no != 0)
 		return 0.0; // Even if it won't be used, the result should be defined.
 	
 	/* Parse the input string into tokens (representing numbers 
 	 * and operators such as +, x): */
 	parsed_expression.n_numbers = parsed_expression.n_infix_operators = 0; /* /* CHK: are both needed? */
+	TraceBegin( "IdentifyTokens" );
 	IdentifyTokens( input_buffer, error_ref_no, &parsed_expression );
+	TraceEnd( "IdentifyTokens" );
 	if (*error_ref_no != 0)
 		return 0.0; // Even if it won't be used, the result should be defined.
+	MetricAdd( TOKENS, parsed_expression.n_numbers + parsed_expression.n_infix_operators );
+	MetricSet( LAST_TOKENS, parsed_expression.n_numbers + parsed_expression.n_infix_operators );
 	
 	/* There should not be two E operators following each other 
 	 * (e.g. 12.E3E4). This is easier to test once the input has been 
 	 * parsed into tokens: */
-	SyntaxCheckStage3( parsed_expression, error_ref_no );
+	TraceBegin( "SyntaxCheckStage3" );
+	SyntaxCheckStage3( &parsed_expression, error_ref_no );
+	TraceEnd( "SyntaxCheckStage3" );
 	
 	// The input string is now known to be valid, so evaluate it:
-	answer = EvaluateExpression( parsed_expression, error_ref_no );
+	TraceBegin( "EvaluateExpression" );
+	answer = EvaluateExpression( &parsed_expression, error_ref_no );
+	TraceEnd( "EvaluateExpression" );
 	
+	return answer;
+} // Calculate
+
+/*! Parse the input from keyboard and produce either the answer or an error message.
+ * 
+ * \param [in] input_buffer A string with the characters read from keyboard.
+ * 		This should be C-format, i.e. an array of \a char terminated with 
+ * 		a null.
+ * \param [in] input_buffer_size The size of the \a input_buffer array. The software 
+ * 		will not read \a input_buffer beyond this. This is a precaution 
+ * 		agains \a input_buffer lacking its terminating null.
+ * \param [out] error_ref_no The reference number of the error, if any. 
+ * 		If there is no error, this is set to zero. If there is an error, 
+ * 		this number can be used to subscript the two arrays 
+ * 		\a error_message_line1 and \a error_message_line2 to produce an 
+ * 		error message.
+ * \return If there was no error, the result of the calculation is returned. 
+ * 		If there was an error, 0.0 is returned.
+ * 
+ * For the functional specification, see the documentation of this function 
+ * in calculate_answer.h.
+ */
+double CalculateAnswer( char *input_buffer, int input_buffer_size, int *error_ref_no )
+{
+double	answer;
+
+	TraceBegin( "CalculateAnswer" ); // See trace_events.h
+	SoftFloatExpression();
+	answer = Calculate( input_buffer, input_buffer_size, error_ref_no );
+	TraceEnd( "CalculateAnswer" );
+	MetricCount( EXPRESSIONS ); // See metrics.h
+	if (*error_ref_no != 0) {
+		MetricCount( ERRORS );
+		MetricCountError( *error_ref_no );
+	}
 	return answer;
 } // CalculateAnswer
 
@@ -0,0 +1,29 @@
+/* crc.c
+ *
+ * CRC-32, a nibble at a time.
+ *
+ * For documentation, see the corresponding .h file.
+ */
+
+#include "crc.h"
+
+static const unsigned long	crc_nibble_table[16] = {
+	/* The reflected polynomial 0xEDB88320 applied to each 4-bit value. */
+	0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+	0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+	0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+	0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+unsigned long Crc32( const void *data, unsigned int length, unsigned long crc )
+{
+	const unsigned char	*byte = (const unsigned char *)data;
+
+	crc = ~crc & 0xFFFFFFFF;
+	while (length--) {
+		crc ^= *byte++;
+		crc = (crc >> 4) ^ crc_nibble_table[ crc & 0x0F ];
+		crc = (crc >> 4) ^ crc_nibble_table[ crc & 0x0F ];
+	}
+	return ~crc & 0xFFFFFFFF;
+} // Crc32
@@ -0,0 +1,25 @@
+/*! \file crc.h
+ * CRC-32 (the IEEE 802.3 polynomial, as used by zip and Ethernet), for
+ * checking records and snapshots kept in flash.
+ *
+ * The TM4C123 has no CRC hardware, so this is computed a nibble at a time
+ * from a 16-entry table: 64 bytes of flash rather than the 1 KB of a
+ * byte-wide table, for about half the speed.
+ */
+
+#ifndef CRC_H
+#define CRC_H
+
+/*! The CRC-32 of \a length bytes at \a data.
+ *
+ * \param [in] data The bytes.
+ * \param [in] length How many.
+ * \param [in] crc 0 to start, or the result of the previous call to
+ * 		continue over more data.
+ * \return The CRC so far.
+ *
+ * Crc32( "123456789", 9, 0 ) is 0xCBF43926.
+ */
+unsigned long Crc32( const void *data, unsigned int length, unsigned long crc );
+
+#endif // of #ifndef CRC_H
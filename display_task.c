@@ -0,0 +1,404 @@
+/* display_task.c
+ *
+ * The LCD's bytes, queued by the display functions and sent by the display
+ * task on a software timer, with effects played between them.
+ *
+ * For documentation, see the corresponding .h file.
+ */
+
+#include <string.h>
+#include "time_source.h"
+#include "scheduler.h"
+#include "low_level_funcs_tiva.h"
+#include "key_trace.h"
+#include "metrics.h"
+#include "trace_events.h"
+#include "display_task.h"
+
+#define SIGNAL_QUEUED	0	// From DisplaySend(), when the task was not sending.
+#define SIGNAL_READY	1	// From the pacing timer.
+#define SIGNAL_FLASH	2	// From DisplayFlash() or the flash timer: blank or restore.
+#define SIGNAL_MESSAGE	3	// From DisplayMessage(): show it.
+#define SIGNAL_MESSAGE_OVER	4	// From the message timer: restore the line.
+
+#define DDRAM_LINE	40	// DDRAM characters a line holds, in 2-line mode.
+#define SHOWN_LENGTH	16	// Characters of a line shown at a time.
+#define DISPLAY_CONTROL	0x08	// Display Control instructions are 00001DCB,
+#define DISPLAY_ON	0x04	// and D turns the display on.
+#define EFFECT_BYTES	(SHOWN_LENGTH + 3)	/* Set address, 16 characters with
+				 * another set address where the line wraps,
+				 * and the address put back. */
+
+typedef struct {
+	unsigned char	byte, instruction_or_data;
+	unsigned short	hold;	// In DISPLAY_HOLD_UNIT_US.
+	unsigned long	queued_us;	// Low 32 bits of TimeNowMicrosec(), for the trace.
+} DisplayEntry;
+
+static DisplayEntry	queue[ DISPLAY_QUEUE_SIZE ];
+static volatile unsigned int	head = 0;	// Next slot to fill. Written only by DisplaySend().
+static volatile unsigned int	tail = 0;	// Next to send. Written only by the task.
+static volatile int	sending = 0;	// The task is sending a byte, and takes the next itself.
+static int	started = 0;
+static int	low_next = 0;	// The current byte has had its high nibble.
+static DisplayEntry	current;	// The byte being sent,
+static int	current_effect;	// and whether it is an effect's.
+static SoftTimer	pace_timer, flash_timer, message_timer;
+
+/* The LCD as the display functions have left it, followed from the bytes
+ * sent. Effects' bytes are not followed: each effect leaves it as it was. */
+static struct {
+	unsigned char	control;	// The last Display Control instruction.
+	unsigned char	address;	// The DDRAM address counter.
+	unsigned char	shift;		// The display shift: the first cell shown.
+	char	ddram[2][ DDRAM_LINE ];
+} lcd;
+
+/* The effects, each a state machine stepped by its own timer. The bytes
+ * of a step are sent together, between two of the queue's. */
+static DisplayEntry	effect[ EFFECT_BYTES ];
+static int	n_effect = 0, i_effect = 0;	// Effect bytes built, and sent.
+static volatile int	flash_due = 0, message_due = 0;	// A step is waiting for the task.
+static volatile int	flash_steps = 0;	// Blankings and restorings left.
+static unsigned long	flash_step_us;
+static int	hidden = 0;	// The flash has blanked the display.
+static volatile enum {
+	NO_MESSAGE,	// The line shows what the display functions wrote.
+	MESSAGE_DUE,	// From DisplayMessage(), to be written.
+	MESSAGE_SHOWN,	// Written, waiting for the message timer.
+	MESSAGE_OVER	// The line is to be restored.
+} message_state = NO_MESSAGE;
+static char	message[ SHOWN_LENGTH ];
+static unsigned char	message_line;	// 0 or 1.
+static unsigned char	message_first;	// The first cell it covers,
+static int	message_written = 0;	// once it has been written.
+static unsigned long	message_us;
+
+static void Paced( void )
+// Pacing timer callback: the LCD is ready for the next nibble.
+{
+	SchedulerPost( TASK_DISPLAY, SIGNAL_READY );
+} // Paced
+
+static void FlashTimed( void )
+{
+	SchedulerPost( TASK_DISPLAY, SIGNAL_FLASH );
+} // FlashTimed
+
+static void MessageTimed( void )
+{
+	SchedulerPost( TASK_DISPLAY, SIGNAL_MESSAGE_OVER );
+} // MessageTimed
+
+static unsigned char NextAddress( unsigned char address, int increment )
+// Step the address counter as the HD44780 does in 2-line mode.
+{
+	if (increment)
+		return (address == 0x27) ? 0x40 : (address == 0x67) ? 0x00 : address + 1;
+	return (address == 0x00) ? 0x67 : (address == 0x40) ? 0x27 : address - 1;
+} // NextAddress
+
+static void Track( unsigned char byte, unsigned char instruction_or_data )
+/* Follow the address counter, shift and DDRAM from a byte sent. Entry mode
+ * is taken to be increment without shift, as InitLCD() sets it. */
+{
+	if (instruction_or_data) {
+		lcd.ddram[ lcd.address >> 6 ][ (lcd.address & 0x3F) % DDRAM_LINE ] = byte;
+		lcd.address = NextAddress( lcd.address, 1 );
+	} else if (byte & 0x80) {	// Set DDRAM address.
+		lcd.address = byte & 0x7F;
+	} else if ((byte & 0xF0) == 0x10) {	// Cursor or display shift.
+		if (byte & 0x08)
+			lcd.shift = (lcd.shift + ((byte & 0x04) ? DDRAM_LINE - 1 : 1)) % DDRAM_LINE;
+		else	lcd.address = NextAddress( lcd.address, byte & 0x04 );
+	} else if (byte == 0x01 || (byte & 0xFE) == 0x02) {	// Clear, or return home.
+		if (byte == 0x01)
+			memset( lcd.ddram, ' ', sizeof lcd.ddram );
+		lcd.address = 0;
+		lcd.shift = 0;
+	}
+} // Track
+
+static void Sent( void )
+// The current byte has reached the LCD.
+{
+	KeyTraceDisplay( current.byte, current.instruction_or_data, current.queued_us );
+	MetricCount( LCD_BYTES );
+	if (! current_effect)
+		Track( current.byte, current.instruction_or_data );
+} // Sent
+
+static void AddEffect( unsigned char byte, unsigned char instruction_or_data )
+{
+	effect[ n_effect ].byte = byte;
+	effect[ n_effect ].instruction_or_data = instruction_or_data;
+	effect[ n_effect ].hold = 0;
+	effect[ n_effect++ ].queued_us = (unsigned long)TimeNowMicrosec();
+} // AddEffect
+
+static void WriteCells( const char *text )
+/* Build the bytes which write the message's cells with text, or with what
+ * the display functions left there if text is 0, and put the address
+ * counter back. */
+{
+	int	c, cell;
+
+	for (c = 0; c < SHOWN_LENGTH; c++) {
+		cell = (message_first + c) % DDRAM_LINE;
+		if (c == 0 || cell == 0)
+			AddEffect( 0x80 | (message_line * 0x40 + cell), 0 );
+		AddEffect( text ? text[c] : lcd.ddram[ message_line ][ cell ], 1 );
+	}
+	AddEffect( 0x80 | lcd.address, 0 );
+} // WriteCells
+
+static void FlashStep( void )
+// Blank the display, or restore it as the display functions last set it.
+{
+	if (flash_steps == 0)
+		return;
+	hidden = ! hidden;
+	AddEffect( hidden ? lcd.control & ~DISPLAY_ON : lcd.control, 0 );
+	if (--flash_steps)
+		TimerStart( &flash_timer, flash_step_us, FlashTimed );
+} // FlashStep
+
+static void MessageStep( void )
+{
+	if (message_state == MESSAGE_DUE) {
+		if (! message_written) {
+			message_first = lcd.shift; // The cells shown now.
+			message_written = 1;
+		}
+		WriteCells( message );
+		message_state = MESSAGE_SHOWN;
+		TimerStart( &message_timer, message_us, MessageTimed );
+	} else if (message_state == MESSAGE_OVER) {
+		WriteCells( 0 );
+		message_written = 0;
+		message_state = NO_MESSAGE;
+	}
+} // MessageStep
+
+static int NextByte( void )
+// Take the next byte to send, an effect's before the queue's: 0 if none.
+{
+	if (i_effect == n_effect) {
+		n_effect = i_effect = 0;
+		if (flash_due) {
+			flash_due = 0;
+			FlashStep();
+		} else if (message_due) {
+			message_due = 0;
+			MessageStep();
+		}
+	}
+	current_effect = i_effect < n_effect;
+	if (current_effect) {
+		current = effect[ i_effect++ ];
+		return 1;
+	}
+	if (tail == head)
+		return 0;
+	current = queue[ tail ];
+	tail = (tail + 1) & (DISPLAY_QUEUE_SIZE - 1); // Free for DisplaySend().
+	if (! current.instruction_or_data && (current.byte & 0xF8) == DISPLAY_CONTROL) {
+		lcd.control = current.byte;
+		if (hidden)
+			current.byte &= ~DISPLAY_ON; // Shown when the flash restores it.
+	}
+	return 1;
+} // NextByte
+
+void DisplayTask( unsigned char signal )
+{
+	if (signal == SIGNAL_FLASH)
+		flash_due = 1;
+	else if (signal == SIGNAL_MESSAGE)
+		message_due = 1;
+	else if (signal == SIGNAL_MESSAGE_OVER && message_state == MESSAGE_SHOWN) {
+		message_state = MESSAGE_OVER;
+		message_due = 1;
+	}
+	if (TimerIsActive( &pace_timer ))
+		return; // Mid-byte: the timer carries on, and the next byte picks this up.
+	if (low_next) {
+		WriteDisplayNibble( current.byte & 0x0F, current.instruction_or_data );
+		Sent();
+		TimerStart( &pace_timer, DISPLAY_NIBBLE_US + current.hold * DISPLAY_HOLD_UNIT_US,
+			    Paced );
+		low_next = 0;
+		return;
+	}
+	if (sending)
+		TraceEndOn( TRACE_TRACK_LCD, "" ); // The LCD is ready after the last byte.
+	if (! NextByte()) {
+		sending = 0;
+		return;
+	}
+	sending = 1;
+	TraceBeginOn( TRACE_TRACK_LCD, current.instruction_or_data ? "Data" : "Instruction",
+		      current.byte );
+	WriteDisplayNibble( current.byte >> 4, current.instruction_or_data );
+	low_next = 1;
+	TimerStart( &pace_timer, DISPLAY_NIBBLE_US, Paced );
+} // DisplayTask
+
+static void SendNow( unsigned long hold_us )
+// Send the current byte at once and wait, as SendDisplayByte() always has.
+{
+	TraceBeginOn( TRACE_TRACK_LCD, current.instruction_or_data ? "Data" : "Instruction",
+		      current.byte );
+	SendDisplayNibble( current.byte >> 4, current.instruction_or_data );
+	WaitMicrosec( 200 );
+	SendDisplayNibble( current.byte & 0x0F, current.instruction_or_data );
+	current.queued_us = (unsigned long)TimeNowMicrosec();
+	Sent();
+	WaitMicrosec( 200 );
+	WaitMicrosec( hold_us );
+	TraceEndOn( TRACE_TRACK_LCD, "" );
+} // SendNow
+
+static void SendEffectNow( void )
+// Send the effect's bytes at once, before the task has started.
+{
+	current_effect = 1;
+	for (i_effect = 0; i_effect < n_effect; i_effect++) {
+		current = effect[ i_effect ];
+		SendNow( 0 );
+	}
+	n_effect = i_effect = 0;
+} // SendEffectNow
+
+static void Sleep( int (*done)( void ) )
+// Sleep until done() is true: the display task wakes it.
+{
+	while (! done()) {
+		long	sr = StartCritical();
+		if (! done())
+			TimeIdle();
+		EndCritical( sr ); // The task runs here.
+	}
+} // Sleep
+
+static int Room( void )
+{
+	return ((head + 1) & (DISPLAY_QUEUE_SIZE - 1)) != tail;
+} // Room
+
+static int Idle( void )
+{
+	return ! DisplayBusy();
+} // Idle
+
+void InitDisplayTask( void )
+{
+	TimerStop( &pace_timer );
+	TimerStop( &flash_timer );
+	TimerStop( &message_timer );
+	head = tail = 0;
+	sending = 0;
+	low_next = 0;
+	started = 0;
+	n_effect = i_effect = 0;
+	flash_due = message_due = 0;
+	flash_steps = 0;
+	hidden = 0;
+	message_state = NO_MESSAGE;
+	message_written = 0;
+	memset( lcd.ddram, ' ', sizeof lcd.ddram );
+	lcd.control = DISPLAY_CONTROL; // Off, until InitLCD() turns it on.
+	lcd.address = lcd.shift = 0;
+} // InitDisplayTask
+
+void DisplayTaskStart( void )
+{
+	started = 1;
+} // DisplayTaskStart
+
+void DisplaySend( unsigned char byte, unsigned char instruction_or_data,
+		  unsigned long hold_us )
+{
+	long	sr;
+
+	if (! started) {
+		current.byte = byte;
+		current.instruction_or_data = instruction_or_data;
+		current_effect = 0;
+		if (! instruction_or_data && (byte & 0xF8) == DISPLAY_CONTROL)
+			lcd.control = byte;
+		SendNow( hold_us );
+		return;
+	}
+	Sleep( Room );
+	queue[ head ].byte = byte;
+	queue[ head ].instruction_or_data = instruction_or_data;
+	queue[ head ].hold = (unsigned short)(hold_us / DISPLAY_HOLD_UNIT_US);
+	queue[ head ].queued_us = (unsigned long)TimeNowMicrosec();
+	sr = StartCritical();
+	head = (head + 1) & (DISPLAY_QUEUE_SIZE - 1);
+	if (! sending) {
+		sending = 1;
+		SchedulerPost( TASK_DISPLAY, SIGNAL_QUEUED );
+	}
+	EndCritical( sr );
+} // DisplaySend
+
+void DisplayFlash( int flashes, unsigned long period_us )
+{
+	long	sr;
+
+	if (! started) { // Blank and restore, waiting, as LCDFlash() always has.
+		current.instruction_or_data = 0;
+		current_effect = 1;
+		while (flashes-- > 0) {
+			current.byte = lcd.control & ~DISPLAY_ON;
+			SendNow( period_us / 2 );
+			current.byte = lcd.control;
+			SendNow( period_us / 2 );
+		}
+		return;
+	}
+	sr = StartCritical();
+	TimerStop( &flash_timer );
+	flash_steps = 2 * flashes + hidden; // So that it ends restored.
+	flash_step_us = period_us / 2;
+	SchedulerPost( TASK_DISPLAY, SIGNAL_FLASH );
+	EndCritical( sr );
+} // DisplayFlash
+
+void DisplayMessage( short int line, const char *text, unsigned long show_us )
+{
+	long	sr = StartCritical();
+	int	c;
+
+	for (c = 0; c < SHOWN_LENGTH; c++) // Padded with spaces.
+		message[c] = (*text) ? *text++ : ' ';
+	if (! message_written)
+		message_line = (line == 2);
+	message_us = show_us;
+	message_state = MESSAGE_DUE;
+	TimerStop( &message_timer );
+	EndCritical( sr );
+	if (! started) { // Show it, wait, and restore the line.
+		message_first = lcd.shift;
+		WriteCells( message );
+		SendEffectNow();
+		WaitMicrosec( show_us );
+		WriteCells( 0 );
+		SendEffectNow();
+		message_state = NO_MESSAGE;
+		return;
+	}
+	SchedulerPost( TASK_DISPLAY, SIGNAL_MESSAGE );
+} // DisplayMessage
+
+int DisplayBusy( void )
+{
+	return sending || head != tail || flash_steps || message_state != NO_MESSAGE;
+} // DisplayBusy
+
+void DisplayFlush( void )
+{
+	Sleep( Idle );
+} // DisplayFlush
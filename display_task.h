@@ -0,0 +1,107 @@
+/*! \file display_task.h
+ * The display task: the LCD's instructions and data, queued by the
+ * display functions and sent by a task, paced by a software timer rather
+ * than by waiting.
+ *
+ * The HD44780 takes a byte as two nibbles, and the low level has always
+ * allowed 250 us after each (SendDisplayByte()), longer after a clear.
+ * Waiting for those in the main program held it up for half a millisecond
+ * a character and 20 ms a clear, however little else it had to do. Now
+ * SendDisplayByte() only queues the byte. The display task writes the
+ * first nibble, starts a timer for 250 us, writes the second when it
+ * fires, starts it again, and so on through the queue; an entry may ask
+ * for the LCD to be left alone for longer afterwards (DisplaySend()). The
+ * timing on the LCD's pins is the same as before.
+ *
+ * The display functions keep the shadow of the screen (\a ui_snapshot) up
+ * to date as they queue, so it shows the screen as it will be once the
+ * queue is sent. DisplayFlush() waits until it is.
+ *
+ * The task also plays effects over what is queued: flashing the display
+ * (DisplayFlash(), as LCDFlash() warns of a full input) and a message shown
+ * over a line for a while (DisplayMessage()). Each is a state machine
+ * stepped by its own timer, whose few bytes the task sends between two of
+ * the queue's, so the display functions, and the keys, carry on while it
+ * plays. The task follows the LCD's state from the bytes it sends (the
+ * Display Control setting, the address counter, the display shift and
+ * what the display functions have written in the DDRAM), so an effect puts
+ * back exactly what the display functions have left, however they changed
+ * it meanwhile: a flash ends with the cursor as TurnCursorOnOff() last set
+ * it, and a message's cells are rewritten with what is now theirs. (The
+ * cursor's blink is the HD44780's own, set with the cursor.)
+ *
+ * Until DisplayTaskStart(), at the end of the boot, bytes are sent at once
+ * and waited for, as InitLCD() and the restored screen expect, and so are
+ * effects.
+ */
+
+#ifndef DISPLAY_TASK_H
+#define DISPLAY_TASK_H
+
+#define DISPLAY_QUEUE_SIZE	64	/* Bytes queued for the LCD, a little
+				 * more than the longest redraw (two lines and
+				 * a scroll). Must be a power of two; one slot
+				 * is kept empty to tell full from empty. */
+#define DISPLAY_NIBBLE_US	250	// After each nibble: 50 + 200 us, as SendDisplayByte().
+#define DISPLAY_HOLD_UNIT_US	10	// Holds are kept in these units.
+
+/*! Stop the task, forget anything queued, and send bytes at once again.
+ * Called by InitDisplayPort().
+ */
+void InitDisplayTask( void );
+
+/*! Queue bytes for the display task from now on. Called at the end of
+ * InitAllHardware().
+ */
+void DisplayTaskStart( void );
+
+/*! Send a byte to the LCD, and then leave it alone for a while.
+ *
+ * \param [in] byte The byte.
+ * \param [in] instruction_or_data 0 for an instruction, 1 for data.
+ * \param [in] hold_us How long after the usual DISPLAY_NIBBLE_US before
+ * 		the next byte, e.g. the 20 ms ClearDisplay() waits. Up to
+ * 		65535 DISPLAY_HOLD_UNIT_US.
+ *
+ * Once the task has started, this queues the byte and returns, unless
+ * the queue is full, when it sleeps until there is room. It is for the
+ * main program, not for interrupt handlers or tasks. Before, it sends the
+ * byte and waits.
+ */
+void DisplaySend( unsigned char byte, unsigned char instruction_or_data,
+		  unsigned long hold_us );
+
+/*! Flash the display: blank it and show it again, without waiting.
+ *
+ * \param [in] flashes How many times.
+ * \param [in] period_us The time from one blanking to the next.
+ *
+ * A flash already playing is replaced. While the display is blanked,
+ * Display Control instructions from the display functions are held back
+ * (the cursor is set, but the display left off) until it is shown again.
+ */
+void DisplayFlash( int flashes, unsigned long period_us );
+
+/*! Show a message over the 16 characters of a line shown now, and then
+ * put the line back, without waiting.
+ *
+ * \param [in] line The line number, 1 for top or 2 for bottom.
+ * \param [in] text The message, padded with spaces to 16 characters.
+ * \param [in] show_us How long to show it.
+ *
+ * A message already showing is replaced, on its line. Characters the
+ * display functions write on the line meanwhile, or had queued but not yet
+ * sent, overwrite the message, and are kept when it ends. The shadow of the screen never shows it.
+ */
+void DisplayMessage( short int line, const char *text, unsigned long show_us );
+
+/*! Non-zero while bytes are queued or being sent, or an effect is playing.
+ */
+int DisplayBusy( void );
+
+/*! Wait, asleep, until everything queued has been sent and held for, and
+ * every effect has finished.
+ */
+void DisplayFlush( void );
+
+#endif // of #ifndef DISPLAY_TASK_H
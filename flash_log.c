@@ -0,0 +1,189 @@
+/* flash_log.c
+ *
+ * Append-only, wear-levelled log of small records in reserved flash pages.
+ *
+ * For documentation, see the corresponding .h file.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "crc.h"
+#include "time_source.h"
+#include "scheduler.h"
+#include "metrics.h"
+#include "trace_events.h"
+#include "hal.h"
+#include "low_level_funcs_tiva.h"
+#include "flash_log.h"
+
+#define ERASED		0xFFFFFFFF	// Flash reads this until programmed.
+#define MAX_RECORD_WORDS	FLASH_LOG_RECORD_WORDS( FLASH_LOG_MAX_VALUE )
+#define STEP_IDLE	-2
+#define STEP_ERASE	-1		// Also while finding a slot.
+#define SIGNAL_START	0	// From FlashLogAppendStart().
+#define SIGNAL_DONE	1	// From the flash interrupt.
+
+static FlashLog	* volatile writing = 0;	/* The log whose record is being
+					 * written: only one at a time. */
+
+static int Newer( uint32_t a, uint32_t b )
+// Sequence number a is after b, allowing for the count wrapping round.
+{
+	return (int32_t)(a - b) > 0;
+} // Newer
+
+static int ReadRecord( const FlashLog *log, unsigned long address,
+		       uint32_t record[ MAX_RECORD_WORDS ] )
+// Read the record at address: non-zero if it is valid.
+{
+	int	i, n_words = FLASH_LOG_RECORD_WORDS( log->value_size );
+
+	record[0] = HalFlashReadWord( address );
+	if (record[0] == ERASED)
+		return 0; // Blank.
+	for (i = 1; i < n_words; i++)
+		record[i] = HalFlashReadWord( address + 4*i );
+	return Crc32( record, 4 * (n_words - 1), 0 ) == record[ n_words-1 ];
+} // ReadRecord
+
+static int Blank( unsigned long address, unsigned long length )
+// Non-zero if the flash from address for length bytes is erased.
+{
+	unsigned long	end = address + length;
+	for ( ; address < end; address += 4)
+		if (HalFlashReadWord( address ) != ERASED)
+			return 0;
+	return 1;
+} // Blank
+
+static unsigned long After( const FlashLog *log, unsigned long address )
+// The record slot after the one at address, wrapping round the log.
+{
+	address += log->slot_size;
+	if (address >= log->base + log->n_pages * FLASH_PAGE_SIZE)
+		address = log->base;
+	return address;
+} // After
+
+int FlashLogOpen( FlashLog *log, unsigned long base, int n_pages,
+		  void *value, unsigned int value_size )
+{
+	unsigned long	address, end = base + n_pages * FLASH_PAGE_SIZE;
+	uint32_t	record[ MAX_RECORD_WORDS ];	/* Flash words are 32
+					 * bits on the host too. */
+	uint32_t	newest = 0;
+	unsigned long	newest_address = 0;
+	int	found = 0;
+
+	if (writing == log) { // Abandoned (e.g. a reset): the record is torn.
+		writing = 0;
+		TimeHoldAwake( 0 );
+	}
+	log->base = base;
+	log->n_pages = n_pages;
+	log->value_size = value_size;
+	log->slot_size = FLASH_LOG_SLOT_SIZE( value_size );
+	log->step = STEP_IDLE;
+	for (address = base; address < end; address += log->slot_size) {
+		if (! ReadRecord( log, address, record ))
+			continue; // Blank, or torn by a power failure.
+		if (! found || Newer( record[0], newest )) {
+			newest = record[0];
+			newest_address = address;
+			found = 1;
+		}
+	}
+	if (found) {
+		ReadRecord( log, newest_address, record ); // The one block read.
+		log->sequence = newest;
+		log->next = After( log, newest_address );
+		memcpy( value, &record[1], value_size );
+	} else {
+		log->sequence = 0;
+		log->next = base;
+	}
+	return found;
+} // FlashLogOpen
+
+static void Continue( FlashLog *log )
+/* Start the next flash operation of the record being written, or finish
+ * it. Called by the flash task when the last operation has finished. */
+{
+	int	n_words = FLASH_LOG_RECORD_WORDS( log->value_size );
+	uint32_t	word;
+
+	TraceEndOn( TRACE_TRACK_FLASH, "" ); // The last operation, if any.
+
+	if (log->step == STEP_ERASE) { // Find a blank slot.
+		while (1) {
+			if ((log->next - log->base) % FLASH_PAGE_SIZE == 0
+			    && ! Blank( log->next, FLASH_PAGE_SIZE )) {
+				TraceBeginOn( TRACE_TRACK_FLASH, "Erase", log->next );
+				HalFlashStartErasePage( log->next ); // Onto the oldest page.
+				MetricCount( FLASH_ERASES );
+				return;
+			}
+			if (Blank( log->next, log->slot_size ))
+				break;
+			log->next = After( log, log->next ); // Skip a torn record.
+		}
+		log->step = 0;
+	} else if (++log->step == n_words) { // All written.
+		log->sequence = log->new_sequence;
+		log->next = After( log, log->next );
+		log->step = STEP_IDLE;
+		writing = 0;
+		TimeHoldAwake( 0 );
+		return;
+	}
+	if (log->step == 0)
+		word = log->new_sequence;
+	else if (log->step == n_words - 1)
+		word = log->crc;
+	else	memcpy( &word, log->value + 4 * (log->step - 1), 4 );
+	TraceBeginOn( TRACE_TRACK_FLASH, "Write", log->next + 4*log->step );
+	HalFlashStartWriteWord( log->next + 4*log->step, word );
+	MetricCount( FLASH_WRITES );
+} // Continue
+
+void FlashLogAppendStart( FlashLog *log, const void *value )
+{
+	while (writing) // The flash does one thing at a time.
+		WaitMicrosec( 10 );
+
+	log->new_sequence = log->sequence + 1;
+	if (log->new_sequence == ERASED || log->new_sequence == 0)
+		log->new_sequence = 1; // Never confused with blank flash.
+	log->value = (const unsigned char *)value;
+	log->crc = Crc32( value, log->value_size,
+			  Crc32( &log->new_sequence, 4, 0 ) );
+
+	TimeHoldAwake( 1 );
+	log->step = STEP_ERASE;
+	writing = log;
+	SchedulerPost( TASK_FLASH, SIGNAL_START );
+} // FlashLogAppendStart
+
+void FlashLogAppend( FlashLog *log, const void *value )
+{
+	FlashLogAppendStart( log, value );
+	while (FlashLogBusy( log ))
+		WaitMicrosec( 10 );
+} // FlashLogAppend
+
+int FlashLogBusy( const FlashLog *log )
+{
+	return log ? log->step != STEP_IDLE : writing != 0;
+} // FlashLogBusy
+
+void FlashLogOperationDone( void )
+{
+	SchedulerPost( TASK_FLASH, SIGNAL_DONE );
+} // FlashLogOperationDone
+
+void FlashTask( unsigned char signal )
+{
+	(void)signal; // Start and done are handled alike.
+	if (writing)
+		Continue( writing ); // The first operation, or the next.
+} // FlashTask
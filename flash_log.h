@@ -0,0 +1,118 @@
+/*! \file flash_log.h
+ * Append-only, wear-levelled log of small records in reserved flash pages.
+ *
+ * Flash can only be programmed from 1 to 0, and only erased a whole page at
+ * a time, which takes milliseconds and wears the page out (the TM4C123 is
+ * rated for 100,000 erases). Rewriting one value in place would need an
+ * erase every time. Instead each new value is appended as a record:
+ *
+ * 	| Word	| Contents					|
+ * 	| :--:	| :--						|
+ * 	| 0	| Sequence number, one more than the last	|
+ * 	| 1 to n	| The value (e.g. 8 bytes for a double)	|
+ * 	| n+1	| CRC-32 of words 0 to n			|
+ *
+ * Each record has a slot of FLASH_LOG_SLOT_SIZE() bytes, a power of two so
+ * that slots never straddle pages: 16 for a double. Records fill a page and then the next, round the log's pages in turn. A
+ * page is erased only when the log moves onto it and it is not already
+ * blank, so with N pages of R records each, a page is erased once every
+ * N*R appends. The newest record, which has the highest sequence number, is
+ * never on the page being erased.
+ *
+ * At boot FlashLogOpen() scans every record through the memory map to find
+ * the newest valid one. A record whose CRC is wrong (e.g. power failed
+ * while it was being written) is ignored, and appending skips over it.
+ *
+ * Appending need not wait for the flash. FlashLogAppendStart() has the
+ * flash task (see \a scheduler) start the first operation (an erase, or
+ * programming the first word) and returns. Each time the flash controller
+ * finishes one, its interrupt handler calls FlashLogOperationDone(), and
+ * the task starts the next, until the whole record is written. Finding a
+ * blank slot, which may read a whole page, is done by the task rather
+ * than in an interrupt handler. Meanwhile the processor may run, or sleep
+ * lightly: deep sleep is held off (TimeHoldAwake()) while the flash is busy.
+ *
+ * The flash itself is reached through HalFlashReadWord(),
+ * HalFlashStartWriteWord() and HalFlashStartErasePage() (see hal.h), so this
+ * is the same on the Tiva and on the host (where \a host_sim emulates the flash and counts
+ * erases).
+ */
+
+#ifndef FLASH_LOG_H
+#define FLASH_LOG_H
+
+#include <stdint.h>
+
+#define FLASH_LOG_MAX_VALUE	120	// Bytes, so a record fits a 128-byte slot.
+
+/*! The words of a record with a value of \a value_size bytes.
+ */
+#define FLASH_LOG_RECORD_WORDS( value_size )	((value_size) / 4 + 2)
+
+/*! The slot a record with a value of \a value_size bytes takes.
+ */
+#define FLASH_LOG_SLOT_SIZE( value_size )	((value_size) <= 8 ? 16 \
+	: (value_size) <= 24 ? 32 : (value_size) <= 56 ? 64 : 128)
+
+/*! A log. The caller owns the storage; the fields are set by
+ * FlashLogOpen() and are private to this module.
+ */
+typedef struct {
+	unsigned long	base;		// Address of the first page.
+	int	n_pages;
+	unsigned long	next;		// Where the next record goes.
+	unsigned long	sequence;	// Of the newest record; 0 if none.
+	unsigned int	value_size, slot_size;	// Bytes.
+	const unsigned char	*value;	// Being written,
+	uint32_t	new_sequence, crc;	// as the record with these.
+	volatile int	step;		/* The word being programmed, or
+					 * -1 while erasing, or -2 if idle. */
+} FlashLog;
+
+/*! Find the newest record in a log.
+ *
+ * \param [out] log The log, ready for FlashLogAppend().
+ * \param [in] base The address of its first page, which must be page-aligned.
+ * \param [in] n_pages How many pages it has, at least 2.
+ * \param [out] value The newest record's value, if there is one. It is
+ * 		read in one pass over the record, after the scan.
+ * \param [in] value_size The size of every value in the log: a multiple
+ * 		of 4, at most FLASH_LOG_MAX_VALUE.
+ * \return 1 if a valid record was found, 0 if the log is empty.
+ */
+int FlashLogOpen( FlashLog *log, unsigned long base, int n_pages,
+		  void *value, unsigned int value_size );
+
+/*! Append a record, and wait until it is written.
+ *
+ * \param [in,out] log The log, opened with FlashLogOpen().
+ * \param [in] value The value to record.
+ *
+ * This waits for the flash: FLASH_LOG_RECORD_WORDS() word writes, plus a
+ * page erase if the log moves onto a page which is not blank.
+ */
+void FlashLogAppend( FlashLog *log, const void *value );
+
+/*! Start appending a record, without waiting for the flash.
+ *
+ * \param [in,out] log The log, opened with FlashLogOpen(). If it is still
+ * 		writing a record, this first waits for that to finish.
+ * \param [in] value The value to record. It is read as each word is
+ * 		written, so it must not change until FlashLogBusy() is 0.
+ *
+ * The record is written by the flash interrupt: see FlashLogBusy().
+ */
+void FlashLogAppendStart( FlashLog *log, const void *value );
+
+/*! Non-zero while a record started by FlashLogAppendStart() is being
+ * written to \a log or, if \a log is 0, to any log.
+ */
+int FlashLogBusy( const FlashLog *log );
+
+/*! The flash controller has finished a program or erase: have the flash
+ * task start the next one of the record being written, if any. Called by
+ * the flash interrupt handler in the HAL (see hal.h).
+ */
+void FlashLogOperationDone( void );
+
+#endif // of #ifndef FLASH_LOG_H
@@ -0,0 +1,714 @@
+/* format_double.c
+ *
+ * Shortest round-trip decimal digits, and their layout for the display.
+ *
+ * For documentation, see the corresponding .h file.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <float.h>
+#include "format_double.h"
+#include "soft_float.h"
+
+#define BIG_WORDS	40	/* 1280 bits: enough for 2^1077 x 10^324
+				 * (the smallest subnormal, scaled) x 10. */
+#define EXACT_INTEGERS	9007199254740992.0	// 2^53
+
+typedef struct {
+	int	n;			// Words in use; 0 for zero.
+	uint32_t	w[ BIG_WORDS ];	// Least significant first.
+} Big;
+
+/* Static rather than on the stack, which is small on the Tiva. The
+ * formatter is only called from the main program. */
+static Big	r, s, m_plus, m_minus, sum, ten_top;
+
+// ------------------------ Big integers ------------------------
+
+static void BigSet( Big *a, uint64_t value )
+{
+	a->w[0] = (uint32_t)value;
+	a->w[1] = (uint32_t)(value >> 32);
+	a->n = a->w[1] ? 2 : a->w[0] ? 1 : 0;
+} // BigSet
+
+static void BigMulSmall( Big *a, uint32_t factor )
+{
+	uint64_t	carry = 0;
+	int	i;
+
+	for (i = 0; i < a->n; i++) {
+		carry += (uint64_t)a->w[i] * factor;
+		a->w[i] = (uint32_t)carry;
+		carry >>= 32;
+	}
+	if (carry)
+		a->w[ a->n++ ] = (uint32_t)carry;
+} // BigMulSmall
+
+static void BigMulPow10( Big *a, int power )
+{
+	for ( ; power >= 9; power -= 9)
+		BigMulSmall( a, 1000000000 );
+	if (power > 0) {
+		uint32_t	factor = 10;
+		while (--power)
+			factor *= 10;
+		BigMulSmall( a, factor );
+	}
+} // BigMulPow10
+
+static void BigShiftLeft( Big *a, int bits )
+{
+	int	words = bits / 32, i;
+
+	bits %= 32;
+	if (a->n == 0)
+		return;
+	if (bits) {
+		a->w[ a->n ] = 0;
+		for (i = a->n; i > 0; i--)
+			a->w[i] = (a->w[i] << bits) | (a->w[i-1] >> (32 - bits));
+		a->w[0] <<= bits;
+		if (a->w[ a->n ])
+			a->n ++;
+	}
+	if (words) {
+		for (i = a->n - 1; i >= 0; i--)
+			a->w[ i + words ] = a->w[i];
+		for (i = 0; i < words; i++)
+			a->w[i] = 0;
+		a->n += words;
+	}
+} // BigShiftLeft
+
+static int BigCompare( const Big *a, const Big *b )
+// -1, 0 or 1 as a is less than, equal to or greater than b.
+{
+	int	i;
+
+	if (a->n != b->n)
+		return a->n < b->n ? -1 : 1;
+	for (i = a->n - 1; i >= 0; i--)
+		if (a->w[i] != b->w[i])
+			return a->w[i] < b->w[i] ? -1 : 1;
+	return 0;
+} // BigCompare
+
+static void BigAdd( Big *total, const Big *a, const Big *b )
+{
+	const Big	*longer = (a->n >= b->n) ? a : b;
+	uint64_t	carry = 0;
+	int	i;
+
+	for (i = 0; i < longer->n; i++) {
+		carry += (uint64_t)(i < a->n ? a->w[i] : 0) + (i < b->n ? b->w[i] : 0);
+		total->w[i] = (uint32_t)carry;
+		carry >>= 32;
+	}
+	total->n = longer->n;
+	if (carry)
+		total->w[ total->n++ ] = (uint32_t)carry;
+} // BigAdd
+
+static void BigSub( Big *a, const Big *b )
+// a -= b, where a >= b.
+{
+	int64_t	borrow = 0;
+	int	i;
+
+	for (i = 0; i < a->n; i++) {
+		borrow += (int64_t)a->w[i] - (i < b->n ? b->w[i] : 0);
+		a->w[i] = (uint32_t)borrow;
+		borrow >>= 32;  // 0 or -1
+	}
+	while (a->n > 0 && a->w[ a->n - 1 ] == 0)
+		a->n --;
+} // BigSub
+
+static int BigDigit( Big *a, const Big *b )
+// a / b, which must be below 10, leaving the remainder in a.
+{
+	int	digit = 0;
+
+	while (BigCompare( a, b ) >= 0) {
+		BigSub( a, b );
+		digit ++;
+	}
+	return digit;
+} // BigDigit
+
+// ------------------------ Grisu ------------------------
+
+/* Cached powers of ten, 10^(-348 + 8i) = power_f[i] x 2^power_e[i], with
+ * power_f[i] normalised (top bit set) and rounded. */
+#define N_POWERS	87
+#define FIRST_POWER	-348
+#define POWER_STEP	8
+#define MIN_TARGET_E	-60	// The scaled number's exponent, so that its
+#define MAX_TARGET_E	-32	// integer part fits 32 bits.
+
+static const uint64_t	power_f[ N_POWERS ] = {
+	0xFA8FD5A0081C0288ULL, 0xBAAEE17FA23EBF76ULL, 0x8B16FB203055AC76ULL,
+	0xCF42894A5DCE35EAULL, 0x9A6BB0AA55653B2DULL, 0xE61ACF033D1A45DFULL,
+	0xAB70FE17C79AC6CAULL, 0xFF77B1FCBEBCDC4FULL, 0xBE5691EF416BD60CULL,
+	0x8DD01FAD907FFC3CULL, 0xD3515C2831559A83ULL, 0x9D71AC8FADA6C9B5ULL,
+	0xEA9C227723EE8BCBULL, 0xAECC49914078536DULL, 0x823C12795DB6CE57ULL,
+	0xC21094364DFB5637ULL, 0x9096EA6F3848984FULL, 0xD77485CB25823AC7ULL,
+	0xA086CFCD97BF97F4ULL, 0xEF340A98172AACE5ULL, 0xB23867FB2A35B28EULL,
+	0x84C8D4DFD2C63F3BULL, 0xC5DD44271AD3CDBAULL, 0x936B9FCEBB25C996ULL,
+	0xDBAC6C247D62A584ULL, 0xA3AB66580D5FDAF6ULL, 0xF3E2F893DEC3F126ULL,
+	0xB5B5ADA8AAFF80B8ULL, 0x87625F056C7C4A8BULL, 0xC9BCFF6034C13053ULL,
+	0x964E858C91BA2655ULL, 0xDFF9772470297EBDULL, 0xA6DFBD9FB8E5B88FULL,
+	0xF8A95FCF88747D94ULL, 0xB94470938FA89BCFULL, 0x8A08F0F8BF0F156BULL,
+	0xCDB02555653131B6ULL, 0x993FE2C6D07B7FACULL, 0xE45C10C42A2B3B06ULL,
+	0xAA242499697392D3ULL, 0xFD87B5F28300CA0EULL, 0xBCE5086492111AEBULL,
+	0x8CBCCC096F5088CCULL, 0xD1B71758E219652CULL, 0x9C40000000000000ULL,
+	0xE8D4A51000000000ULL, 0xAD78EBC5AC620000ULL, 0x813F3978F8940984ULL,
+	0xC097CE7BC90715B3ULL, 0x8F7E32CE7BEA5C70ULL, 0xD5D238A4ABE98068ULL,
+	0x9F4F2726179A2245ULL, 0xED63A231D4C4FB27ULL, 0xB0DE65388CC8ADA8ULL,
+	0x83C7088E1AAB65DBULL, 0xC45D1DF942711D9AULL, 0x924D692CA61BE758ULL,
+	0xDA01EE641A708DEAULL, 0xA26DA3999AEF774AULL, 0xF209787BB47D6B85ULL,
+	0xB454E4A179DD1877ULL, 0x865B86925B9BC5C2ULL, 0xC83553C5C8965D3DULL,
+	0x952AB45CFA97A0B3ULL, 0xDE469FBD99A05FE3ULL, 0xA59BC234DB398C25ULL,
+	0xF6C69A72A3989F5CULL, 0xB7DCBF5354E9BECEULL, 0x88FCF317F22241E2ULL,
+	0xCC20CE9BD35C78A5ULL, 0x98165AF37B2153DFULL, 0xE2A0B5DC971F303AULL,
+	0xA8D9D1535CE3B396ULL, 0xFB9B7CD9A4A7443CULL, 0xBB764C4CA7A44410ULL,
+	0x8BAB8EEFB6409C1AULL, 0xD01FEF10A657842CULL, 0x9B10A4E5E9913129ULL,
+	0xE7109BFBA19C0C9DULL, 0xAC2820D9623BF429ULL, 0x80444B5E7AA7CF85ULL,
+	0xBF21E44003ACDD2DULL, 0x8E679C2F5E44FF8FULL, 0xD433179D9C8CB841ULL,
+	0x9E19DB92B4E31BA9ULL, 0xEB96BF6EBADF77D9ULL, 0xAF87023B9BF0EE6BULL,};
+static const short	power_e[ N_POWERS ] = {
+	-1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980,
+	-954, -927, -901, -874, -847, -821, -794, -768, -741, -715,
+	-688, -661, -635, -608, -582, -555, -529, -502, -475, -449,
+	-422, -396, -369, -343, -316, -289, -263, -236, -210, -183,
+	-157, -130, -103, -77, -50, -24, 3, 30, 56, 83,
+	109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+	375, 402, 428, 455, 481, 508, 534, 561, 588, 614,
+	641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+	907, 933, 960, 986, 1013, 1039, 1066,};
+
+typedef struct {
+	uint64_t	f;
+	int	e;
+} DiyFp;	// f x 2^e, "do it yourself floating point".
+
+static DiyFp Multiply( DiyFp a, DiyFp b )
+// The top 64 bits of the product, rounded.
+{
+	uint64_t	a_hi = a.f >> 32, a_lo = a.f & 0xFFFFFFFF;
+	uint64_t	b_hi = b.f >> 32, b_lo = b.f & 0xFFFFFFFF;
+	uint64_t	hi_lo = a_hi * b_lo, lo_hi = a_lo * b_hi;
+	uint64_t	middle = ((a_lo * b_lo) >> 32) + (hi_lo & 0xFFFFFFFF)
+			 + (lo_hi & 0xFFFFFFFF) + (1U << 31);
+	DiyFp	product;
+
+	product.f = a_hi * b_hi + (hi_lo >> 32) + (lo_hi >> 32) + (middle >> 32);
+	product.e = a.e + b.e + 64;
+	return product;
+} // Multiply
+
+static DiyFp Normalize( DiyFp a )
+{
+	while (! (a.f & 0xFFC0000000000000ULL)) {
+		a.f <<= 10;
+		a.e -= 10;
+	}
+	while (! (a.f & 0x8000000000000000ULL)) {
+		a.f <<= 1;
+		a.e --;
+	}
+	return a;
+} // Normalize
+
+static DiyFp CachedPower( int w_e, int *power10 )
+// A power of ten to bring the product's exponent to the target range.
+{
+	int	min_e = MIN_TARGET_E - (w_e + 64), i;
+	DiyFp	power;
+
+	i = (min_e - power_e[0]) * 1000 / 26575;  // 26.575 bits per step
+	if (i < 0)
+		i = 0;
+	while (i < N_POWERS - 1 && power_e[i] < min_e)
+		i ++;
+	while (i > 0 && power_e[i-1] >= min_e)
+		i --;
+	power.f = power_f[i];
+	power.e = power_e[i];
+	*power10 = FIRST_POWER + POWER_STEP * i;
+	return power;
+} // CachedPower
+
+static int Split( DiyFp w, uint32_t *integrals, uint64_t *fractionals,
+		  uint32_t *divisor )
+// Split w at its binary point: the digits in the integer part.
+{
+	int	kappa = 0;
+
+	*integrals = (uint32_t)(w.f >> -w.e);
+	*fractionals = w.f & ((1ULL << -w.e) - 1);
+	*divisor = 1;
+	if (*integrals) {
+		for (kappa = 1; *integrals / *divisor >= 10; kappa++)
+			*divisor *= 10;
+	}
+	return kappa;
+} // Split
+
+static int RoundWeed( char *digits, int n, uint64_t distance_too_high_w,
+		      uint64_t unsafe_interval, uint64_t rest,
+		      uint64_t ten_kappa, uint64_t unit )
+/* Move the last digit down towards w while that stays in the interval and
+ * gets closer, then check the result is certainly the closest of the
+ * shortest: non-zero if so. */
+{
+	uint64_t	small_distance = distance_too_high_w - unit;
+	uint64_t	big_distance = distance_too_high_w + unit;
+
+	while (rest < small_distance && unsafe_interval - rest >= ten_kappa
+	       && (rest + ten_kappa < small_distance
+		   || small_distance - rest >= rest + ten_kappa - small_distance)) {
+		digits[ n-1 ] --;
+		rest += ten_kappa;
+	}
+	if (rest < big_distance && unsafe_interval - rest >= ten_kappa
+	    && (rest + ten_kappa < big_distance
+		|| big_distance - rest > rest + ten_kappa - big_distance))
+		return 0;  // Cannot tell which is closest.
+	return 2 * unit <= rest && rest <= unsafe_interval - 4 * unit;
+} // RoundWeed
+
+static int GrisuShortest( double x, char *digits, int *n, int *exp10 )
+/* Grisu3: the shortest digits, computed with 64-bit arithmetic. Returns 0
+ * if that is not accurate enough to be sure of them (about 0.5% of
+ * doubles). x must be positive. */
+{
+	uint64_t	bits, fractionals, unit = 1, unsafe, rest, one;
+	uint32_t	integrals, divisor;
+	DiyFp	w, plus, minus, power;
+	int	power10, kappa;
+
+	memcpy( &bits, &x, sizeof bits );
+	w.f = bits & 0xFFFFFFFFFFFFFULL;
+	w.e = (int)((bits >> 52) & 0x7FF);
+	if (w.e) {
+		w.f |= 1ULL << 52;
+		w.e -= 1075;
+	} else
+		w.e = -1074;
+	plus.f = (w.f << 1) + 1;
+	plus.e = w.e - 1;
+	plus = Normalize( plus );
+	if (w.f == 1ULL << 52 && w.e > -1074) {	// The gap below is half that above.
+		minus.f = (w.f << 2) - 1;
+		minus.e = w.e - 2;
+	} else {
+		minus.f = (w.f << 1) - 1;
+		minus.e = w.e - 1;
+	}
+	minus.f <<= minus.e - plus.e;
+	minus.e = plus.e;
+	w = Normalize( w );
+
+	power = CachedPower( w.e, &power10 );
+	w = Multiply( w, power );
+	plus = Multiply( plus, power );
+	minus = Multiply( minus, power );
+	plus.f += unit;  // Too high, and too low, allowing for the errors.
+	minus.f -= unit;
+	unsafe = plus.f - minus.f;
+	one = 1ULL << -w.e;
+
+	kappa = Split( plus, &integrals, &fractionals, &divisor );
+	*n = 0;
+	for ( ; kappa > 0; divisor /= 10) {
+		digits[ (*n)++ ] = '0' + (char)(integrals / divisor);
+		integrals %= divisor;
+		kappa --;
+		rest = ((uint64_t)integrals << -w.e) + fractionals;
+		if (rest < unsafe) {
+			*exp10 = -power10 + kappa + *n - 1;
+			return RoundWeed( digits, *n, plus.f - w.f, unsafe, rest,
+					  (uint64_t)divisor << -w.e, unit );
+		}
+	}
+	while (*n < FORMAT_MAX_DIGITS) {
+		fractionals *= 10;
+		unit *= 10;
+		unsafe *= 10;
+		digits[ (*n)++ ] = '0' + (char)(fractionals >> -w.e);
+		fractionals &= one - 1;
+		kappa --;
+		if (fractionals < unsafe) {
+			*exp10 = -power10 + kappa + *n - 1;
+			return RoundWeed( digits, *n, (plus.f - w.f) * unit, unsafe,
+					  fractionals, one, unit );
+		}
+	}
+	return 0;  // Not converged: leave it to the exact method.
+} // GrisuShortest
+
+static int RoundWeedCounted( char *digits, int n, uint64_t rest,
+			     uint64_t ten_kappa, uint64_t unit, int *kappa )
+/* Round the last digit by the rest, if the error (unit) cannot change
+ * which way: non-zero if so. */
+{
+	int	i;
+
+	if (unit >= ten_kappa || ten_kappa - unit <= unit)
+		return 0;
+	if (ten_kappa - rest > rest && ten_kappa - 2 * rest >= 2 * unit)
+		return 1;  // Down
+	if (rest > unit && ten_kappa - (rest - unit) <= rest - unit) {
+		for (i = n - 1; i > 0 && digits[i] == '9'; i--) // Up
+			digits[i] = '0';
+		if (digits[i] == '9') {
+			digits[0] = '1';
+			(*kappa) ++;
+		} else
+			digits[i] ++;
+		return 1;
+	}
+	return 0;
+} // RoundWeedCounted
+
+static int GrisuRounded( double x, int n_digits, char *digits, int *exp10 )
+/* x rounded to n_digits, with 64-bit arithmetic. Returns 0 if that is not
+ * accurate enough to be sure of the rounding. x must be positive. */
+{
+	uint64_t	bits, fractionals, unit = 1, one;
+	uint32_t	integrals, divisor;
+	DiyFp	w, power;
+	int	power10, kappa, n = 0, ok;
+
+	memcpy( &bits, &x, sizeof bits );
+	w.f = bits & 0xFFFFFFFFFFFFFULL;
+	w.e = (int)((bits >> 52) & 0x7FF);
+	if (w.e) {
+		w.f |= 1ULL << 52;
+		w.e -= 1075;
+	} else
+		w.e = -1074;
+	w = Normalize( w );
+	power = CachedPower( w.e, &power10 );
+	w = Multiply( w, power );
+	one = 1ULL << -w.e;
+
+	kappa = Split( w, &integrals, &fractionals, &divisor );
+	while (kappa > 0 && n < n_digits) {
+		digits[ n++ ] = '0' + (char)(integrals / divisor);
+		integrals %= divisor;
+		kappa --;
+		if (n < n_digits)
+			divisor /= 10;
+	}
+	if (n == n_digits)
+		ok = RoundWeedCounted( digits, n, ((uint64_t)integrals << -w.e) + fractionals,
+				       (uint64_t)divisor << -w.e, unit, &kappa );
+	else {
+		while (n < n_digits && fractionals > unit) {
+			fractionals *= 10;
+			unit *= 10;
+			digits[ n++ ] = '0' + (char)(fractionals >> -w.e);
+			fractionals &= one - 1;
+			kappa --;
+		}
+		ok = (n == n_digits)
+			&& RoundWeedCounted( digits, n, fractionals, one, unit, &kappa );
+	}
+	*exp10 = -power10 + kappa + n - 1;
+	return ok;
+} // GrisuRounded
+
+// ------------------------ Exact digits ------------------------
+
+static int Scale( double x, int rounding, int *even )
+/* Set r / s to x, and m_minus / s and m_plus / s to the distances to the
+ * half-way points either side, then scale s so that r / s (or, for the
+ * shortest digits, the upper half-way point) is in [0.1, 1). Returns the
+ * power of ten, so x = (r / s) x 10^k. Even is set if the mantissa is
+ * even, so the half-way points themselves read back as x. */
+{
+	uint64_t	bits;
+	uint64_t	f;
+	int	e, k, unequal_gaps, inclusive;
+
+	memcpy( &bits, &x, sizeof bits );
+	f = bits & 0xFFFFFFFFFFFFFULL;
+	e = (int)((bits >> 52) & 0x7FF);
+	if (e) {
+		f |= 1ULL << 52;
+		e -= 1075;
+	} else
+		e = -1074;  // Subnormal
+	unequal_gaps = (f == 1ULL << 52 && e > -1074);  // The gap below is half that above.
+	*even = (f & 1) == 0;
+
+	/* x = f x 2^e. Work in units of a quarter of the gap below, so that
+	 * r, s and both half-gaps are integers. */
+	BigSet( &r, f << (unequal_gaps ? 2 : 1) );
+	BigSet( &s, unequal_gaps ? 4 : 2 );
+	BigSet( &m_minus, 1 );
+	BigSet( &m_plus, unequal_gaps ? 2 : 1 );
+	if (e >= 0) {
+		BigShiftLeft( &r, e );
+		BigShiftLeft( &m_minus, e );
+		BigShiftLeft( &m_plus, e );
+	} else
+		BigShiftLeft( &s, -e );
+
+	/* Estimate k from the binary exponent (log10(2) is about 0.30103).
+	 * It is usually a little low, and is corrected below. */
+	k = (int)((e + 52) * 30103L / 100000L) - ((e + 52) < 0);
+	if (k >= 0)
+		BigMulPow10( &s, k );
+	else {
+		BigMulPow10( &r, -k );
+		BigMulPow10( &m_minus, -k );
+		BigMulPow10( &m_plus, -k );
+	}
+	/* Correct the estimate, so that s / 10 <= top < s, where top is r or
+	 * the upper half-way point. If that point does not read back as x,
+	 * s / 10 < top <= s will do. */
+	inclusive = rounding || *even;
+	while (1) {
+		if (rounding)
+			ten_top = r;
+		else	BigAdd( &ten_top, &r, &m_plus );
+		BigMulSmall( &ten_top, 10 );
+		if (BigCompare( &ten_top, &s ) >= (inclusive ? 0 : 1))
+			break;
+		BigMulSmall( &r, 10 );
+		BigMulSmall( &m_minus, 10 );
+		BigMulSmall( &m_plus, 10 );
+		k --;
+	}
+	while (1) {
+		if (rounding)
+			sum = r;
+		else	BigAdd( &sum, &r, &m_plus );
+		if (BigCompare( &sum, &s ) < (inclusive ? 0 : 1))
+			break;
+		BigMulSmall( &s, 10 );
+		k ++;
+	}
+	return k;
+} // Scale
+
+static int StripZeros( char *digits, int n )
+// Remove trailing zeros, and terminate the string: the digits left.
+{
+	while (n > 1 && digits[ n-1 ] == '0')
+		n --;
+	digits[n] = '\0';
+	return n;
+} // StripZeros
+
+static int IntegerDigits( double x, char *digits, int *exp10 )
+// A whole number below 2^53: its digits, without trailing zeros.
+{
+	uint64_t	value = DConvert( uint64_t, x );
+	char	reversed[ FORMAT_MAX_DIGITS ];
+	int	n = 0, i;
+
+	do {
+		reversed[ n++ ] = '0' + (char)(value % 10);
+		value /= 10;
+	} while (value);
+	*exp10 = n - 1;
+	for (i = 0; reversed[i] == '0' && i < n - 1; i++)
+		;
+	n -= i;  // Trailing zeros
+	for (i = 0; i < n; i++)
+		digits[i] = reversed[ *exp10 - i ];
+	digits[n] = '\0';
+	return n;
+} // IntegerDigits
+
+int FormatShortestDigits( double x, char digits[ FORMAT_MAX_DIGITS + 1 ],
+			  int *exp10 )
+{
+	int	n, k, digit, low, high, even;
+
+	if (DLess( x, 0 ))
+		x = -x;
+	if (DLess( x, EXACT_INTEGERS )
+	    && DEqual( x, DConvert( double, DConvert( uint64_t, x ) ) ))
+		return IntegerDigits( x, digits, exp10 );
+	if (GrisuShortest( x, digits, &n, exp10 ))
+		return StripZeros( digits, n );
+
+	k = Scale( x, 0, &even );
+	n = 0;
+	do {
+		BigMulSmall( &r, 10 );
+		BigMulSmall( &m_minus, 10 );
+		BigMulSmall( &m_plus, 10 );
+		digit = BigDigit( &r, &s );
+		BigAdd( &sum, &r, &m_plus );
+		low = BigCompare( &r, &m_minus ) < (even ? 1 : 0);	// Could stop here,
+		high = BigCompare( &sum, &s ) > (even ? -1 : 0);	// or one up.
+		if (high && (! low || (BigShiftLeft( &r, 1 ), BigCompare( &r, &s ) >= 0)))
+			digit ++;
+		digits[ n++ ] = '0' + (char)digit;
+	} while (! low && ! high && n < FORMAT_MAX_DIGITS);
+	digits[n] = '\0';
+	*exp10 = k - 1;
+	return n;
+} // FormatShortestDigits
+
+int FormatRoundedDigits( double x, int n_digits,
+			 char digits[ FORMAT_MAX_DIGITS + 1 ], int *exp10 )
+{
+	int	n, k, i, comparison, even;
+
+	if (DLess( x, 0 ))
+		x = -x;
+	if (n_digits > FORMAT_MAX_DIGITS)
+		n_digits = FORMAT_MAX_DIGITS;
+	if (n_digits < 1)
+		n_digits = 1;
+	if (DEqual( x, 0.0 )) {
+		strcpy( digits, "0" );
+		*exp10 = 0;
+		return 1;
+	}
+
+	if (GrisuRounded( x, n_digits, digits, exp10 ))
+		return StripZeros( digits, n_digits );
+
+	k = Scale( x, 1, &even );
+	for (n = 0; n < n_digits; n++) {
+		BigMulSmall( &r, 10 );
+		digits[n] = '0' + (char)BigDigit( &r, &s );
+	}
+	BigShiftLeft( &r, 1 );  // Round half to even
+	comparison = BigCompare( &r, &s );
+	if (comparison > 0 || (comparison == 0 && (digits[ n-1 ] & 1))) {
+		for (i = n - 1; i >= 0 && digits[i] == '9'; i--)
+			digits[i] = '0';
+		if (i >= 0)
+			digits[i] ++;
+		else {	// 99.9 up to 100
+			digits[0] = '1';
+			k ++;
+		}
+	}
+	*exp10 = k - 1;
+	return StripZeros( digits, n );
+} // FormatRoundedDigits
+
+// ------------------------ Layout ------------------------
+
+static int ExponentLength( int exp10 )
+// Characters of E notation's exponent, with its sign.
+{
+	int	length = (exp10 < 0) ? 2 : 1;
+
+	if (exp10 < 0)
+		exp10 = -exp10;
+	for ( ; exp10 >= 10; exp10 /= 10)
+		length ++;
+	return length;
+} // ExponentLength
+
+static int FixedLength( int n, int exp10 )
+{
+	if (exp10 < 0)
+		return n + 1 - exp10;  // 0.000ddd
+	return (n <= exp10 + 1) ? exp10 + 1 : n + 1;
+} // FixedLength
+
+static int ELength( int n, int exp10 )
+{
+	return n + (n > 1) + 1 + ExponentLength( exp10 );
+} // ELength
+
+static int Layout( const char *digits, int n, int exp10, int negative,
+		   char *text, int width )
+// Write the digits in fixed or E notation: the length, or 0 if neither fits.
+{
+	int	columns = width - negative, fixed, i, length = 0, exponent;
+
+	fixed = FixedLength( n, exp10 ) <= columns
+		&& (exp10 >= -5 || ELength( n, exp10 ) > columns);
+	if (! fixed && ELength( n, exp10 ) > columns)
+		return 0;
+
+	if (negative)
+		text[ length++ ] = '-';
+	if (fixed && exp10 < 0) {
+		text[ length++ ] = '0';
+		text[ length++ ] = '.';
+		for (i = exp10 + 1; i < 0; i++)
+			text[ length++ ] = '0';
+	}
+	for (i = 0; i < n || (fixed && i <= exp10); i++) {
+		if (i > 0 && i == (fixed ? exp10 + 1 : 1))
+			text[ length++ ] = '.';
+		text[ length++ ] = (i < n) ? digits[i] : '0';
+	}
+	if (! fixed) {
+		text[ length++ ] = 'E';
+		exponent = exp10;
+		if (exponent < 0) {
+			text[ length++ ] = '-';
+			exponent = -exponent;
+		}
+		i = length += ExponentLength( exponent );
+		do {
+			text[ --i ] = '0' + (char)(exponent % 10);
+			exponent /= 10;
+		} while (exponent);
+	}
+	text[ length ] = '\0';
+	return length;
+} // Layout
+
+static int MostDigits( int exp10, int negative, int width )
+// The most significant digits that fit the width either way.
+{
+	int	columns = width - negative, fixed, e;
+
+	if (exp10 >= 0)
+		fixed = (exp10 + 1 > columns) ? 0
+			: (columns - 1 > exp10 + 1) ? columns - 1 : exp10 + 1;
+	else
+		fixed = columns - 1 + exp10;
+	e = columns - 2 - ExponentLength( exp10 );
+	if (e < 1 && columns - 1 - ExponentLength( exp10 ) >= 1)
+		e = 1;
+	return (fixed > e) ? fixed : e;
+} // MostDigits
+
+int FormatDouble( double x, char *text, int width )
+{
+	char	digits[ FORMAT_MAX_DIGITS + 1 ];
+	int	n, exp10, length, most, negative = DLess( x, 0 );
+
+	if (! DEqual( x, x )) {
+		strcpy( text, "nan" );
+		return 3;
+	}
+	if (DLess( DBL_MAX, x ) || DLess( x, -DBL_MAX )) {
+		strcpy( text, negative ? "-inf" : "inf" );
+		return negative ? 4 : 3;
+	}
+	n = FormatShortestDigits( x, digits, &exp10 );
+	if (n == 1 && digits[0] == '0')
+		negative = 0;  // No -0
+	while ((length = Layout( digits, n, exp10, negative, text, width )) == 0) {
+		most = MostDigits( exp10, negative, width );
+		if (most >= n)
+			most = n - 1;  // The rounding carried: one fewer.
+		if (most < 1) {
+			text[0] = '\0';  // Too narrow
+			return 0;
+		}
+		n = FormatRoundedDigits( x, most, digits, &exp10 );
+	}
+	return length;
+} // FormatDouble
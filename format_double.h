@@ -0,0 +1,63 @@
+/*! \file format_double.h
+ * Doubles to decimal text for the display, without stdio.
+ *
+ * sprintf( "%g" ) brings the whole printf engine into the image and gives
+ * only 6 significant figures. This gives the shortest decimal digits that
+ * read back (e.g. with strtod() or CalculateAnswer()) as exactly the same
+ * double, so 0.1 shows as 0.1 and 1/3 as 0.33333333333333, and lays them
+ * out to fit the display.
+ *
+ * A whole number below 2^53, the usual answer on a calculator, is simply
+ * converted as an integer. Otherwise the digits come from Grisu3 (Loitsch,
+ * 2010): the number and the half-way points to its neighbouring doubles are
+ * scaled by a cached power of ten (a table of 87, 870 bytes) into 64-bit
+ * fixed point, and digits are produced until the number so far lies
+ * between those points. The rounding errors are tracked, and for the
+ * roughly 0.5% of doubles where they could change the result, the digits
+ * are found exactly instead, as in Steele and White's (and Burger and
+ * Dybvig's) free-format algorithm, with integers of up to 1280 bits.
+ * Rounding to fewer digits works the same way.
+ */
+
+#ifndef FORMAT_DOUBLE_H
+#define FORMAT_DOUBLE_H
+
+#define FORMAT_MAX_DIGITS	17	// Always enough to identify a double.
+
+/*! The shortest decimal digits which read back as \a x.
+ *
+ * \param [in] x A finite number. Its sign is ignored.
+ * \param [out] digits The significant digits, as a string, with no
+ * 		trailing zeros: "0" for zero.
+ * \param [out] exp10 The power of ten of the first digit, so
+ * 		|x| = d.ddd x 10^exp10.
+ * \return The number of digits, 1 to FORMAT_MAX_DIGITS.
+ */
+int FormatShortestDigits( double x, char digits[ FORMAT_MAX_DIGITS + 1 ],
+			  int *exp10 );
+
+/*! \a x correctly rounded to at most \a n_digits significant digits. As
+ * FormatShortestDigits(), but trailing zeros are removed after rounding,
+ * so fewer digits may be returned.
+ */
+int FormatRoundedDigits( double x, int n_digits,
+			 char digits[ FORMAT_MAX_DIGITS + 1 ], int *exp10 );
+
+/*! Format a number to fit a line of the display.
+ *
+ * \param [in] x The number.
+ * \param [out] text The text and a trailing null: \a width + 1 chars.
+ * \param [in] width The columns available, at least 7.
+ * \return The length of the text.
+ *
+ * The shortest digits are shown in fixed notation (e.g. 15, -0.0025)
+ * unless the number is below 10^-5, or that would not fit, when E
+ * notation is used as typed on the keypad (e.g. 1.5E-7, 6.02E23). A
+ * whole number has no decimal point. If the shortest digits fit neither
+ * way, the number is rounded to as many digits as fit, in whichever
+ * notation shows more of them. Infinity and NaN, which CalculateAnswer()
+ * reports as errors instead, show as inf and nan.
+ */
+int FormatDouble( double x, char *text, int width );
+
+#endif // of #ifndef FORMAT_DOUBLE_H
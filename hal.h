@@ -0,0 +1,160 @@
+/*! \file hal.h
+ * The hardware abstraction layer: the few things the calculator does to
+ * the hardware itself, below the low level.
+ *
+ * Everything else, from main() down to \a low_level_funcs_tiva, is the same
+ * on every target. The HAL has three parts:
+ * 	- the time source, \a time_source.h, with HalInitClock() and
+ * 		HalWaitMicrosec() here;
+ * 	- GPIO port bits: the LCD's RS, EN and DB4-DB7 pins, and the keypad's
+ * 		column outputs and row inputs with their edge interrupt;
+ * 	- flash: reading, programming and erasing, with the completion
+ * 		interrupt.
+ *
+ * Each has two implementations, chosen when linking, as the time source
+ * always was:
+ * 	- \a hal_tiva (with \a time_source_tiva and PLL.c) writes the
+ * 		TM4C123's registers;
+ * 	- \a hal_host (with \a virtual_clock) drives the simulated hardware
+ * 		in \a host_sim, so the whole firmware builds as an ordinary
+ * 		Linux executable, e.g. to profile it with perf or to test it
+ * 		quickly.
+ *
+ * There is no table of function pointers: the low level calls these
+ * functions directly, so the HAL costs no more than the register accesses
+ * it makes. Nothing in it may be called before HalInitClock() unless
+ * noted.
+ *
+ * Each backend also connects the interrupts to the modules which handle
+ * them: the keypad's row edge to KeyEventsRowEdge(), flash completion to
+ * FlashLogOperationDone() and the pended scheduler to SchedulerRun(); and
+ * provides PendScheduler() (\a scheduler), WaitForInterrupt()
+ * (\a low_level_funcs_tiva), and StartCritical() and EndCritical()
+ * (\a time_source; on the Tiva in startup.s).
+ */
+
+#ifndef HAL_H
+#define HAL_H
+
+//! \name Clock and time
+//@{
+
+/*! Start the system clock, and set up what the time source and the
+ * scheduler need from the core (e.g. PendSV's priority). Called by
+ * InitAllOther(), before InitTimeSource().
+ */
+void HalInitClock( void );
+
+/*! Wait a specified number of microseconds: TimeWaitMicrosec(), also
+ * counted by \a host_sim on the host (SimStats::wait_us).
+ *
+ * \param [in] wait_microsecs The time (in microseconds) to delay.
+ */
+void HalWaitMicrosec( long int wait_microsecs );
+
+/*! Non-zero if the boot should run Welcome(): on the Tiva, but not on the
+ * host, where there is no one to type the password, so that a run (or a
+ * test) starts at the calculator.
+ */
+extern const int hal_boot_welcome;
+
+//@}
+// End of Clock and time
+
+//! \name GPIO port bits
+//@{
+
+/*! Set up the LCD's pins as outputs: RS and EN (port A bits 3 and 2) and
+ * DB4-DB7 (port B bits 2-5).
+ */
+void HalInitLCDPins( void );
+
+/*! Write the LCD's pins. The values are those written to the port: RS is
+ * 0x08 for data, EN is 0x04 when high, and DATA holds DB4-DB7 in bits 2-5.
+ */
+void HalWriteLCD_RS( unsigned long value );
+void HalWriteLCD_EN( unsigned long value );	//!< \copydoc HalWriteLCD_RS
+void HalWriteLCD_DATA( unsigned long value );	//!< \copydoc HalWriteLCD_RS
+
+/*! Set up the keypad's pins: the four columns (port D bits 0-3) as
+ * outputs, the four rows (port E bits 0-3) as inputs pulled down, and a
+ * disarmed interrupt on the rising edge of each row, handled by
+ * KeyEventsRowEdge().
+ */
+void HalInitKeypadPins( void );
+
+/*! Drive the keypad's columns, bit n being column n as in
+ * WriteKeyboardCol().
+ */
+void HalWriteKeypadCols( unsigned char nibble );
+
+/*! The keypad's rows, in the low four bits, as in ReadKeyboardRow().
+ */
+unsigned char HalReadKeypadRows( void );
+
+/*! Clear the keypad's edge interrupt flags.
+ *
+ * InitKeyboardPorts() drives all four columns and arms the interrupt, so
+ * that any key press interrupts. KeyEventsRowEdge() disarms it and
+ * debounces the keypad by sampling it; it acknowledges and re-arms the
+ * interrupt once all keys are released.
+ */
+void HalAckKeypadInterrupt( void );
+
+/*! Arm or disarm the keypad's edge interrupt.
+ *
+ * \param [in] arm Non-zero to arm, zero to disarm.
+ *
+ * Edges while disarmed still set the flags, so acknowledge them with
+ * HalAckKeypadInterrupt() before re-arming.
+ */
+void HalArmKeypadInterrupt( int arm );
+
+//@}
+// End of GPIO port bits
+
+//! \name Flash
+//@{
+
+// Operations for HalFlashBusy(), the FMC register's bits on the Tiva.
+#define HAL_FLASH_WRITE		0x01	//!< Programming a word.
+#define HAL_FLASH_ERASE		0x02	//!< Erasing a page.
+#define HAL_FLASH_COMMIT	0x08	//!< Committing a register.
+
+/*! Set up the flash controller, and its interrupt on the completion of a
+ * program or erase, handled by FlashLogOperationDone().
+ */
+void HalInitFlash( void );
+
+/*! Non-zero while any of \a operations (HAL_FLASH_WRITE etc.) is in
+ * progress.
+ */
+int HalFlashBusy( unsigned long operations );
+
+/*! Read a word of flash, through the memory map.
+ *
+ * \param [in] address The byte address, a multiple of 4.
+ * \return The word. Erased flash reads 0xFFFFFFFF.
+ */
+unsigned long HalFlashReadWord( unsigned long address );
+
+/*! Start programming a word of flash.
+ *
+ * \param [in] address The byte address, a multiple of 4.
+ * \param [in] word The value. Programming can only clear bits, so the
+ * 		word should be erased first.
+ *
+ * This does not wait: when the flash is done, its interrupt handler calls
+ * FlashLogOperationDone(). Only one operation may be in progress.
+ */
+void HalFlashStartWriteWord( unsigned long address, unsigned long word );
+
+/*! Start erasing the flash page containing \a address. Like
+ * HalFlashStartWriteWord(), this does not wait.
+ */
+void HalFlashStartErasePage( unsigned long address );
+
+//@}
+// End of Flash
+
+#endif // of #ifndef HAL_H
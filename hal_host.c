@@ -0,0 +1,203 @@
+/* hal_host.c
+ *
+ * Host (Linux/PC) implementation of hal.h, for running the whole firmware
+ * on the simulated hardware in host_sim instead of on the Tiva.
+ *
+ * Each function makes the same pin write, row read or flash operation as
+ * its Tiva counterpart, but it goes to host_sim rather than to a register,
+ * which counts it and advances simulated time. The interrupt handlers are
+ * given to host_sim, which calls them as the Tiva's NVIC would.
+ *
+ * Linked with main.c, this is the whole firmware as a Linux executable.
+ * The boot then resets the simulation itself, and types the keys read
+ * from standard input (e.g. "echo 12A3# | ./calculator"; characters which
+ * are not keys are skipped), HAL_HOST_KEY_GAP_US apart. Once they have all
+ * been read, the simulation's statistics and the metrics are printed and
+ * it exits. Built with -DTRACE_EVENTS, it also writes the trace to
+ * TRACE_EVENTS_FILE (see trace_events.h).
+ *
+ * For documentation, see the corresponding .h file.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "host_sim.h"
+#include "time_source.h"
+#include "virtual_clock.h"
+#include "scheduler.h"
+#include "key_events.h"
+#include "flash_log.h"
+#include "metrics.h"
+#include "trace_events.h"
+#include "low_level_funcs_tiva.h"
+#include "hal.h"
+
+// =========================== CONSTANTS ============================
+
+#define HAL_HOST_KEY_GAP_US	50000	// Between the keys from standard input,
+#define HAL_HOST_KEY_HOLD_US	50000	// and each held this long: ten a second.
+#define HAL_HOST_KEYS		"0123456789ABCD*#"
+
+const int	hal_boot_welcome = 0;
+
+// =========================== FUNCTIONS ============================
+
+// ------------------------ Clock and time ------------------------
+
+static void TypeStandardInput( void )
+// Script the keys from standard input.
+{
+	char	keys[ 256 ];
+	int	ch, n = 0;
+
+	while ((ch = getchar()) != EOF) {
+		if (ch == '\0' || strchr( HAL_HOST_KEYS, ch ) == 0)
+			continue;
+		keys[ n++ ] = (char)ch;
+		if (n == sizeof keys - 1) {
+			keys[ n ] = '\0';
+			SimKeypadType( keys, HAL_HOST_KEY_GAP_US, HAL_HOST_KEY_HOLD_US );
+			n = 0;
+		}
+	}
+	keys[ n ] = '\0';
+	SimKeypadType( keys, HAL_HOST_KEY_GAP_US, HAL_HOST_KEY_HOLD_US );
+} // TypeStandardInput
+
+static void PrintMetrics( void )
+{
+	char	text[ 32 * METRIC_N ];
+
+	MetricsExport( text, sizeof text );
+	printf( "Metrics:\n%s", text );
+} // PrintMetrics
+
+#ifdef TRACE_EVENTS
+static void WriteTrace( void )
+{
+	static char	text[ TRACE_EVENTS_EXPORT_SIZE ];
+	FILE	*file = fopen( TRACE_EVENTS_FILE, "w" );
+
+	if (file) {
+		fwrite( text, 1, TraceEventsExport( text, sizeof text ), file );
+		fclose( file );
+	}
+} // WriteTrace
+#endif
+
+void HalInitClock( void )
+{
+	if (! SimIsReset()) { // Booted by main() rather than by a test harness.
+		SimReset();
+		TypeStandardInput();
+		atexit( PrintMetrics );  // After the simulation's statistics
+#ifdef TRACE_EVENTS
+		atexit( WriteTrace );
+#endif
+	}
+} // HalInitClock, the simulated clock needs no more setting up.
+
+void HalWaitMicrosec( long int wait_microsecs )
+{
+	SimWaitMicrosec( wait_microsecs );
+} // HalWaitMicrosec
+
+void PendScheduler( void )
+{
+	VirtualClockPendInterrupt( SchedulerRun );
+} // PendScheduler, as PendSV on the Tiva
+
+void WaitForInterrupt( void )
+{
+	SimWaitForInterrupt();
+} // WaitForInterrupt
+
+// ------------------------ GPIO port bits ------------------------
+
+void HalInitLCDPins( void )
+{
+} // HalInitLCDPins, no ports to set up on the host.
+
+void HalWriteLCD_RS( unsigned long value )
+{
+	SimWriteLCD_RS( value );
+} // HalWriteLCD_RS
+
+void HalWriteLCD_EN( unsigned long value )
+{
+	SimWriteLCD_EN( value );
+} // HalWriteLCD_EN
+
+void HalWriteLCD_DATA( unsigned long value )
+{
+	SimWriteLCD_DATA( value );
+} // HalWriteLCD_DATA
+
+static void GPIOPortE_Handler( void )
+// The simulated port E interrupt, as on the Tiva.
+{
+	KeyEventsRowEdge();  // Start debouncing; acknowledges the interrupt
+} // GPIOPortE_Handler
+
+void HalInitKeypadPins( void )
+{
+	SimKeypadSetInterrupt( GPIOPortE_Handler );
+	SimKeypadArmInterrupt( 0 );  // Until InitKeyboardPorts() arms it
+} // HalInitKeypadPins
+
+void HalWriteKeypadCols( unsigned char nibble )
+{
+	SimWriteKeyboardCol( nibble );
+} // HalWriteKeypadCols
+
+unsigned char HalReadKeypadRows( void )
+{
+	return SimReadKeyboardRow() & 0x0F;
+} // HalReadKeypadRows
+
+void HalAckKeypadInterrupt( void )
+{
+	SimKeypadAckInterrupt();
+} // HalAckKeypadInterrupt
+
+void HalArmKeypadInterrupt( int arm )
+{
+	SimKeypadArmInterrupt( arm );
+} // HalArmKeypadInterrupt
+
+// ------------------------ Flash ------------------------
+
+/* The flash is emulated by host_sim, and lasts for the life of the process
+ * (like the Tiva's flash between power-ups). */
+
+static void FLASH_Handler( void )
+// The simulated flash interrupt, as on the Tiva.
+{
+	FlashLogOperationDone();  // Start the next word, if any
+} // FLASH_Handler
+
+void HalInitFlash( void )
+{
+	SimFlashSetInterrupt( FLASH_Handler );
+} // HalInitFlash
+
+int HalFlashBusy( unsigned long operations )
+{
+	return (operations & (HAL_FLASH_WRITE | HAL_FLASH_ERASE)) && SimFlashBusy();
+} // HalFlashBusy, registers are committed at once on the host.
+
+unsigned long HalFlashReadWord( unsigned long address )
+{
+	return SimFlashReadWord( address );
+} // HalFlashReadWord
+
+void HalFlashStartWriteWord( unsigned long address, unsigned long word )
+{
+	SimFlashWriteWord( address, word );
+} // HalFlashStartWriteWord, FLASH_Handler() runs when it is done
+
+void HalFlashStartErasePage( unsigned long address )
+{
+	SimFlashErasePage( address );
+} // HalFlashStartErasePage, FLASH_Handler() runs when it is done
@@ -0,0 +1,300 @@
+/* hal_tiva.c
+ *
+ * Tiva (TM4C123) implementation of hal.h: the port, flash and core
+ * registers, and the interrupt handlers which go with them.
+ *
+ * The port allocations are those of Appendix C of the Mini-project Handout,
+ * copied into the comment at the start of each port below.
+ *
+ * For documentation, see the corresponding .h file.
+ */
+
+#include "PLL.h"
+#include "time_source.h"
+#include "scheduler.h"
+#include "key_events.h"
+#include "flash_log.h"
+#include "low_level_funcs_tiva.h"
+#include "hal.h"
+
+// =========================== CONSTANTS ============================
+
+// --------------------------- Ports -------------------------
+
+// Port A (bit 2 is EN, bit 3 is RS):
+#define GPIO_PORTA_DIR_R        (*((volatile unsigned long *)0x40004400))
+#define GPIO_PORTA_AFSEL_R      (*((volatile unsigned long *)0x40004420))
+#define GPIO_PORTA_DEN_R        (*((volatile unsigned long *)0x4000451C))
+#define GPIO_PORTA_LOCK_R       (*((volatile unsigned long *)0x40004520))
+#define GPIO_PORTA_CR_R         (*((volatile unsigned long *)0x40004524))
+#define GPIO_PORTA_AMSEL_R      (*((volatile unsigned long *)0x40004528))
+#define GPIO_PORTA_PCTL_R       (*((volatile unsigned long *)0x4000452C))
+
+// Port B (PORTB[2:5] are LCD DB4 to DB7):
+#define GPIO_PORTB_DIR_R        (*((volatile unsigned long *)0x40005400))
+#define GPIO_PORTB_AFSEL_R      (*((volatile unsigned long *)0x40005420))
+#define GPIO_PORTB_DEN_R        (*((volatile unsigned long *)0x4000551C))
+#define GPIO_PORTB_LOCK_R       (*((volatile unsigned long *)0x40005520))
+#define GPIO_PORTB_CR_R         (*((volatile unsigned long *)0x40005524))
+#define GPIO_PORTB_AMSEL_R      (*((volatile unsigned long *)0x40005528))
+#define GPIO_PORTB_PCTL_R       (*((volatile unsigned long *)0x4000552C))
+
+// Port D (PORTD[0:3] are the outputs to the columns):
+#define GPIO_PORTD_DATA_R       (*((volatile unsigned long *)0x400073FC))
+#define GPIO_PORTD_DIR_R        (*((volatile unsigned long *)0x40007400))
+#define GPIO_PORTD_AFSEL_R      (*((volatile unsigned long *)0x40007420))
+#define GPIO_PORTD_PUR_R        (*((volatile unsigned long *)0x40007510))
+#define GPIO_PORTD_DEN_R        (*((volatile unsigned long *)0x4000751C))
+#define GPIO_PORTD_LOCK_R       (*((volatile unsigned long *)0x40007520))
+#define GPIO_PORTD_CR_R         (*((volatile unsigned long *)0x40007524))
+#define GPIO_PORTD_AMSEL_R      (*((volatile unsigned long *)0x40007528))
+#define GPIO_PORTD_PCTL_R       (*((volatile unsigned long *)0x4000752C))
+
+// Port E (PORTE[0:3] are the inputs from the rows):
+#define GPIO_PORTE_DATA_R       (*((volatile unsigned long *)0x400243FC))
+#define GPIO_PORTE_DIR_R        (*((volatile unsigned long *)0x40024400))
+#define GPIO_PORTE_IS_R         (*((volatile unsigned long *)0x40024404))
+#define GPIO_PORTE_IBE_R        (*((volatile unsigned long *)0x40024408))
+#define GPIO_PORTE_IEV_R        (*((volatile unsigned long *)0x4002440C))
+#define GPIO_PORTE_IM_R         (*((volatile unsigned long *)0x40024410))
+#define GPIO_PORTE_ICR_R        (*((volatile unsigned long *)0x4002441C))
+#define GPIO_PORTE_AFSEL_R      (*((volatile unsigned long *)0x40024420))
+#define GPIO_PORTE_PUR_R        (*((volatile unsigned long *)0x40024510))
+#define GPIO_PORTE_PDR_R        (*((volatile unsigned long *)0x40024514))
+#define GPIO_PORTE_DEN_R        (*((volatile unsigned long *)0x4002451C))
+#define GPIO_PORTE_LOCK_R       (*((volatile unsigned long *)0x40024520))
+#define GPIO_PORTE_CR_R         (*((volatile unsigned long *)0x40024524))
+#define GPIO_PORTE_AMSEL_R      (*((volatile unsigned long *)0x40024528))
+#define GPIO_PORTE_PCTL_R       (*((volatile unsigned long *)0x4002452C))
+
+/* The LCD's pins, through the bit-banded addresses of their port bits, so
+ * that writing one leaves the others alone. */
+#define LCD_RS			(*((volatile unsigned long *)0x40004020)) /* Bit 3, connect to PA 3
+			 * The single port bit connected to the
+			 * RS (Register Select) pin of the LCD.
+			 */
+#define LCD_EN			(*((volatile unsigned long *)0x40004010)) /* Bit 2, connect to PA 2
+			 * The single port bit connected to the
+			 * EN (ENable data transfer) pin of the LCD.
+			 */
+#define LCD_DATA		(*((volatile unsigned long *)0x400053FC)) /* Bit 2 - 5, connect to PB2 - PB5
+			 * The set of four adjacent bits connected
+			 * to the four data transfer bits (DB4 to
+			 * DB7) of the LCD. */
+
+// --------------------------- Clocks --------------------------
+
+#define SYSCTL_RCGC2_R		(*((volatile unsigned long *)0x400FE108))	// GPIO clocks
+
+// NVIC: GPIO port E is interrupt 4
+#define NVIC_EN0_R            	(*((volatile unsigned long *)0xE000E100))
+#define NVIC_PRI1_R           	(*((volatile unsigned long *)0xE000E404))
+
+// NVIC: PendSV runs the scheduler (see scheduler.h)
+#define NVIC_INT_CTRL_R       	(*((volatile unsigned long *)0xE000ED04))  // Bit 28 sets PendSV pending
+#define NVIC_SYS_PRI3_R       	(*((volatile unsigned long *)0xE000ED20))  // PendSV priority is bits 23-21
+
+// ------------------- Flash memory definitions ----------------------
+#define FMA       (*((volatile unsigned long *)0x400FD000))  // Page 542, Base 0x400F.D000, Offset 0X000, flash memory address
+#define FMD       (*((volatile unsigned long *)0x400FD004))  // Page 543, Base 0x400F.D000, Offset 0x004, flash memory data
+#define FMC       (*((volatile unsigned long *)0x400FD008))  // Page 544, Base 0x400F.D000, Offset 0x008, flash memory control
+#define FCIM      (*((volatile unsigned long *)0x400FD010))  // Page 548, Base 0x400F.D000, Offset 0x010, flash controller interrupt mask
+#define FCMISC    (*((volatile unsigned long *)0x400FD014))  // Page 549, Base 0x400F.D000, Offset 0x014, flash controller masked interrupt status and clear
+#define BOOTCFG   (*((volatile unsigned long *)0x400FE1D0))  // Page 581, Base 0x400F.E000, Offset 0x1D0, boot configuration
+#define NVIC_PRI7_R           	(*((volatile unsigned long *)0xE000E41C))  // Flash is interrupt 29
+
+const int	hal_boot_welcome = 1;
+
+// =========================== FUNCTIONS ============================
+
+// ------------------------ Clock and time ------------------------
+
+void HalInitClock( void )
+{
+	PLL_Init();
+	SysTick_Init();
+	NVIC_SYS_PRI3_R = (NVIC_SYS_PRI3_R & 0xFF1FFFFF) | 0x00E00000; // PendSV priority 7, the lowest
+} // HalInitClock
+
+void HalWaitMicrosec( long int wait_microsecs )
+{
+	TimeWaitMicrosec( wait_microsecs );  // See time_source_tiva
+} // HalWaitMicrosec
+
+void PendScheduler( void )
+{
+	NVIC_INT_CTRL_R = 0x10000000;  // PENDSVSET: taken once no other interrupt is active
+} // PendScheduler
+
+void PendSV_Handler( void )
+{
+	SchedulerRun();  // The tasks, see scheduler.h
+} // PendSV_Handler
+
+// ------------------------ GPIO port bits ------------------------
+
+void HalInitLCDPins( void )
+{
+	volatile unsigned long delay;
+	SYSCTL_RCGC2_R |= 0x00000001;      // port A and B clock
+  delay = SYSCTL_RCGC2_R;            // delay
+  GPIO_PORTA_LOCK_R = 0x4C4F434B;    // unlock PortA
+  GPIO_PORTA_CR_R |= 0x0C;           // allow changes to PA3-2
+  GPIO_PORTA_AMSEL_R &= 0x00;        // disable analog function
+  GPIO_PORTA_PCTL_R &= 0x00000000;   // GPIO clear bit PCTL
+  GPIO_PORTA_DIR_R |= 0x0C;          // set PA3-2 are outputs
+  GPIO_PORTA_AFSEL_R &= 0x00;        // no alternate function
+  GPIO_PORTA_DEN_R |= 0x0C;          // enable digital pins PA3-2
+
+	volatile unsigned long delay2;
+	SYSCTL_RCGC2_R |= 0x00000002;
+	delay2 = SYSCTL_RCGC2_R;
+	GPIO_PORTB_LOCK_R = 0x4C4F434B;    // unlock PortB
+  GPIO_PORTB_CR_R |= 0x3C;           // allow changes to PB5-2
+  GPIO_PORTB_AMSEL_R &= 0x00;        // disable analog function
+  GPIO_PORTB_PCTL_R &= 0x00000000;   // GPIO clear bit PCTL
+  GPIO_PORTB_DIR_R |= 0x3C;          // set PB5-2 as output
+  GPIO_PORTB_AFSEL_R &= 0x00;        // no alternate function
+  GPIO_PORTB_DEN_R |= 0x3C;          // enable digital pins PB5-2
+} // HalInitLCDPins, the LCD uses port A and port B
+
+void HalWriteLCD_RS( unsigned long value )
+{
+	LCD_RS = value;
+} // HalWriteLCD_RS
+
+void HalWriteLCD_EN( unsigned long value )
+{
+	LCD_EN = value;
+} // HalWriteLCD_EN
+
+void HalWriteLCD_DATA( unsigned long value )
+{
+	LCD_DATA = value;
+} // HalWriteLCD_DATA
+
+void HalInitKeypadPins( void )
+{
+	volatile unsigned long delay;
+	SYSCTL_RCGC2_R |= 0x00000018;      // port D and E clock
+  delay = SYSCTL_RCGC2_R;            // delay
+
+	GPIO_PORTD_LOCK_R = 0x4C4F434B;    // unlock PortD
+  GPIO_PORTD_CR_R |= 0x0F;           // allow changes to PD3-0
+  GPIO_PORTD_AMSEL_R &= ~0x0F;       // disable analog function
+	GPIO_PORTD_PCTL_R &= ~0x000FFFF0;  // GPIO clear bit PCTL
+  GPIO_PORTD_DIR_R |= 0x0F;          // set PD3-0 as output
+  GPIO_PORTD_AFSEL_R = ~0x0F;        // no alternate function
+  GPIO_PORTD_DEN_R |= 0x0F;          // enable digital pins PD3-0
+	GPIO_PORTD_PUR_R = 0x00;           // Disable pullup resistors on PD0-3
+
+  GPIO_PORTE_LOCK_R = 0x4C4F434B;    // unlock PortE
+  GPIO_PORTE_CR_R |= 0x0F;           // allow changes to PE3-0
+  GPIO_PORTE_AMSEL_R &= ~0x0F;       // disable analog function
+  GPIO_PORTE_PCTL_R &= ~0x000FFFF0;  // GPIO clear bit PCTL
+  GPIO_PORTE_DIR_R &= ~0x0F;         // set PE3-0 are inputs
+  GPIO_PORTE_AFSEL_R &= ~0x0F;       // no alternate function
+	GPIO_PORTE_PUR_R = 0x00;           // Disable pullup resistors on PE0-3
+	GPIO_PORTE_PDR_R = 0x0F;           // enable pull-down resistors on PE3-0
+  GPIO_PORTE_DEN_R |= 0x0F;          // enable digital pins PE3-0
+
+	GPIO_PORTE_IM_R &= ~0x0F;          // disarmed until InitKeyboardPorts() arms it
+	GPIO_PORTE_IS_R &= ~0x0F;          // PE3-0 are edge-sensitive
+	GPIO_PORTE_IBE_R &= ~0x0F;         // not both edges
+	GPIO_PORTE_IEV_R |= 0x0F;          // rising edge, i.e. key pressed
+	GPIO_PORTE_ICR_R = 0x0F;           // clear flags
+	NVIC_PRI1_R = (NVIC_PRI1_R & 0xFFFFFF00) | 0x00000060; // priority 3
+	NVIC_EN0_R = 0x00000010;           // enable interrupt 4 in NVIC
+} // HalInitKeypadPins, the keyboard uses port D and port E.
+
+void HalWriteKeypadCols( unsigned char nibble )
+{
+	GPIO_PORTD_DATA_R = nibble;
+
+	unsigned char check;
+	check = GPIO_PORTD_DATA_R;
+	if (check != nibble) {  // Check whether exact one bit has been set
+		do{
+			GPIO_PORTD_DATA_R = nibble;
+			check = GPIO_PORTD_DATA_R;
+		}while(check != nibble);  // Set nibble to Port D until success
+	}
+} // HalWriteKeypadCols
+
+unsigned char HalReadKeypadRows( void )
+{
+	return GPIO_PORTE_DATA_R & 0x0F;  // Get the input from port E
+} // HalReadKeypadRows
+
+void HalAckKeypadInterrupt( void )
+{
+	GPIO_PORTE_ICR_R = 0x0F;  // Clear the flags of PE3-0
+} // HalAckKeypadInterrupt
+
+void HalArmKeypadInterrupt( int arm )
+{
+	if (arm) {
+		GPIO_PORTE_IM_R |= 0x0F;  // Arm interrupt on PE3-0
+	} else {
+		GPIO_PORTE_IM_R &= ~0x0F;  // Disarm it
+	}
+} // HalArmKeypadInterrupt
+
+void GPIOPortE_Handler( void )
+{
+	KeyEventsRowEdge();  // Start debouncing; acknowledges the interrupt
+} // GPIOPortE_Handler
+
+// ------------------------ Flash ------------------------
+
+static void WaitFlash( unsigned long operations )
+// As Done_Check(), which is above the HAL.
+{
+	while (HalFlashBusy( operations ))
+		TimeWaitMicrosec( 10 );
+} // WaitFlash
+
+void HalInitFlash( void )
+{
+	FMA |= 0x0000;  // Reset flash memory address
+	WaitFlash( HAL_FLASH_COMMIT );
+	FMD |= 0x0000;  // Reset flash memory data
+	WaitFlash( HAL_FLASH_COMMIT );
+	FMC |= 0x0000;  // Reset flash memory control
+	WaitFlash( HAL_FLASH_COMMIT );
+	BOOTCFG |= 0x0010;  // 0xA442 is used as the WRKEY in the FMC register
+	WaitFlash( HAL_FLASH_COMMIT );
+	FCMISC = 0x02;  // Clear any old program/erase completion
+	FCIM |= 0x02;  // Interrupt when a program or erase completes
+	NVIC_PRI7_R = (NVIC_PRI7_R & 0xFFFF1FFF) | 0x00006000; // priority 3
+	NVIC_EN0_R = 1 << 29;  // enable interrupt 29 in NVIC
+} // HalInitFlash
+
+int HalFlashBusy( unsigned long operations )
+{
+	return (FMC & operations) != 0;  // The FMC's bits clear when each is done
+} // HalFlashBusy
+
+unsigned long HalFlashReadWord( unsigned long address )
+{
+	return *(const volatile unsigned long *)address;  // Flash is memory-mapped from 0
+} // HalFlashReadWord
+
+void HalFlashStartWriteWord( unsigned long address, unsigned long word )
+{
+	FMD = word;  // Write the word to the FMD
+	FMA = address;  // Choose the flash memory address to store to
+	FMC = 0xA4420001;  // Write the value into WRKEY and WRITE field to process the write operation
+} // HalFlashStartWriteWord, FLASH_Handler() runs when it is done
+
+void HalFlashStartErasePage( unsigned long address )
+{
+	FMA = address & ~(FLASH_PAGE_SIZE - 1);  // Choose the page
+	FMC = 0xA4420002;  // WRKEY and ERASE
+} // HalFlashStartErasePage, FLASH_Handler() runs when it is done
+
+void FLASH_Handler( void )
+{
+	FCMISC = 0x02;  // Acknowledge the completion
+	FlashLogOperationDone();  // Start the next word, if any
+} // FLASH_Handler
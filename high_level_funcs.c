@@ -12,139 +12,131 @@
 #include "high_level_funcs.h"
 #include "mid_level_funcs.h"
 #include "low_level_funcs_tiva.h"
+#include "key_events.h"
+#include "ui_snapshot.h"
+#include "input_editor.h"
+#include "format_double.h"
+#include "display_task.h"
+#include "trace_events.h"
+
+/* Holding Rubout (#) deletes repeatedly. Override with -D to change; a
+ * delay of 0 turns auto-repeat off. */
+#ifndef RUBOUT_REPEAT_DELAY_US
+#define RUBOUT_REPEAT_DELAY_US		500000	// Hold this long before repeating,
+#endif
+#ifndef RUBOUT_REPEAT_INTERVAL_US
+#define RUBOUT_REPEAT_INTERVAL_US	100000	// then repeat at this interval.
+#endif
+#ifndef INPUT_FULL_MESSAGE_US
+#define INPUT_FULL_MESSAGE_US		1000000	// "Input full" shows on line 2 this long
+#endif
+#define RUBOUT_ROW	3  // # is row 3, column 2 in KeyboardRowCol2Char()
+#define RUBOUT_COL	2
+
+
+/* What each key does, unshifted and shifted: a character to insert, or one
+ * of the editing actions below. Shift (D) is a lock, so it stays on while
+ * the cursor is moved several places. Typing a character turns it off, so
+ * the 4 or 6 after an x, / or E is a digit, not a cursor move. */
+#define NO_ACTION	'\0'
+#define SHIFT		'\x01'
+#define END_INPUT	'\x02'
+#define RUBOUT		'\x03'
+#define RUBOUT_ALL	'\x04'
+#define CURSOR_LEFT	'\x05'
+#define CURSOR_RIGHT	'\x06'
+
+static const char keys[] = "0123456789ABCD*#";
+static const char key_actions[16][2] = {  // In the order of keys[]
+	{'0', '0'}, {'1', '1'}, {'2', '2'}, {'3', '3'},
+	{'4', CURSOR_LEFT}, {'5', '5'}, {'6', CURSOR_RIGHT}, {'7', '7'},
+	{'8', '8'}, {'9', '9'},
+	{'+', 'x'}, {'-', '/'}, {'.', 'E'}, {SHIFT, SHIFT},
+	{END_INPUT, END_INPUT}, {RUBOUT, RUBOUT_ALL}
+};
 
 
 // ------------------------ Keyboard functions ---------------------
 
+static char KeyAction( char key, int shift )
+{
+	int i;
+	for (i = 0; keys[i] != '\0'; i++) {
+		if (keys[i] == key) {
+			return key_actions[i][shift];
+		}
+	}
+	return NO_ACTION;
+} // KeyAction
+
 void ReadAndEchoInput( char *input_buffer, int input_buffer_size )
 {
-	char key;
-	int shift = 0;  // If SHIFT is pressed, it changes to 1
-	int input = 1;  // If * is pressed, it changes to 0
-	int keypressed_1 = 0;  // If any key be pressed, it changes to 0
-	
-	for(int i = input_buffer_size; i >= 0;  i--) {  // Clean the input_buffer
-        input_buffer[i] = '\0';
-			}
-	input_buffer_size = 0;  // The input_buffer_size of input_buffer
-/*--------------------------------------------------------------------------------------- */	
-	while (keypressed_1 == 0) {
-	  char read = 'n';
-	  read = GetKeyboardChar();
-		
-	  if ((read != 'n') && (read != '*')) { // If the user typed equals immediately, leave the previous answer to be displayed
-		  keypressed_1 = 1;
-			ClearDisplay();
-			TurnCursorOnOff(1);
+	InputEditor editor;
+	char key = 'n';  // 'n' until a key is read
+	char action;
+	int shift = 0;  // Toggled by each Shift (D)
+	int length;  // Of an input restored after a power cycle, or -1
+	int cursor = 0;
+	int first = 0;  // The first character shown
+
+	TraceBegin("ReadAndEchoInput");  // See trace_events.h
+	KeyEventsSetRepeat( RUBOUT_ROW, RUBOUT_COL, RUBOUT_REPEAT_DELAY_US,
+			    RUBOUT_REPEAT_INTERVAL_US );
+	length = UiSnapshotResumeInput( input_buffer, input_buffer_size, &shift, &cursor, &first );
+	if (length < 0) {  // Otherwise the restored screen shows it, with the cursor in it
+		while (key == 'n' || key == '*') {  // If the user typed equals immediately, leave the previous answer to be displayed
+			key = GetKeyboardChar();
 		}
-		WaitMicrosec(1);  // Wait 1 us
-	}  // Wait until one key is pressed and clear the LCD
-/*--------------------------------------------------------------------------------------- */
-	while (input == 1) {  // User now can input keys into input_buffer until * be pressed
-		int keypressed_2 = 0;  // If any key be pressed, it changes to 1
-		while (keypressed_2 == 0) {
-		  char read = 'n';
-		  read = GetKeyboardChar();
-		  if (read != 'n') {
-			  keypressed_2 = 1;
-				key = read;
-			}
-			WaitMicrosec(1);  // Wait 1 us
-		}  // Wait until one key is pressed
-	  
-		if (key == 'D' && shift == 0) {  // If shift is not actived, active it
-			shift = 1;
-/*--------------------------------------------------------------------------------------- */
-		} else if (key == 'D' && shift == 1) {  // If shift is actived, cancel shift
-		  shift = 0;
-/*--------------------------------------------------------------------------------------- */			
-		} else if (key == '*') {  // If * has be pressed, end the input
-			  input = 0;
-			  WaitMicrosec(1);
-			  TurnCursorOnOff(0);
-/*--------------------------------------------------------------------------------------- */			
-		} else if (key == 'A' && shift == 0) {  // Get + character
-		  if (input_buffer_size < 15) {
-		    input_buffer [input_buffer_size] = '+';
-			  input_buffer_size += 1;
-			} else {
-				LCDFlash();
-			}
-/*--------------------------------------------------------------------------------------- */		
-	  } else if (key == 'A' && shift == 1) {  // Get x character
-		  if (input_buffer_size < 16) {
-			  input_buffer [input_buffer_size] = 'x';
-			  input_buffer_size += 1;
-			} else {
-				LCDFlash();
-			}
-/*--------------------------------------------------------------------------------------- */		
-	  } else if (key == 'B' && shift == 0) {  // Get - character
-		  if (input_buffer_size < 16) {
-				input_buffer [input_buffer_size] = '-';
-			  input_buffer_size += 1;
-			} else {
-				LCDFlash();
-			}
-/*--------------------------------------------------------------------------------------- */		
-		} else if (key == 'B' && shift == 1) {  // Get / character
-			if (input_buffer_size < 16) {
-				input_buffer [input_buffer_size] = '/';
-				input_buffer_size += 1;
-			} else {
-				LCDFlash();
-			}
-/*--------------------------------------------------------------------------------------- */		
-		} else if (key == 'C' && shift == 0) {  // Get . character
-			if (input_buffer_size < 16) {
-				input_buffer [input_buffer_size] = '.';
-				input_buffer_size += 1;
-			} else {
-				LCDFlash();
-			}
-/*--------------------------------------------------------------------------------------- */		
-		} else if (key == 'C' && shift == 1) {  // Get E character
-			if (input_buffer_size < 16) {
-			  input_buffer [input_buffer_size] = 'E';
-				input_buffer_size += 1;
-			} else {
-				LCDFlash();
-			}
-/*--------------------------------------------------------------------------------------- */		
-		} else if (key == '#' && shift == 0) {  // Get rubout signal
-			if (input_buffer_size > 0) {
-				input_buffer [input_buffer_size-1] = '\0' ;
-				input_buffer_size -= 1;
-			} 
-/*--------------------------------------------------------------------------------------- */
-		} else if (key == '#' && shift == 1) {  // Delete entire entry		 	
-		  for(int i = input_buffer_size; i >= 0;  i--) {
-        input_buffer[i] = '\0';
-			}
-			input_buffer_size=0;
-/*--------------------------------------------------------------------------------------- */		
-		} else {  // Get the normal number (0-9)
-		  if (input_buffer_size < 16) {
-				input_buffer [input_buffer_size] = key ;
-				input_buffer_size += 1;
-			} else {
-				LCDFlash();
+		ClearDisplay();  // Wait until one key is pressed and clear the LCD
+		TurnCursorOnOff(1);
+		length = 0;
+	}
+	EditorOpen(&editor, input_buffer, input_buffer_size, length, cursor, first);
+	UiSnapshotSetInput( &editor, shift );
+
+	while (1) {  // User now can edit the input until * is pressed
+		if (key == 'n') {
+			key = GetKeyboardChar();
+		}
+		action = KeyAction(key, shift);
+		key = 'n';  // Each key is used once
+		if (action == END_INPUT) {
+			break;
+		} else if (action == SHIFT) {
+			shift = ! shift;
+		} else if (action == RUBOUT) {
+			EditorRubout(&editor);
+		} else if (action == RUBOUT_ALL) {
+			EditorClearAll(&editor);
+		} else if (action == CURSOR_LEFT) {
+			EditorMove(&editor, -1);
+		} else if (action == CURSOR_RIGHT) {
+			EditorMove(&editor, 1);
+		} else if (action != NO_ACTION) {
+			shift = 0;  // A character ends the shift
+			if (! EditorInsert(&editor, action)) {
+				LCDFlash();  // Full: the key is ignored, and typing carries on
+				DisplayMessage(2, "  Input full", INPUT_FULL_MESSAGE_US);
 			}
 		}
-/*--------------------------------------------------------------------------------------- */			
-		ClearDisplay();
-		PrintString( 1, 1, input_buffer);  // After input one character, print current buffer
-		WaitMicrosec(200000); 
-	}  // End the input
+		UiSnapshotSetInput( &editor, shift );
+	}
+	EditorClose(&editor);
+	WaitMicrosec(1);
+	TurnCursorOnOff(0);
+	UiSnapshotSetInput( 0, shift );
+	TraceEnd("ReadAndEchoInput");
 } // ReadAndEchoInput
 
 // ------------------------ Display functions ------------------------
 
 void DisplayResult( double answer )
 {
-	char result[20];
+	char result[17];
+	if (UiSnapshotKeepScreen( answer ))
+		return;  // Restored after a power cycle, already showing it
 	SetPrintPosition(2,1);
-	sprintf(result, "%g", answer);  // Using shortest respresention
+	FormatDouble(answer, result, 16);  // Shortest digits that read back as the answer
 	PrintString( 2, 1, result);
 } // DisplayResult
 
@@ -105,6 +105,20 @@
  * 
  * This function will presumably call functions in \a mid_level_funcs to 
  * read each character from keyboard and print it to the LCD.
+ * 
+ * The input can also be edited part way along. With Shift on, 4 and 6 move 
+ * the cursor left and right, and characters are then inserted and rubbed 
+ * out at the cursor. Shift stays on until D is pressed again or a 
+ * character is typed, so the digits after x, / or E are digits. 
+ * Shift with Rubout deletes the whole entry. The text 
+ * is held in \a input_editor, which redraws only what each key changes. 
+ * An input longer than a line (\a input_buffer_size over 17) scrolls 
+ * sideways, using the LCD's display shift, to keep the cursor in view. 
+ * 
+ * If power was lost part way through an input, \a ui_snapshot restores it 
+ * on the screen at boot, and this carries on with it (and the shift state 
+ * and cursor) rather than waiting for a first key. Each key updates the 
+ * snapshot.
  */
 void ReadAndEchoInput( char *input_buffer, int input_buffer_size );
 
@@ -154,10 +168,17 @@ void ReadAndEchoInput( char *input_buffer, int input_buffer_size );
  * function. You can then call PrintString() in \a mid_level_funcs with 
  * the string.
  * 
+ * This uses FormatDouble() (see \a format_double) instead: the shortest 
+ * digits that read back as \a answer, up to the 16 that fit, with no 
+ * printf engine in the image.
+ * 
  * Note that this function only needs to handle valid floating-point 
  * numbers. If the calculation produced anything invalid, e.g. from 
  * dividing by zero, CalculateAnswer() would have issued an error 
  * message.
+ * 
+ * The first call after \a ui_snapshot has restored the screen at boot, 
+ * with the answer that screen was showing, leaves the screen as it is.
  */
 void DisplayResult( double answer );
 
@@ -0,0 +1,823 @@
+/* host_sim.c
+ *
+ * Host (Linux/PC) simulation of the HD44780U LCD, the 4x4 keypad and
+ * the flash memory.
+ *
+ * For documentation, see the corresponding .h file.
+ * The LCD timings are from the Hitachi HD44780U datasheet (HD44780.pdf),
+ * Table 6 (instructions) and the bus timing characteristics.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "time_source.h"
+#include "virtual_clock.h"
+#include "low_level_funcs_tiva.h"
+#include "host_sim.h"
+
+// =========================== CONSTANTS ============================
+
+#define SIM_GPIO_ACCESS_NS	25	/* One GPIO access on the APB at
+			 * 80 MHz is two bus cycles. */
+#define SIM_IDLE_TIMEOUT_US	100000	/* Once the script is finished,
+			 * the firmware may poll the keypad this long before
+			 * the run is taken to be over. */
+#define SIM_BOUNCE_STEP_NS	100000	/* A bouncing contact may open or
+			 * close every 100 us. */
+#define SIM_MAX_SCRIPTED_KEYS	8192
+
+// HD44780U bus timing (datasheet, bus timing characteristics):
+#define LCD_EN_HIGH_MIN_NS	450	// PWEH, enable pulse width (high level).
+#define LCD_EN_CYCLE_MIN_NS	1000	// tcycE, enable cycle time.
+#define LCD_SETUP_MIN_NS	195	// tDSW, data set-up time before EN falls.
+#define LCD_POWER_ON_MIN_US	40000	/* More than 40 ms after Vcc rises
+			 * before the first instruction (figure 24). */
+
+// HD44780U execution times (Table 6, fosc = 270 kHz):
+#define LCD_EXEC_US		37	// Most instructions and data writes.
+#define LCD_CLEAR_HOME_US	1520	// Clear display and return home.
+#define LCD_INIT_FIRST_US	4100	// First 8-bit function set (figure 24).
+#define LCD_INIT_SECOND_US	100	// Second 8-bit function set (figure 24).
+
+#define LCD_DDRAM_SIZE		0x80
+#define LCD_LINE_LENGTH		40	// DDRAM characters per line in 2-line mode.
+#define LCD_VISIBLE_LENGTH	16
+#define LCD_LINE2_ADDRESS	0x40
+
+static const char keypad_matrix[4][4] = {
+	{'1', '2', '3', 'A'},
+	{'4', '5', '6', 'B'},
+	{'7', '8', '9', 'C'},
+	{'*', '0', '#', 'D'}
+}; // The same wiring as KeyboardRowCol2Char() in mid_level_funcs.
+
+// ======================= SIMULATION STATE ==========================
+
+typedef struct {
+	char	key;
+	unsigned long long	press_ns, release_ns;
+	unsigned long	bounce_ns;	// After each of the press and release.
+} ScriptedKey;
+
+static unsigned long long	stats_base_ns = 0;
+static SimStats	stats;
+static char	last_violation[80] = "";
+static void	(*idle_handler)( void ) = 0;
+static int	is_reset = 0;
+
+static struct {
+	// Pins:
+	int	rs, en;
+	unsigned char	nibble;		// DB7-DB4.
+	unsigned long long	en_rise_ns, data_change_ns, busy_until_ns;
+	int	ever_enabled;
+	// Interface:
+	int	four_bit, have_high_nibble, n_function_sets;
+	unsigned char	high_nibble;
+	// Controller:
+	int	two_line, display_on, cursor_on, blink_on;
+	int	increment, shift_on_entry, cgram_selected;
+	int	shift;			// Display shift, in characters.
+	unsigned char	address;	// Address counter (DDRAM).
+	char	ddram[LCD_DDRAM_SIZE];
+} lcd = { .increment = 1 };	/* Unwritten DDRAM (zero) reads as blank, so
+			 * this is the power-on state even without SimReset(). */
+
+static struct {
+	unsigned char	driven_cols;
+	unsigned long	bounce_us;	// For keys scripted from now on.
+	unsigned short	pressed;	// Bit row*4+col: keys pressed directly.
+	ScriptedKey	script[SIM_MAX_SCRIPTED_KEYS];
+	int	n_scripted, first_unreleased, n_press_counted;
+	unsigned long long	last_release_ns;
+	unsigned long long	echo_from_ns;	// Press awaiting its first LCD write.
+	int	awaiting_echo;
+	// Row edge interrupt (port E on the Tiva):
+	void	(*isr)( void );
+	unsigned char	row_level;	// Row inputs at the last update.
+	int	armed, irq_pending, in_isr;
+	SoftTimer	edge_timer;	// Fires at the next scripted press or release.
+} keypad;
+
+static struct {
+	int	erased;		// Zero until first used: then all ones.
+	unsigned long long	busy_until_ns;
+	void	(*isr)( void );	// Called when an operation completes.
+	SoftTimer	done_timer;
+	uint32_t	words[ SIM_FLASH_SIZE / 4 ];	// 32 bits, as on the Tiva.
+	unsigned long	page_erases[ SIM_FLASH_SIZE / FLASH_PAGE_SIZE ];
+} flash;
+
+// ======================= SIMULATION CONTROL ========================
+
+static unsigned long long Now( void )
+{
+	return VirtualClockNowNanosec();
+} // Now
+
+static void BusAccess( void )
+// Charge one GPIO access to simulated time.
+{
+	VirtualClockAdvanceNanosec( SIM_GPIO_ACCESS_NS );
+} // BusAccess
+
+static void DefaultIdleHandler( void )
+{
+	puts( "Host simulation: keypad script finished." );
+	SimPrintStats();
+	exit( EXIT_SUCCESS );
+} // DefaultIdleHandler
+
+static void Sleep( const unsigned long long *deadline_us );
+
+void SimReset( void )
+{
+	VirtualClockReset();
+	VirtualClockSetSleepHandler( Sleep );
+	stats_base_ns = 0;
+	memset( &stats, 0, sizeof stats );
+	last_violation[0] = '\0';
+
+	memset( &lcd, 0, sizeof lcd );
+	memset( lcd.ddram, ' ', sizeof lcd.ddram );
+	lcd.increment = 1;
+	lcd.en_rise_ns = lcd.data_change_ns = 0;
+
+	keypad.driven_cols = 0;
+	keypad.pressed = 0;
+	keypad.n_scripted = keypad.first_unreleased = keypad.n_press_counted = 0;
+	keypad.last_release_ns = 0;
+	keypad.bounce_us = 0;
+	keypad.awaiting_echo = 0;
+	keypad.isr = 0;
+	keypad.row_level = 0;
+	keypad.armed = keypad.irq_pending = keypad.in_isr = 0;
+
+	flash.busy_until_ns = 0; // Its contents are kept.
+	flash.isr = 0;
+	is_reset = 1;
+} // SimReset
+
+int SimIsReset( void )
+{
+	return is_reset;
+} // SimIsReset
+
+void SimWaitMicrosec( long int wait_microsecs )
+{
+	if (wait_microsecs <= 0)
+		return;
+	stats.wait_us += wait_microsecs;
+	TimeWaitMicrosec( wait_microsecs );
+} // SimWaitMicrosec
+
+void SimSetIdleHandler( void (*handler)( void ) )
+{
+	idle_handler = handler;
+} // SimSetIdleHandler
+
+// =========================== STATISTICS ============================
+
+void SimGetStats( SimStats *stats_out )
+{
+	stats.elapsed_us = (Now() - stats_base_ns) / 1000;
+	*stats_out = stats;
+} // SimGetStats
+
+void SimResetStats( void )
+{
+	memset( &stats, 0, sizeof stats );
+	stats_base_ns = Now();
+	TimeResetIdleStats();
+} // SimResetStats
+
+void SimPrintStats( void )
+{
+	SimStats	s;
+	TimeIdleStats	idle;
+	SimGetStats( &s );
+	printf( "\tSimulated time:\t\t%llu us (%llu us in WaitMicrosec)\n",
+		s.elapsed_us, s.wait_us );
+	printf( "\tLCD pin writes:\t\t%lu\n", s.lcd_pin_writes );
+	printf( "\tLCD nibbles:\t\t%lu\n", s.lcd_nibbles );
+	printf( "\tLCD instructions:\t%lu\n", s.lcd_instructions );
+	printf( "\tLCD data writes:\t%lu\n", s.lcd_data_writes );
+	printf( "\tKeypad col writes:\t%lu\n", s.key_col_writes );
+	printf( "\tKeypad row reads:\t%lu\n", s.key_row_reads );
+	printf( "\tKeys pressed:\t\t%lu\n", s.keys_pressed );
+	if (s.key_echoes)
+		printf( "\tKey to echo:\t\tmean %llu us, max %llu us\n",
+			s.key_echo_total_us / s.key_echoes, s.key_echo_max_us );
+	printf( "\tKeypad interrupts:\t%lu\n", s.key_interrupts );
+	printf( "\tFlash words written:\t%lu\n", s.flash_words_written );
+	printf( "\tFlash page erases:\t%lu\n", s.flash_page_erases );
+	if (s.flash_errors)
+		printf( "\tFlash errors:\t\t%lu\n", s.flash_errors );
+	TimeGetIdleStats( &idle );
+	printf( "\tAsleep:\t\t\t%llu us in %lu sleeps (%llu us deeply)\n",
+		idle.asleep_us, idle.sleeps, idle.deep_asleep_us );
+	printf( "\tAwake:\t\t\t%llu us\n", idle.awake_us );
+	printf( "\tTiming violations:\t%lu%s%s\n", s.timing_violations,
+		s.timing_violations ? "\tlast: " : "", last_violation );
+} // SimPrintStats
+
+const char *SimLastViolation( void )
+{
+	return last_violation;
+} // SimLastViolation
+
+static void Violation( const char *what )
+{
+	stats.timing_violations ++;
+	snprintf( last_violation, sizeof last_violation,
+		  "%s at %llu ns", what, Now() );
+} // Violation
+
+// ============================== LCD ================================
+
+static unsigned char NextAddress( unsigned char address, int increment )
+/* Step the address counter as the controller does. In 2-line mode the
+ * lines are 0x00-0x27 and 0x40-0x67, and the counter wraps between them. */
+{
+	if (lcd.two_line) {
+		if (increment)
+			return (address == 0x27) ? 0x40 : (address == 0x67) ? 0x00
+								: address + 1;
+		return (address == 0x00) ? 0x67 : (address == 0x40) ? 0x27
+							: address - 1;
+	}
+	if (increment)
+		return (address >= 0x4F) ? 0x00 : address + 1;
+	return (address == 0x00) ? 0x4F : address - 1;
+} // NextAddress
+
+static void ShiftView( int right )
+{
+	if (right)
+		lcd.shift = (lcd.shift + LCD_LINE_LENGTH - 1) % LCD_LINE_LENGTH;
+	else	lcd.shift = (lcd.shift + 1) % LCD_LINE_LENGTH;
+} // ShiftView
+
+static void Execute( int rs, unsigned char byte )
+// Carry out one complete instruction or data write, and set the busy time.
+{
+	unsigned long	exec_us = LCD_EXEC_US;
+
+	if (rs) { // Data write.
+		stats.lcd_data_writes ++;
+		if (! lcd.cgram_selected)
+			lcd.ddram[ lcd.address & 0x7F ] = byte;
+		lcd.address = NextAddress( lcd.address, lcd.increment );
+		if (lcd.shift_on_entry)
+			ShiftView( ! lcd.increment );
+	} else {
+		stats.lcd_instructions ++;
+		if (byte & 0x80) {		// Set DDRAM address.
+			lcd.address = byte & 0x7F;
+			lcd.cgram_selected = 0;
+		} else if (byte & 0x40) {	// Set CGRAM address.
+			lcd.cgram_selected = 1;
+		} else if (byte & 0x20) {	// Function set.
+			if (byte & 0x10) { // 8-bit: one of the init sequence.
+				lcd.n_function_sets ++;
+				if (lcd.n_function_sets == 1)
+					exec_us = LCD_INIT_FIRST_US;
+				else if (lcd.n_function_sets == 2)
+					exec_us = LCD_INIT_SECOND_US;
+			}
+			lcd.four_bit = ! (byte & 0x10);
+			lcd.two_line = (byte & 0x08) != 0;
+		} else if (byte & 0x10) {	// Cursor or display shift.
+			if (byte & 0x08)
+				ShiftView( byte & 0x04 );
+			else	lcd.address = NextAddress( lcd.address, byte & 0x04 );
+		} else if (byte & 0x08) {	// Display on/off control.
+			lcd.display_on = (byte & 0x04) != 0;
+			lcd.cursor_on = (byte & 0x02) != 0;
+			lcd.blink_on = (byte & 0x01) != 0;
+		} else if (byte & 0x04) {	// Entry mode set.
+			lcd.increment = (byte & 0x02) != 0;
+			lcd.shift_on_entry = (byte & 0x01) != 0;
+		} else if (byte & 0x02) {	// Return home.
+			lcd.address = 0;
+			lcd.shift = 0;
+			lcd.cgram_selected = 0;
+			exec_us = LCD_CLEAR_HOME_US;
+		} else if (byte & 0x01) {	// Clear display.
+			memset( lcd.ddram, ' ', sizeof lcd.ddram );
+			lcd.address = 0;
+			lcd.shift = 0;
+			lcd.increment = 1;
+			lcd.cgram_selected = 0;
+			exec_us = LCD_CLEAR_HOME_US;
+		}
+	}
+	lcd.busy_until_ns = Now() + exec_us * 1000ULL;
+} // Execute
+
+static void LatchNibble( void )
+// EN has fallen: the controller takes RS and DB7-DB4.
+{
+	int	starts_instruction = ! (lcd.four_bit && lcd.have_high_nibble);
+
+	stats.lcd_nibbles ++;
+	if (keypad.awaiting_echo) { // First LCD write since a key press.
+		unsigned long long	latency_us = (Now() - keypad.echo_from_ns) / 1000;
+		keypad.awaiting_echo = 0;
+		stats.key_echoes ++;
+		stats.key_echo_total_us += latency_us;
+		if (latency_us > stats.key_echo_max_us)
+			stats.key_echo_max_us = latency_us;
+	}
+	if (Now() - lcd.en_rise_ns < LCD_EN_HIGH_MIN_NS)
+		Violation( "EN pulse shorter than 450 ns" );
+	if (Now() - lcd.data_change_ns < LCD_SETUP_MIN_NS)
+		Violation( "RS/data set-up shorter than 195 ns" );
+	if (Now() < (unsigned long long)LCD_POWER_ON_MIN_US * 1000)
+		Violation( "instruction within 40 ms of power-on" );
+	else if (starts_instruction && Now() < lcd.busy_until_ns)
+		Violation( "instruction sent while LCD busy" );
+
+	if (! lcd.four_bit) { // 8-bit interface: DB3-DB0 are not connected.
+		Execute( lcd.rs, lcd.nibble << 4 );
+		return;
+	}
+	if (! lcd.have_high_nibble) {
+		lcd.high_nibble = lcd.nibble;
+		lcd.have_high_nibble = 1;
+		return;
+	}
+	lcd.have_high_nibble = 0;
+	Execute( lcd.rs, (lcd.high_nibble << 4) | lcd.nibble );
+} // LatchNibble
+
+void SimWriteLCD_RS( unsigned long value )
+{
+	int	rs = (value & 0x08) != 0;
+
+	stats.lcd_pin_writes ++;
+	BusAccess();
+	if (rs != lcd.rs)
+		lcd.data_change_ns = Now();
+	lcd.rs = rs;
+} // SimWriteLCD_RS
+
+void SimWriteLCD_DATA( unsigned long value )
+{
+	unsigned char	nibble = (value >> 2) & 0x0F; // PB2-PB5 are DB4-DB7.
+
+	stats.lcd_pin_writes ++;
+	BusAccess();
+	if (nibble != lcd.nibble)
+		lcd.data_change_ns = Now();
+	lcd.nibble = nibble;
+} // SimWriteLCD_DATA
+
+void SimWriteLCD_EN( unsigned long value )
+{
+	int	en = (value & 0x04) != 0;
+
+	stats.lcd_pin_writes ++;
+	BusAccess();
+	if (en && ! lcd.en) { // Rising edge.
+		if (lcd.ever_enabled && Now() - lcd.en_rise_ns < LCD_EN_CYCLE_MIN_NS)
+			Violation( "EN cycle shorter than 1000 ns" );
+		lcd.en_rise_ns = Now();
+		lcd.ever_enabled = 1;
+	} else if (! en && lcd.en) // Falling edge.
+		LatchNibble();
+	lcd.en = en;
+} // SimWriteLCD_EN
+
+void SimLCDGetLine( short int line, char *text )
+{
+	int	i, base = (line == 2) ? LCD_LINE2_ADDRESS : 0;
+
+	for (i=0; i < LCD_VISIBLE_LENGTH; i++) {
+		char	ch = lcd.ddram[ base + (i + lcd.shift) % LCD_LINE_LENGTH ];
+		text[i] = (lcd.display_on && ch >= ' ' && ch < 0x7F) ? ch : ' ';
+	}
+	text[ LCD_VISIBLE_LENGTH ] = '\0';
+} // SimLCDGetLine
+
+int SimLCDGetCursor( short int *line, short int *char_pos )
+{
+	int	base = (lcd.address >= LCD_LINE2_ADDRESS) ? LCD_LINE2_ADDRESS : 0;
+	int	column = (lcd.address - base - lcd.shift + LCD_LINE_LENGTH)
+							% LCD_LINE_LENGTH;
+
+	*line = base ? 2 : 1;
+	*char_pos = (column < LCD_VISIBLE_LENGTH) ? column + 1 : 0;
+	return lcd.display_on && (lcd.cursor_on || lcd.blink_on) && *char_pos;
+} // SimLCDGetCursor
+
+int SimLCDDisplayOn( void )
+{
+	return lcd.display_on;
+} // SimLCDDisplayOn
+
+// ============================ Keypad ===============================
+
+static int KeyIndex( char key )
+// Bit number (row*4 + col) of a key in the pressed mask, or -1.
+{
+	int	row, col;
+	for (row=0; row < 4; row++)
+		for (col=0; col < 4; col++)
+			if (keypad_matrix[row][col] == key)
+				return row*4 + col;
+	return -1;
+} // KeyIndex
+
+static unsigned char RowInputs( unsigned short mask )
+/* The row inputs given the keys down and the columns driven. The matrix
+ * has no diodes, so a row is high if any path of closed keys joins it to
+ * a driven column, perhaps through other rows and columns. That is how
+ * three keys at the corners of a rectangle make the fourth a ghost. (The
+ * simulation takes the driven column to win over undriven ones.) */
+{
+	unsigned char	rows = 0, cols = keypad.driven_cols, old_rows, old_cols;
+	int	row, col;
+
+	if (mask == 0)
+		return 0;
+	do {
+		old_rows = rows;
+		old_cols = cols;
+		for (row=0; row < 4; row++)
+			for (col=0; col < 4; col++)
+				if (mask & (1 << (row*4 + col))) {
+					if (cols & (1 << col))
+						rows |= 1 << row;
+					if (rows & (1 << row))
+						cols |= 1 << col;
+				}
+	} while (rows != old_rows || cols != old_cols);
+	return rows;
+} // RowInputs
+
+static void UpdateRowInputs( unsigned short mask )
+/* The keys or the driven columns may have changed: latch any rising edge
+ * of a row input, and interrupt if armed. As on the Tiva, the flag stays
+ * set until acknowledged, and the handler is not re-entered. */
+{
+	unsigned char	rows = RowInputs( mask );
+
+	if (rows & ~keypad.row_level)
+		keypad.irq_pending = 1;
+	keypad.row_level = rows;
+	if (keypad.irq_pending && keypad.armed && keypad.isr && ! keypad.in_isr) {
+		keypad.in_isr = 1;
+		stats.key_interrupts ++;
+		keypad.isr();
+		keypad.in_isr = 0;
+	}
+} // UpdateRowInputs
+
+static unsigned short PressedNow( void );
+
+static void ScriptEdge( void );
+
+static unsigned long long NextChange( const ScriptedKey *k )
+/* When the contact of scripted key k may next change: its press or
+ * release, or within their bounces the next step (see Bouncing()). 0 if
+ * it will not. */
+{
+	unsigned long long	now_ns = Now(), from_ns, end_ns;
+
+	if (now_ns < k->press_ns)
+		return k->press_ns;
+	if (now_ns < k->release_ns && now_ns >= k->press_ns + k->bounce_ns)
+		return k->release_ns;
+	from_ns = (now_ns < k->release_ns) ? k->press_ns : k->release_ns;
+	end_ns = from_ns + k->bounce_ns;
+	if (now_ns >= end_ns)
+		return 0;
+	from_ns += ((now_ns - from_ns) / SIM_BOUNCE_STEP_NS + 1) * SIM_BOUNCE_STEP_NS;
+	if (from_ns > end_ns)
+		from_ns = end_ns;
+	if (now_ns < k->release_ns && from_ns > k->release_ns)
+		from_ns = k->release_ns;
+	return from_ns;
+} // NextChange
+
+static void ScheduleScriptEdge( void )
+/* Set the edge timer for the next scripted press or release, or the next
+ * step of a bounce, if any. */
+{
+	unsigned long long	next_ns = 0;
+	int	i;
+
+	for (i = keypad.first_unreleased; i < keypad.n_scripted; i++) {
+		ScriptedKey	*k = &keypad.script[i];
+		unsigned long long	edge_ns = NextChange( k );
+		if (edge_ns > Now() && (next_ns == 0 || edge_ns < next_ns))
+			next_ns = edge_ns;
+		if (k->press_ns > Now())
+			break; // Later keys are pressed later still.
+	}
+	if (next_ns)
+		TimerStart( &keypad.edge_timer,
+			    (unsigned long)((next_ns + 999) / 1000 - Now() / 1000),
+			    ScriptEdge );
+	else	TimerStop( &keypad.edge_timer );
+} // ScheduleScriptEdge
+
+static void ScriptEdge( void )
+// Edge timer callback: a scripted key may just have gone down or up.
+{
+	UpdateRowInputs( PressedNow() );
+	ScheduleScriptEdge();
+} // ScriptEdge
+
+static int Bouncing( int i, unsigned long long since_ns, int closing )
+/* The contact of scripted key i, \a since_ns into its bounce after a
+ * press (\a closing) or a release. It first follows the key, then opens
+ * and closes pseudo-randomly, the same way on every run. */
+{
+	unsigned long	step = (unsigned long)(since_ns / SIM_BOUNCE_STEP_NS);
+	unsigned long	hash = (i + 1) * 2654435761UL ^ (step + 1) * 40503UL;
+
+	if (step == 0)
+		return closing;
+	return (hash >> 7) & 1;
+} // Bouncing
+
+static unsigned short PressedNow( void )
+// Mask of the keys whose contacts are closed at the current simulated time.
+{
+	unsigned short	mask = keypad.pressed;
+	int	i;
+
+	while (keypad.first_unreleased < keypad.n_scripted
+	       && keypad.script[ keypad.first_unreleased ].release_ns
+		  + keypad.script[ keypad.first_unreleased ].bounce_ns <= Now())
+		keypad.first_unreleased ++;
+	for (i = keypad.first_unreleased; i < keypad.n_scripted; i++) {
+		ScriptedKey	*k = &keypad.script[i];
+		int	closed;
+		if (k->press_ns > Now())
+			break; // Presses are in time order.
+		if (Now() < k->press_ns + k->bounce_ns)
+			closed = Bouncing( i, Now() - k->press_ns, 1 );
+		else if (Now() < k->release_ns)
+			closed = 1;
+		else if (Now() < k->release_ns + k->bounce_ns)
+			closed = Bouncing( i, Now() - k->release_ns, 0 );
+		else	closed = 0;
+		if (closed)
+			mask |= 1 << KeyIndex( k->key );
+		if (i >= keypad.n_press_counted) {
+			keypad.n_press_counted = i + 1;
+			stats.keys_pressed ++;
+			keypad.echo_from_ns = k->press_ns;
+			keypad.awaiting_echo = 1;
+		}
+	}
+	return mask;
+} // PressedNow
+
+void SimWriteKeyboardCol( unsigned char nibble )
+{
+	stats.key_col_writes ++;
+	BusAccess();
+	keypad.driven_cols = nibble & 0x0F;
+	UpdateRowInputs( PressedNow() );
+} // SimWriteKeyboardCol
+
+unsigned char SimReadKeyboardRow( void )
+{
+	unsigned short	mask;
+
+	stats.key_row_reads ++;
+	BusAccess();
+	mask = PressedNow();
+
+	if (mask == 0 && keypad.first_unreleased >= keypad.n_scripted
+	    && Now() >= keypad.last_release_ns + SIM_IDLE_TIMEOUT_US * 1000ULL) {
+		/* The firmware is waiting for a key which the script will
+		 * never press: the run is over. */
+		if (idle_handler)
+			idle_handler();
+		else	DefaultIdleHandler();
+	}
+
+	return RowInputs( mask );
+} // SimReadKeyboardRow
+
+void SimKeypadSetInterrupt( void (*handler)( void ) )
+{
+	keypad.isr = handler;
+	keypad.armed = (handler != 0);
+	keypad.irq_pending = 0;
+	keypad.row_level = RowInputs( PressedNow() );
+} // SimKeypadSetInterrupt
+
+void SimKeypadArmInterrupt( int arm )
+{
+	keypad.armed = arm;
+	if (arm)
+		UpdateRowInputs( PressedNow() ); // Interrupts at once if pending.
+} // SimKeypadArmInterrupt
+
+void SimKeypadAckInterrupt( void )
+{
+	keypad.irq_pending = 0;
+} // SimKeypadAckInterrupt
+
+static void Sleep( const unsigned long long *deadline_us )
+// The processor sleeps until an interrupt: see VirtualClockSetSleepHandler().
+{
+	if (keypad.irq_pending && keypad.armed && keypad.isr) { // WFI returns at once.
+		UpdateRowInputs( PressedNow() );
+		return;
+	}
+	if (! deadline_us) {
+		/* Nothing will ever wake the processor: the script is
+		 * finished and the run is over. */
+		if (idle_handler)
+			idle_handler();
+		else	DefaultIdleHandler();
+		return;
+	}
+	VirtualClockAdvanceTo( *deadline_us * 1000 ); // Scripted key edges are timers.
+} // Sleep
+
+void SimWaitForInterrupt( void )
+{
+	unsigned long long	deadline_us;
+
+	Sleep( TimerNextDeadline( &deadline_us ) ? &deadline_us : 0 );
+} // SimWaitForInterrupt
+
+int SimKeypadPress( char key )
+{
+	int	index = KeyIndex( key );
+	if (index < 0)
+		return -1;
+	if (! (keypad.pressed & (1 << index)))
+		stats.keys_pressed ++;
+	keypad.pressed |= 1 << index;
+	keypad.echo_from_ns = Now();
+	keypad.awaiting_echo = 1;
+	UpdateRowInputs( PressedNow() );
+	return 0;
+} // SimKeypadPress
+
+int SimKeypadRelease( char key )
+{
+	int	index = KeyIndex( key );
+	if (index < 0)
+		return -1;
+	keypad.pressed &= ~(1 << index);
+	if (keypad.last_release_ns < Now())
+		keypad.last_release_ns = Now();
+	UpdateRowInputs( PressedNow() );
+	return 0;
+} // SimKeypadRelease
+
+int SimKeypadScript( char key, unsigned long long press_at_us, unsigned long hold_us )
+{
+	ScriptedKey	*k;
+	unsigned long long	press_ns = press_at_us * 1000;
+
+	if (KeyIndex( key ) < 0 || keypad.n_scripted >= SIM_MAX_SCRIPTED_KEYS)
+		return -1;
+	if (keypad.n_scripted > 0
+	    && press_ns < keypad.script[ keypad.n_scripted-1 ].press_ns)
+		return -1; // Must be in time order.
+
+	k = &keypad.script[ keypad.n_scripted++ ];
+	k->key = key;
+	k->press_ns = press_ns;
+	k->release_ns = press_ns + hold_us * 1000ULL;
+	k->bounce_ns = keypad.bounce_us * 1000;
+	if (k->release_ns + k->bounce_ns > keypad.last_release_ns)
+		keypad.last_release_ns = k->release_ns + k->bounce_ns;
+	ScheduleScriptEdge();
+	return 0;
+} // SimKeypadScript
+
+int SimKeypadType( const char *keys, unsigned long gap_us, unsigned long hold_us )
+{
+	unsigned long long	at_us = keypad.last_release_ns / 1000;
+	int	n = 0;
+
+	if (at_us < Now() / 1000)
+		at_us = Now() / 1000;
+	for ( ; *keys; keys++) {
+		at_us += gap_us;
+		if (SimKeypadScript( *keys, at_us, hold_us ) != 0)
+			break;
+		at_us += hold_us;
+		n++;
+	}
+	return n;
+} // SimKeypadType
+
+void SimKeypadSetBounce( unsigned long bounce_us )
+{
+	keypad.bounce_us = bounce_us;
+} // SimKeypadSetBounce
+
+int SimKeypadScriptPending( void )
+{
+	PressedNow();
+	return keypad.first_unreleased < keypad.n_scripted;
+} // SimKeypadScriptPending
+
+// ============================= Flash ===============================
+
+void SimFlashReset( void )
+{
+	memset( flash.words, 0xFF, sizeof flash.words );
+	memset( flash.page_erases, 0, sizeof flash.page_erases );
+	flash.busy_until_ns = 0;
+	flash.erased = 1;
+} // SimFlashReset
+
+static uint32_t *FlashWord( unsigned long address )
+// The word at address, erasing the flash on first use. 0 if out of range.
+{
+	if (! flash.erased)
+		SimFlashReset();
+	if (address >= SIM_FLASH_SIZE || (address & 3) != 0)
+		return 0;
+	return &flash.words[ address / 4 ];
+} // FlashWord
+
+static void FlashDone( void )
+// Timer callback: the operation has completed.
+{
+	if (flash.isr)
+		flash.isr();
+} // FlashDone
+
+static int FlashStart( unsigned long busy_us )
+/* Start an operation which takes busy_us, interrupting when it is done.
+ * Zero, counted as an error, if busy. */
+{
+	if (SimFlashBusy()) {
+		stats.flash_errors ++;
+		return 0;
+	}
+	flash.busy_until_ns = (Now() / 1000 + busy_us) * 1000; // As the timer.
+	TimerStart( &flash.done_timer, busy_us, FlashDone );
+	return 1;
+} // FlashStart
+
+unsigned long SimFlashReadWord( unsigned long address )
+{
+	uint32_t	*word = FlashWord( address );
+
+	BusAccess();
+	return word ? *word : 0xFFFFFFFF;
+} // SimFlashReadWord
+
+void SimFlashWriteWord( unsigned long address, unsigned long value )
+{
+	uint32_t	*word = FlashWord( address );
+
+	BusAccess();
+	if (! word || ! FlashStart( SIM_FLASH_PROGRAM_US )) {
+		stats.flash_errors += (word == 0);
+		return;
+	}
+	if (~*word & value & 0xFFFFFFFF)
+		stats.flash_errors ++; // Would need an erase to set those bits.
+	*word &= value;
+	stats.flash_words_written ++;
+} // SimFlashWriteWord
+
+void SimFlashErasePage( unsigned long address )
+{
+	uint32_t	*word = FlashWord( address & ~(FLASH_PAGE_SIZE - 1UL) );
+
+	BusAccess();
+	if (! word || ! FlashStart( SIM_FLASH_ERASE_US )) {
+		stats.flash_errors += (word == 0);
+		return;
+	}
+	memset( word, 0xFF, FLASH_PAGE_SIZE );
+	flash.page_erases[ address / FLASH_PAGE_SIZE ] ++;
+	stats.flash_page_erases ++;
+} // SimFlashErasePage
+
+void SimFlashSetInterrupt( void (*handler)( void ) )
+{
+	flash.isr = handler;
+} // SimFlashSetInterrupt
+
+int SimFlashBusy( void )
+{
+	return Now() < flash.busy_until_ns;
+} // SimFlashBusy
+
+unsigned long SimFlashPageErases( unsigned long address )
+{
+	if (address >= SIM_FLASH_SIZE)
+		return 0;
+	return flash.page_erases[ address / FLASH_PAGE_SIZE ];
+} // SimFlashPageErases
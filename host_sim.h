@@ -0,0 +1,309 @@
+/*! \file host_sim.h
+ * Host (Linux/PC) simulation of the calculator hardware: the Hitachi HD44780U
+ * LCD on its 4-bit bus, the 4x4 keypad matrix and the flash memory.
+ *
+ * On the Tiva, \a hal_tiva writes the LCD_RS, LCD_EN and LCD_DATA port bits
+ * and drives/reads the keypad through ports D and E. On the host,
+ * \a hal_host makes exactly the same pin writes, but they land in the
+ * functions below instead of in GPIO registers. This lets the whole
+ * firmware, from main() down to \a low_level_funcs_tiva, run unmodified on
+ * a Linux build machine (see hal.h).
+ *
+ * The simulated LCD decodes the bus as the real controller does: it latches
+ * a nibble on each falling edge of EN, assembles bytes in 4-bit mode, and
+ * executes the instructions into DDRAM, the address counter, display shift
+ * and the display/cursor flags. It also checks the datasheet timings (EN
+ * pulse width, enable cycle time, data set-up, power-on delay and the
+ * busy time of each instruction) and counts every violation.
+ *
+ * The simulated keypad is a matrix of 16 switches. Keys are pressed either
+ * directly (SimKeypadPress()) or by a script of timed presses and releases
+ * in simulated time. ReadKeyboardRow() returns the rows of all pressed keys
+ * in the columns currently driven by WriteKeyboardCol(), as the real matrix
+ * does. It has no diodes either, so three keys at the corners of a
+ * rectangle make the fourth corner read as pressed (ghosting).
+ *
+ * Every pin write and row read is counted, and each advances simulated time
+ * (the \a virtual_clock) by one GPIO access. WaitMicrosec() advances
+ * simulated time instead of burning real time, so the display and input
+ * paths can be benchmarked in device microseconds. While the firmware
+ * sleeps in TimeIdle(), the clock skips straight to the next timer or
+ * scripted key edge, so long scripted sessions also run quickly; the time
+ * asleep and awake is in TimeGetIdleStats().
+ * Scripted keys may bounce (SimKeypadSetBounce()), to exercise debouncing.
+ *
+ * The flash is emulated too: words program from 1 to 0 only, pages erase
+ * to all ones, each operation keeps the flash busy for a while in
+ * simulated time and interrupts when it completes, and the erases of every
+ * page are counted.
+ *
+ * A typical host build (see test_host_sim.c) is
+ * 	gcc -std=c99 -o test_host_sim test_host_sim.c host_sim.c
+ * 		virtual_clock.c time_source.c key_events.c crc.c flash_log.c
+ * 		answer_store.c boot_timeline.c ui_snapshot.c format_double.c
+ * 		Welcome.c low_level_funcs_tiva.c hal_host.c mid_level_funcs.c
+ * 		high_level_funcs.c calculate_answer.c metrics.c -lm
+ */
+
+#ifndef HOST_SIM_H
+#define HOST_SIM_H
+
+//! \name Simulation control
+//@{
+
+/*! Power-on reset of the whole simulation.
+ *
+ * Simulated time (the \a virtual_clock) goes back to zero and its timers
+ * are stopped, the LCD returns to its power-on state
+ * (8-bit interface, display off, DDRAM blank), the keypad script is emptied
+ * and all statistics are cleared.
+ */
+void SimReset( void );
+
+/*! Non-zero once SimReset() has been called. A test harness resets the
+ * simulation before each power-up; a host build of main() does not, so
+ * \a hal_host resets it at the start of the boot instead.
+ */
+int SimIsReset( void );
+
+/*! The host WaitMicrosec(): advance simulated time, counting it as waiting.
+ *
+ * \param [in] wait_microsecs The time (in microseconds) to delay.
+ */
+void SimWaitMicrosec( long int wait_microsecs );
+
+/*! Set the function called when the firmware waits for a key that the
+ * script will never press.
+ *
+ * \param [in] handler The function to call, or 0 for the default,
+ * 		which prints the statistics and exits the program.
+ *
+ * This is how a host run of main() (which never returns) ends. A test
+ * harness will usually install a handler which longjmp()s back to itself.
+ */
+void SimSetIdleHandler( void (*handler)( void ) );
+
+//@}
+// End of Simulation control
+
+//! \name Statistics
+//@{
+
+/*! Bus-level accounting of a simulated run.
+ */
+typedef struct {
+	unsigned long long	elapsed_us;	//!< Simulated time since the counters were zeroed.
+	unsigned long long	wait_us;	//!< Of which spent in WaitMicrosec().
+	unsigned long	lcd_pin_writes;		//!< Writes to LCD_RS, LCD_EN and LCD_DATA.
+	unsigned long	lcd_nibbles;		//!< Nibbles latched by EN falling.
+	unsigned long	lcd_instructions;	//!< Complete instructions executed.
+	unsigned long	lcd_data_writes;	//!< Complete data bytes written.
+	unsigned long	key_col_writes;		//!< Calls of WriteKeyboardCol().
+	unsigned long	key_row_reads;		//!< Calls of ReadKeyboardRow().
+	unsigned long	keys_pressed;		//!< Scripted and direct key presses.
+	unsigned long	timing_violations;	//!< All LCD timing violations.
+	unsigned long	key_echoes;		//!< Key presses followed by an LCD write.
+	unsigned long long	key_echo_total_us;	//!< Sum of their press-to-LCD-write times.
+	unsigned long long	key_echo_max_us;	//!< The longest of them.
+	unsigned long	key_interrupts;		//!< Calls of the keypad interrupt handler.
+	unsigned long	flash_words_written;	//!< Words programmed into the flash.
+	unsigned long	flash_page_erases;	//!< Pages erased.
+	unsigned long	flash_errors;		//!< Writes that would set a bit, or while busy.
+} SimStats;
+
+/*! Copy the current statistics into \a stats.
+ */
+void SimGetStats( SimStats *stats );
+
+/*! Zero the counters without disturbing the simulated hardware or time.
+ * The residency counters of TimeGetIdleStats() are zeroed too.
+ *
+ * Useful for measuring one operation: zero, do it, then SimGetStats().
+ */
+void SimResetStats( void );
+
+/*! Print the statistics to stdout.
+ */
+void SimPrintStats( void );
+
+/*! The most recent LCD timing violation as text, or "" if there has been none.
+ */
+const char *SimLastViolation( void );
+
+//@}
+// End of Statistics
+
+//! \name LCD pins and inspection
+//@{
+
+/*! Pin writes, made by \a hal_host where the Tiva writes the
+ * LCD_RS, LCD_EN and LCD_DATA port bits. The values are those which would
+ * be written to the port, e.g. LCD_RS is 0x08 for data and LCD_DATA holds
+ * DB4-DB7 in bits 2-5.
+ */
+void SimWriteLCD_RS( unsigned long value );
+void SimWriteLCD_EN( unsigned long value );		//!< \copydoc SimWriteLCD_RS
+void SimWriteLCD_DATA( unsigned long value );		//!< \copydoc SimWriteLCD_RS
+
+/*! Copy the 16 visible characters of one display line into \a text.
+ *
+ * \param [in] line The line number, 1 for top or 2 for bottom.
+ * \param [out] text At least 17 chars. A blank or switched-off display
+ * 		gives spaces; the string is always null-terminated.
+ */
+void SimLCDGetLine( short int line, char *text );
+
+/*! Report where the cursor is.
+ *
+ * \param [out] line The line number, 1 or 2.
+ * \param [out] char_pos The position from 1 to 16, or 0 if the address
+ * 		counter is outside the visible window.
+ * \return Non-zero if the cursor is currently displayed.
+ */
+int SimLCDGetCursor( short int *line, short int *char_pos );
+
+/*! Non-zero if the display is switched on (Display Control D bit).
+ */
+int SimLCDDisplayOn( void );
+
+//@}
+// End of LCD pins and inspection
+
+//! \name Keypad matrix
+//@{
+
+/*! Column write and row read, made by \a hal_host where the
+ * Tiva writes port D and reads port E. The bit allocation is the one the
+ * mid-level decoding uses: column and row bit n (0x01 << n) select matrix
+ * column and row n of KeyboardRowCol2Char(), counting from 0.
+ */
+void SimWriteKeyboardCol( unsigned char nibble );
+unsigned char SimReadKeyboardRow( void );		//!< \copydoc SimWriteKeyboardCol
+
+/*! Arm the row-input edge interrupt (port E on the Tiva).
+ *
+ * \param [in] handler The interrupt handler, or 0 to disarm.
+ *
+ * Once armed, a rising edge on any row input (a key going down in a
+ * driven column, or a column being driven while its key is down) sets the
+ * interrupt flag and calls \a handler, unless it is already running. The
+ * flag stays set until SimKeypadAckInterrupt().
+ */
+void SimKeypadSetInterrupt( void (*handler)( void ) );
+
+/*! Clear the row-input edge interrupt flag.
+ */
+void SimKeypadAckInterrupt( void );
+
+/*! Arm or disarm the row-input edge interrupt. Edges while disarmed still
+ * set the flag; arming with it set interrupts at once.
+ */
+void SimKeypadArmInterrupt( int arm );
+
+/*! The host WaitForInterrupt(): sleep until an interrupt.
+ *
+ * If the keypad interrupt is pending this returns at once. Otherwise
+ * simulated time advances to the next software timer (scripted key edges
+ * are timers too), which runs it and any interrupt it causes. If nothing
+ * could ever wake the processor, the idle handler is called: the run is
+ * over. TimeIdle() sleeps the same way.
+ */
+void SimWaitForInterrupt( void );
+
+/*! Press or release a key immediately.
+ *
+ * \param [in] key The character marked on the key.
+ * \return 0, or -1 if there is no such key.
+ */
+int SimKeypadPress( char key );
+int SimKeypadRelease( char key );			//!< \copydoc SimKeypadPress
+
+/*! Script one key press in simulated time.
+ *
+ * \param [in] key The character marked on the key.
+ * \param [in] press_at_us The simulated time of the press, in microseconds.
+ * 		It must not be earlier than the previously scripted press.
+ * \param [in] hold_us How long the key is held down.
+ * \return 0, or -1 if the key is invalid, out of order or the script is full.
+ */
+int SimKeypadScript( char key, unsigned long long press_at_us, unsigned long hold_us );
+
+/*! Script a string of keys, typed one after another.
+ *
+ * \param [in] keys The characters marked on the keys, e.g. "12A3*".
+ * \param [in] gap_us The time between releasing one key and pressing the
+ * 		next. The first key is pressed this long after the last
+ * 		scripted release (or after now, if that is later).
+ * \param [in] hold_us How long each key is held down.
+ * \return The number of keys scripted.
+ */
+int SimKeypadType( const char *keys, unsigned long gap_us, unsigned long hold_us );
+
+/*! Make keys scripted from now on bounce.
+ *
+ * \param [in] bounce_us For this long after each press and each release,
+ * 		the contact opens and closes pseudo-randomly (but the same
+ * 		on every run). 0, the default, for clean contacts.
+ */
+void SimKeypadSetBounce( unsigned long bounce_us );
+
+/*! Non-zero while scripted keys remain which have not been released yet.
+ */
+int SimKeypadScriptPending( void );
+
+//@}
+// End of Keypad matrix
+
+//! \name Flash memory
+//@{
+
+#define SIM_FLASH_SIZE		0x40000	//!< 256 KB, as the TM4C123GH6PM.
+#define SIM_FLASH_PROGRAM_US	50	//!< Time to program one word.
+#define SIM_FLASH_ERASE_US	15000	//!< Time to erase one page.
+
+/*! Erase the whole simulated flash and zero its per-page erase counts.
+ *
+ * The flash is not changed by SimReset(), so what was written before a
+ * simulated power-up can be read after it, as on the Tiva.
+ */
+void SimFlashReset( void );
+
+/*! Read a word of flash, as through the Tiva's memory map.
+ *
+ * \param [in] address The byte address, a multiple of 4.
+ */
+unsigned long SimFlashReadWord( unsigned long address );
+
+/*! Program a word of flash, as the flash controller does.
+ *
+ * As in NOR flash, programming can only clear bits: the word becomes the
+ * AND of its old and new values. Setting a bit that is clear, or starting
+ * while the flash is busy, is counted in flash_errors.
+ * The flash is then busy for SIM_FLASH_PROGRAM_US, and interrupts when
+ * it is done (SimFlashSetInterrupt()).
+ */
+void SimFlashWriteWord( unsigned long address, unsigned long word );
+
+/*! Erase the page (FLASH_PAGE_SIZE bytes) containing \a address to all
+ * ones. The flash is then busy for SIM_FLASH_ERASE_US.
+ */
+void SimFlashErasePage( unsigned long address );
+
+/*! Set the function called when a program or erase completes, as the
+ * Tiva's flash interrupt is, or 0 for none.
+ */
+void SimFlashSetInterrupt( void (*handler)( void ) );
+
+/*! Non-zero while a program or erase is in progress, in simulated time.
+ */
+int SimFlashBusy( void );
+
+/*! How many times the page containing \a address has been erased since
+ * SimFlashReset(), for measuring wear.
+ */
+unsigned long SimFlashPageErases( unsigned long address );
+
+//@}
+// End of Flash memory
+
+#endif // of #ifndef HOST_SIM_H
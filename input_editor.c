@@ -0,0 +1,178 @@
+/* input_editor.c
+ *
+ * Gap-buffer editing of the input, shown through a window scrolled by the
+ * LCD's display shift, with the least redrawing of line 1.
+ *
+ * For documentation, see the corresponding .h file.
+ */
+
+#include <string.h>
+#include "metrics.h"
+#include "low_level_funcs_tiva.h"
+#include "input_editor.h"
+
+#define SHOWN		EDITOR_SHOWN_LENGTH
+#define DDRAM_LINE	40	// DDRAM characters a line holds, in 2-line mode.
+
+static void Draw( InputEditor *editor, int i )
+// Write character i of the input, or a space past its end, into its cell.
+{
+	int	address = i % DDRAM_LINE;
+
+	if (editor->address != address)
+		SetDisplayAddress( 1, address );
+	PrintChar( (i < EditorLength( editor )) ? EditorCharAt( editor, i ) : ' ' );
+	editor->address = (address + 1 < DDRAM_LINE) ? address + 1
+		: -1; // The controller goes on to line 2.
+} // Draw
+
+static void Show( InputEditor *editor, int first, int changed, int changed_end )
+/* Bring line 1 up to date once characters changed to changed_end-1 of the
+ * input have changed (none if they are equal): scroll from first as little
+ * as keeps the cursor shown, and rewrite the shown cells which do not hold
+ * their characters. The changed characters must not be before the
+ * window. */
+{
+	int	cursor = editor->gap_start, end, places, i;
+
+	if (editor->capacity > SHOWN) {
+		if (cursor < first)
+			first = cursor;
+		else if (cursor >= first + SHOWN)
+			first = cursor - SHOWN + 1;
+	}
+	places = ((first - editor->first) % DDRAM_LINE + DDRAM_LINE) % DDRAM_LINE;
+	if (places > DDRAM_LINE / 2)
+		places -= DDRAM_LINE; // Shorter the other way round the ring.
+	if (places != 0)
+		ShiftDisplay( places );
+	editor->first = first;
+
+	end = first + SHOWN;
+	for (i = first; i < end; i++)
+		if (i < editor->lo || i >= editor->hi || (i >= changed && i < changed_end))
+			Draw( editor, i );
+	if (changed_end > end && editor->hi > end)
+		editor->hi = end; // Changed, off the right of the window.
+	if (editor->hi < first || editor->lo > end) {
+		editor->lo = first;
+		editor->hi = end;
+	} else {
+		if (editor->lo > first)
+			editor->lo = first;
+		if (editor->hi < end)
+			editor->hi = end;
+	}
+	if (editor->hi - editor->lo > DDRAM_LINE) { // Drop what the window overwrote.
+		if (first - editor->lo > editor->hi - end)
+			editor->lo = editor->hi - DDRAM_LINE;
+		else	editor->hi = editor->lo + DDRAM_LINE;
+	}
+
+	if (editor->address != cursor % DDRAM_LINE) {
+		editor->address = cursor % DDRAM_LINE;
+		SetDisplayAddress( 1, editor->address );
+	}
+} // Show
+
+void EditorOpen( InputEditor *editor, char *buffer, int buffer_size,
+		 int length, int cursor, int first )
+{
+	int	after;
+
+	editor->text = buffer;
+	editor->capacity = buffer_size - 1;
+	if (length > editor->capacity)
+		length = editor->capacity;
+	if (cursor < 0 || cursor > length)
+		cursor = length;
+	after = length - cursor;
+	memmove( buffer + editor->capacity - after, buffer + cursor, after );
+	editor->gap_start = cursor;
+	editor->gap_end = editor->capacity - after;
+	editor->first = 0; // Unshifted,
+	editor->lo = 0;    // and showing the start of the input.
+	editor->hi = (length == 0) ? DDRAM_LINE : SHOWN;
+	if (first != 0)
+		editor->hi = 0;
+	editor->address = -1;
+	Show( editor, (first > 0 && first <= cursor) ? first : 0, 0, 0 );
+} // EditorOpen
+
+int EditorInsert( InputEditor *editor, char ch )
+{
+	if (editor->gap_start == editor->gap_end)
+		return 0; // Full.
+	editor->text[ editor->gap_start++ ] = ch;
+	Show( editor, editor->first, editor->gap_start - 1, EditorLength( editor ) );
+	return 1;
+} // EditorInsert
+
+int EditorRubout( InputEditor *editor )
+{
+	int	length = EditorLength( editor );
+
+	if (editor->gap_start == 0)
+		return 0;
+	editor->gap_start --;
+	Show( editor, editor->first, editor->gap_start, length );
+	MetricCount( RUBOUTS );
+	return 1;
+} // EditorRubout
+
+void EditorClearAll( InputEditor *editor )
+{
+	int	length = EditorLength( editor );
+
+	editor->gap_start = 0;
+	editor->gap_end = editor->capacity;
+	Show( editor, 0, 0, length );
+} // EditorClearAll
+
+int EditorMove( InputEditor *editor, int places )
+{
+	int	moved = 0;
+
+	for ( ; places < 0 && editor->gap_start > 0; places++, moved--)
+		editor->text[ --editor->gap_end ] = editor->text[ --editor->gap_start ];
+	for ( ; places > 0 && editor->gap_end < editor->capacity; places--, moved++)
+		editor->text[ editor->gap_start++ ] = editor->text[ editor->gap_end++ ];
+	Show( editor, editor->first, 0, 0 );
+	return moved;
+} // EditorMove
+
+int EditorLength( const InputEditor *editor )
+{
+	return editor->capacity - (editor->gap_end - editor->gap_start);
+} // EditorLength
+
+int EditorCursor( const InputEditor *editor )
+{
+	return editor->gap_start;
+} // EditorCursor
+
+int EditorFirstShown( const InputEditor *editor )
+{
+	return editor->first;
+} // EditorFirstShown
+
+char EditorCharAt( const InputEditor *editor, int i )
+{
+	if (i >= editor->gap_start)
+		i += editor->gap_end - editor->gap_start;
+	return editor->text[i];
+} // EditorCharAt
+
+void EditorClose( InputEditor *editor )
+{
+	int	length;
+
+	if (editor->first != 0) // Back to the start, so line 2 shows too.
+		EditorMove( editor, -editor->gap_start );
+	length = EditorLength( editor );
+	memmove( editor->text + editor->gap_start, editor->text + editor->gap_end,
+		 editor->capacity - editor->gap_end );
+	memset( editor->text + length, '\0', editor->capacity + 1 - length );
+	editor->gap_start = length; // The nulls are the gap.
+	editor->gap_end = editor->capacity;
+} // EditorClose
@@ -0,0 +1,126 @@
+/*! \file input_editor.h
+ * The editor behind ReadAndEchoInput(): a gap buffer with a cursor, shown
+ * on line 1 of the display through a window which scrolls along it.
+ *
+ * The text lives in the caller's input buffer, split at the cursor by a
+ * gap of unused characters:
+ *
+ * 	| Before the cursor	| Gap	| After the cursor	|
+ * 	| :--			| :--:	| :--			|
+ * 	| text[0] on		| free	| up to the end		|
+ *
+ * Inserting or rubbing out at the cursor moves one end of the gap, so it
+ * costs the same wherever the cursor is, and moving the cursor one place
+ * moves one character across the gap. The text is only made contiguous
+ * (one move of the part after the cursor) when the input is finished.
+ *
+ * An input longer than the 16 characters shown scrolls, using the
+ * HD44780's own display shift rather than rewriting the line. Each line of
+ * its DDRAM holds 40 characters, and the 16 shown wrap round it, so the
+ * DDRAM is used as a ring: character i of the input goes in DDRAM
+ * character i % 40, and showing input characters first to first+15 is a
+ * display shift of first % 40, reached from the last in at most 20 shift
+ * instructions. The editor keeps the range of input characters whose
+ * cells hold them (at most 40), and when an edit or a scroll shows a cell
+ * which does not, rewrites just that cell.
+ *
+ * So each edit rewrites only the shown cells it changed, and sets the
+ * LCD's address counter only when it must move:
+ * 	- typing at the end of the input writes one character, plus a
+ * 		display shift once it is more than a line long (and, beyond
+ * 		40 characters, a space over the cell that scrolls in);
+ * 	- moving the cursor is one instruction, or a display shift at the
+ * 		edge of the window;
+ * 	- an insertion or a Rubout part way along rewrites the shown
+ * 		characters from the cursor on, and moves the cursor;
+ * 	- Rubout at the end is a space between two cursor moves.
+ *
+ * If the buffer holds no more than 16 characters the window never moves,
+ * and the cursor may sit just past the end of the line, as it always has.
+ */
+
+#ifndef INPUT_EDITOR_H
+#define INPUT_EDITOR_H
+
+#define EDITOR_SHOWN_LENGTH	16	// Characters of the input shown at a time.
+
+/*! An input being edited. The caller owns the storage; the fields are
+ * private to this module.
+ */
+typedef struct {
+	char	*text;		// The caller's buffer.
+	int	capacity;	// Characters it can hold, without the null.
+	int	gap_start;	// The cursor: characters before the gap.
+	int	gap_end;	// Where the characters after the cursor start.
+	int	first;		// The character shown in column 1.
+	int	lo, hi;		/* Characters lo to hi-1 (or spaces, past the
+				 * end) are in their DDRAM cells. */
+	int	address;	// Of the LCD's address counter, or -1 if unknown.
+} InputEditor;
+
+/*! Start editing.
+ *
+ * \param [out] editor The editor.
+ * \param [in,out] buffer The input buffer. Its first \a length characters
+ * 		are the input so far, e.g. one restored after a power cycle.
+ * \param [in] buffer_size The size of \a buffer, including the trailing
+ * 		null.
+ * \param [in] length The length of the input so far.
+ * \param [in] cursor Where the cursor is in it, from 0 to \a length.
+ * \param [in] first The first character to show.
+ *
+ * Line 1 of the display must be unshifted and either blank, if \a length
+ * is 0, or showing the first 16 characters of the input (as after
+ * ClearDisplay() or a restored snapshot). If \a first is not 0, the
+ * line is redrawn from there. The display's cursor is set at \a cursor.
+ */
+void EditorOpen( InputEditor *editor, char *buffer, int buffer_size,
+		 int length, int cursor, int first );
+
+/*! Insert a character at the cursor, and move the cursor past it.
+ *
+ * \return 1, or 0 if the buffer is full and nothing was done.
+ */
+int EditorInsert( InputEditor *editor, char ch );
+
+/*! Delete the character before the cursor.
+ *
+ * \return 1, or 0 if the cursor is at the start and nothing was done.
+ */
+int EditorRubout( InputEditor *editor );
+
+/*! Delete the whole input.
+ */
+void EditorClearAll( InputEditor *editor );
+
+/*! Move the cursor.
+ *
+ * \param [in] places How many places to the right, or to the left if
+ * 		negative. The cursor stops at either end of the input.
+ * \return The number of places it moved (negative to the left).
+ */
+int EditorMove( InputEditor *editor, int places );
+
+/*! The number of characters in the input.
+ */
+int EditorLength( const InputEditor *editor );
+
+/*! The cursor's position: the number of characters before it.
+ */
+int EditorCursor( const InputEditor *editor );
+
+/*! The first character of the input shown, in column 1.
+ */
+int EditorFirstShown( const InputEditor *editor );
+
+/*! Character \a i of the input, counting from 0.
+ */
+char EditorCharAt( const InputEditor *editor, int i );
+
+/*! Finish editing: scroll back to the start of the input, unshifted, and
+ * close the gap, so that the buffer holds the input as a C string with
+ * the rest of it filled with nulls.
+ */
+void EditorClose( InputEditor *editor );
+
+#endif // of #ifndef INPUT_EDITOR_H
@@ -0,0 +1,265 @@
+/* key_events.c
+ *
+ * Debounced keypad sampling and the queue of key events it fills.
+ *
+ * For documentation, see the corresponding .h file.
+ */
+
+#include "time_source.h"
+#include "scheduler.h"
+#include "metrics.h"
+#include "hal.h"
+#include "low_level_funcs_tiva.h"
+#include "key_events.h"
+
+#define ALL_COLUMNS	0x0F
+#define N_KEYS		16	// Key index is row*4 + col.
+#define SIGNAL_EDGE	0	// From KeyEventsRowEdge().
+#define SIGNAL_SAMPLE	1	// From the sampling timer.
+
+static KeyEvent	queue[ KEY_EVENT_QUEUE_SIZE ];
+static volatile unsigned int	head = 0;	// Next slot to fill. Written only by the sampler.
+static volatile unsigned int	tail = 0;	// Next slot to take. Written only by main.
+static volatile unsigned long	n_dropped = 0;
+
+static SoftTimer	sample_timer;
+static unsigned long	sample_us = KEY_SAMPLE_US;
+static unsigned long	debounce_us = KEY_DEBOUNCE_US;
+static unsigned char	window = KEY_DEBOUNCE_US / KEY_SAMPLE_US;	// In samples.
+static unsigned char	count[ N_KEYS ];	// Integrators, 0 to window.
+static unsigned short	pressed = 0;		// Debounced state, bit per key.
+static unsigned long long	change_us[ N_KEYS ];	// When the contact first changed.
+
+static int	repeat_key = -1;		// None.
+static unsigned long	repeat_delay_us, repeat_interval_us;
+static unsigned long long	repeat_due_us;
+
+static KeyScanStats	scan_stats;
+
+static void Push( unsigned char type, int key, unsigned long long time_us )
+// Called only from the sampler.
+{
+	unsigned int	next = (head + 1) & (KEY_EVENT_QUEUE_SIZE - 1);
+
+	if (next == tail) { // Full: keep the older events.
+		n_dropped ++;
+		return;
+	}
+	queue[ head ].type = type;
+	queue[ head ].row = key / 4;
+	queue[ head ].col = key % 4;
+	queue[ head ].time_us = time_us;
+	head = next; /* Published last: the volatile write cannot be moved
+		      * before the slot is filled. */
+} // Push
+
+static const unsigned short	row_spread[16] = {
+	/* Row inputs (bit per row) to key mask bits for column 0: row r is
+	 * bit r*4. Shift left by the column for the others. */
+	0x0000, 0x0001, 0x0010, 0x0011, 0x0100, 0x0101, 0x0110, 0x0111,
+	0x1000, 0x1001, 0x1010, 0x1011, 0x1100, 0x1101, 0x1110, 0x1111
+};
+
+static unsigned short ScanKeypad( void )
+// One pass: the contact state of every key, bit row*4 + col.
+{
+	unsigned short	closed = 0;
+	unsigned char	nibble;
+	int	col;
+
+	for (nibble = 0x01, col = 0; nibble <= 0x08; nibble = nibble << 1, col++) {
+		WriteKeyboardCol( nibble );
+		closed |= row_spread[ ReadKeyboardRow() & 0x0F ] << col;
+	}
+	scan_stats.passes ++;
+	scan_stats.port_accesses += KEY_SCAN_ACCESSES;
+	scan_stats.last_mask = closed;
+	return closed;
+} // ScanKeypad
+
+static int Ghosting( unsigned short closed )
+/* Non-zero if some two rows share two or more closed columns. Three of
+ * those four keys would look like all four, so the pass is ambiguous. */
+{
+	int	r1, r2;
+
+	for (r1 = 0; r1 < 3; r1++)
+		for (r2 = r1 + 1; r2 < 4; r2++) {
+			unsigned short	shared = (closed >> (r1*4)) & (closed >> (r2*4)) & 0x0F;
+			if (shared & (shared - 1))
+				return 1;
+		}
+	return 0;
+} // Ghosting
+
+static void SampleDue( void );
+
+static void Sample( void )
+/* Advance each key's state machine by one sample, then either sample
+ * again or go back to waiting for an edge. */
+{
+	unsigned long long	now_us = TimeNowMicrosec();
+	unsigned short	closed = ScanKeypad();
+	int	key, settling = 0;
+
+	if (closed & (closed - 1))
+		scan_stats.multi_key_passes ++;
+	if (Ghosting( closed )) { // Hold every key's state until it clears.
+		scan_stats.ghost_passes ++;
+		TimerStart( &sample_timer, sample_us, SampleDue );
+		return;
+	}
+	for (key = 0; key < N_KEYS; key++) {
+		unsigned short	bit = 1 << key;
+		if (closed & bit) {
+			if (count[key] == 0)
+				change_us[key] = now_us;
+			if (count[key] < window && ++count[key] == window
+			    && ! (pressed & bit)) {
+				pressed |= bit;
+				Push( KEY_PRESS, key, change_us[key] );
+				MetricCount( KEYS );
+				if (key == repeat_key)
+					repeat_due_us = change_us[key] + repeat_delay_us;
+			}
+		} else if (count[key] > 0) {
+			if (count[key] == window)
+				change_us[key] = now_us;
+			if (--count[key] == 0 && (pressed & bit)) {
+				pressed &= ~bit;
+				Push( KEY_RELEASE, key, change_us[key] );
+			}
+		}
+		if (count[key] != 0)
+			settling = 1;
+	}
+
+	if (repeat_key >= 0 && repeat_delay_us && (pressed & (1 << repeat_key))
+	    && now_us >= repeat_due_us) {
+		Push( KEY_REPEAT, repeat_key, repeat_due_us );
+		repeat_due_us += repeat_interval_us ? repeat_interval_us : 1;
+	}
+
+	if (settling || closed) {
+		TimerStart( &sample_timer, sample_us, SampleDue );
+		return;
+	}
+	WriteKeyboardCol( ALL_COLUMNS );
+	HalAckKeypadInterrupt();
+	HalArmKeypadInterrupt( 1 );
+	if (ReadKeyboardRow() != 0) { // Pressed since the scan: no edge to come.
+		HalArmKeypadInterrupt( 0 );
+		TimerStart( &sample_timer, sample_us, SampleDue );
+	}
+} // Sample
+
+static void SampleDue( void )
+// Sampling timer callback.
+{
+	SchedulerPost( TASK_KEYPAD, SIGNAL_SAMPLE );
+} // SampleDue
+
+void KeypadTask( unsigned char signal )
+{
+	if (signal == SIGNAL_EDGE && TimerIsActive( &sample_timer ))
+		return; // Already sampling.
+	Sample();
+} // KeypadTask
+
+void InitKeyEvents( void )
+{
+	int	key;
+
+	TimerStop( &sample_timer );
+	for (key = 0; key < N_KEYS; key++)
+		count[key] = 0;
+	pressed = 0;
+	tail = head;
+	n_dropped = 0;
+	KeyEventsResetScanStats();
+} // InitKeyEvents
+
+void KeyEventsRowEdge( void )
+{
+	HalArmKeypadInterrupt( 0 );  // Sampling will find any more keys.
+	HalAckKeypadInterrupt();
+	SchedulerPost( TASK_KEYPAD, SIGNAL_EDGE );
+} // KeyEventsRowEdge
+
+int KeyEventPop( KeyEvent *event )
+{
+	if (tail == head)
+		return 0;
+	*event = queue[ tail ];
+	tail = (tail + 1) & (KEY_EVENT_QUEUE_SIZE - 1);
+	return 1;
+} // KeyEventPop
+
+static void SetWindow( void )
+// Convert the debounce window to samples. Interrupts must be disabled.
+{
+	unsigned long	samples = (debounce_us + sample_us - 1) / sample_us;
+	int	key;
+
+	if (samples < 1)
+		samples = 1;
+	if (samples > 255)
+		samples = 255;
+	window = (unsigned char)samples;
+	for (key = 0; key < N_KEYS; key++)
+		if (count[key] > window)
+			count[key] = window;
+} // SetWindow
+
+void KeyEventsSetDebounce( unsigned long window_us )
+{
+	long	sr = StartCritical();
+	debounce_us = window_us;
+	SetWindow();
+	EndCritical( sr );
+} // KeyEventsSetDebounce
+
+void KeyEventsSetSamplePeriod( unsigned long period_us )
+{
+	long	sr = StartCritical();
+	sample_us = period_us ? period_us : 1;
+	SetWindow();
+	EndCritical( sr );
+} // KeyEventsSetSamplePeriod
+
+void KeyEventsSetRepeat( int row, int col, unsigned long delay_us,
+			 unsigned long interval_us )
+{
+	long	sr = StartCritical();
+
+	repeat_key = (row >= 0 && row < 4 && col >= 0 && col < 4) ? row*4 + col : -1;
+	repeat_delay_us = delay_us;
+	repeat_interval_us = interval_us;
+	EndCritical( sr );
+} // KeyEventsSetRepeat
+
+unsigned long KeyEventsDropped( void )
+{
+	return n_dropped;
+} // KeyEventsDropped
+
+unsigned short KeyEventsKeyMask( void )
+{
+	return pressed;
+} // KeyEventsKeyMask
+
+void KeyEventsGetScanStats( KeyScanStats *stats )
+{
+	long	sr = StartCritical();
+	*stats = scan_stats;
+	EndCritical( sr );
+} // KeyEventsGetScanStats
+
+void KeyEventsResetScanStats( void )
+{
+	long	sr = StartCritical();
+	scan_stats.passes = scan_stats.port_accesses = 0;
+	scan_stats.ghost_passes = scan_stats.multi_key_passes = 0;
+	scan_stats.last_mask = 0;
+	EndCritical( sr );
+} // KeyEventsResetScanStats
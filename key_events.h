@@ -0,0 +1,153 @@
+/*! \file key_events.h
+ * Debounced, timestamped key press and release events, found by
+ * interrupt-driven keypad scanning.
+ *
+ * All four keyboard columns are normally driven high, so pressing any key
+ * raises its row input and the port E edge interrupt fires. The interrupt
+ * handler calls KeyEventsRowEdge(), which disarms the interrupt and starts
+ * sampling the whole keypad every KEY_SAMPLE_US on a software timer. The
+ * passes are made by the keypad task (see \a scheduler), to which the
+ * interrupt handler and the timer post their events, so both are short.
+ *
+ * Each pass reads all four columns into one 16-bit mask of closed
+ * contacts, bit row*4 + col. The keypad has no diodes, so three keys at
+ * the corners of a rectangle also connect the fourth corner: such a pass
+ * is ambiguous (ghosting) and is not used, so the keys keep their states
+ * until it clears. Any number of other keys may be down together.
+ *
+ * Each of the 16 keys has its own debounce state machine: an integrator
+ * which counts up for each sample with the key's contact closed and down
+ * for each with it open, within 0 and the debounce window. The key is
+ * pressed when the count reaches the full window and released when it
+ * returns to 0, so contact bounce shorter than the window is ignored. Each
+ * press and release is queued with the time its contact first changed, so
+ * typing speed is limited only by the real bounce time.
+ *
+ * One key may auto-repeat (Rubout, set by ReadAndEchoInput()): while it is
+ * held, KEY_REPEAT events follow the press at a configurable rate.
+ *
+ * Once every key is released and settled, sampling stops, all the columns
+ * are driven again and the interrupt is re-armed. The main program pops
+ * events with KeyEventPop(), sleeping in TimeIdle() while the
+ * queue is empty, so the processor is idle rather than spinning between
+ * key presses.
+ *
+ * The queue is a single-producer single-consumer ring buffer. Only the
+ * keypad task writes \a head and only the main program writes \a tail,
+ * so neither needs to disable interrupts.
+ *
+ * This module uses only the low-level keyboard functions and the time
+ * source, so it is the same on the Tiva and on the host.
+ */
+
+#ifndef KEY_EVENTS_H
+#define KEY_EVENTS_H
+
+#define KEY_EVENT_QUEUE_SIZE	16	/* Must be a power of two. One
+				 * slot is kept empty to tell full from empty. */
+#define KEY_SAMPLE_US		1000	/* Default keypad sampling period
+				 * while any key is down. */
+#define KEY_DEBOUNCE_US		5000	/* Default debounce window. Contacts
+				 * typically bounce for 1 to 5 ms. */
+#define KEY_SCAN_ACCESSES	8	/* Port accesses per scan pass: a
+				 * column write and a row read for each column. */
+
+/*! What happened to the key.
+ */
+typedef enum {
+	KEY_PRESS,	//!< The key went down.
+	KEY_RELEASE,	//!< The key came up.
+	KEY_REPEAT	//!< The auto-repeat key is still down.
+} KeyEventType;
+
+/*! One key event.
+ */
+typedef struct {
+	unsigned char	type;	//!< A KeyEventType.
+	unsigned char	row;	//!< Row, counting from 0 as KeyboardRowCol2Char() does.
+	unsigned char	col;	//!< Column, counting from 0.
+	unsigned long long	time_us;	/*!< TimeNowMicrosec() when the contact
+					 * first changed (for a repeat, when
+					 * it fell due). */
+} KeyEvent;
+
+/*! Forget all keys and queued events, and stop sampling.
+ *
+ * Called by InitKeyboardPorts() before it arms the interrupt. The debounce
+ * window and auto-repeat settings are kept.
+ */
+void InitKeyEvents( void );
+
+/*! A row input has gone high: start debouncing.
+ *
+ * This is the body of the keypad (port E) interrupt handler. It disarms
+ * the interrupt and has the keypad task sample the keypad at once, then
+ * every KEY_SAMPLE_US until all the keys are released.
+ */
+void KeyEventsRowEdge( void );
+
+/*! Take the oldest event from the queue.
+ *
+ * \param [out] event The event, if there is one.
+ * \return 1 if an event was taken, 0 if the queue was empty.
+ */
+int KeyEventPop( KeyEvent *event );
+
+/*! Set the debounce window.
+ *
+ * \param [in] window_us A contact must be steady for this long (rounded
+ * 		up to whole samples) before a press or release is reported.
+ */
+void KeyEventsSetDebounce( unsigned long window_us );
+
+/*! Set the auto-repeat key.
+ *
+ * \param [in] row, col The key, counting from 0.
+ * \param [in] delay_us How long it must be held before the first
+ * 		KEY_REPEAT event, or 0 for no auto-repeat.
+ * \param [in] interval_us The time between KEY_REPEAT events.
+ */
+void KeyEventsSetRepeat( int row, int col, unsigned long delay_us,
+			 unsigned long interval_us );
+
+/*! Set the sampling period.
+ *
+ * \param [in] period_us The time between scan passes while any key is
+ * 		down. A shorter period reports keys sooner after their bounce
+ * 		ends, at the cost of more passes (see KeyScanStats). The
+ * 		debounce window is kept, in microseconds.
+ */
+void KeyEventsSetSamplePeriod( unsigned long period_us );
+
+/*! The number of events lost because the queue was full.
+ */
+unsigned long KeyEventsDropped( void );
+
+/*! The debounced state of every key: bit row*4 + col is set while that
+ * key is pressed.
+ */
+unsigned short KeyEventsKeyMask( void );
+
+/*! Scanning statistics, since InitKeyEvents() or KeyEventsResetScanStats().
+ */
+typedef struct {
+	unsigned long	passes;		//!< Scan passes, each of the whole keypad.
+	unsigned long	port_accesses;	//!< Column writes and row reads.
+	unsigned long	ghost_passes;	//!< Passes not used because of ghosting.
+	unsigned long	multi_key_passes;	//!< Passes with two or more contacts closed.
+	unsigned short	last_mask;	//!< Contacts closed in the last pass.
+} KeyScanStats;
+
+/*! Get the scanning statistics.
+ *
+ * The cost of a pass is port_accesses / passes (KEY_SCAN_ACCESSES); how
+ * long that takes depends on the bus (on the host, see SimGetStats()).
+ * Multiplied by the sampling rate, it gives the load of keypad scanning.
+ */
+void KeyEventsGetScanStats( KeyScanStats *stats );
+
+/*! Zero the scanning statistics.
+ */
+void KeyEventsResetScanStats( void );
+
+#endif // of #ifndef KEY_EVENTS_H
@@ -0,0 +1,197 @@
+/* key_trace.c
+ *
+ * A RAM ring of the keys read and the bytes sent to the LCD, and its
+ * binary export.
+ *
+ * For documentation, see the corresponding .h file.
+ */
+
+#include <string.h>
+#include "time_source.h"
+#include "answer_store.h"
+#include "ui_snapshot.h"
+#include "key_trace.h"
+
+static KeyTraceRecord	ring[ KEY_TRACE_RECORDS ];
+static unsigned long	n_recorded = 0;	// Since the start; the newest is at (n_recorded - 1) % KEY_TRACE_RECORDS.
+static uint32_t	start_us;	// Low 32 bits of TimeNowMicrosec() at the start.
+static int	started = 0;
+static double	start_answer;
+static char	start_lines[2][17];
+
+void KeyTraceStart( void )
+{
+	long	sr = StartCritical();
+
+	n_recorded = 0;
+	start_us = (uint32_t)TimeNowMicrosec();
+	start_answer = AnswerStoreGet();
+	UiShadowGetLine( 1, start_lines[0] );
+	UiShadowGetLine( 2, start_lines[1] );
+	started = 1;
+	EndCritical( sr );
+} // KeyTraceStart
+
+static void Record( uint32_t time, uint8_t type, uint8_t value, uint32_t wait )
+// Append a record, times being the low 32 bits of TimeNowMicrosec().
+{
+	long	sr = StartCritical(); // Keys from the main program, bytes from the display task.
+	KeyTraceRecord	*record = &ring[ n_recorded & (KEY_TRACE_RECORDS - 1) ];
+
+	if (started) {
+		record->time_us = time - start_us;
+		record->type = type;
+		record->value = value;
+		record->wait_us = (wait > 0xFFFF) ? 0xFFFF : (uint16_t)wait;
+		n_recorded ++;
+	}
+	EndCritical( sr );
+} // Record
+
+void KeyTraceKey( int type, char key, unsigned long long changed_us )
+{
+	Record( (uint32_t)changed_us, (uint8_t)type, (uint8_t)key,
+		(uint32_t)(TimeNowMicrosec() - changed_us) );
+} // KeyTraceKey
+
+void KeyTraceDisplay( unsigned char byte, unsigned char instruction_or_data,
+		      unsigned long queued_us )
+{
+	uint32_t	now = (uint32_t)TimeNowMicrosec();
+
+	Record( now, instruction_or_data ? KEY_TRACE_DATA : KEY_TRACE_INSTRUCTION,
+		byte, now - (uint32_t)queued_us );
+} // KeyTraceDisplay
+
+static void Put16( unsigned char *p, uint32_t x )
+{
+	p[0] = (unsigned char)x;
+	p[1] = (unsigned char)(x >> 8);
+} // Put16
+
+static void Put32( unsigned char *p, uint32_t x )
+{
+	Put16( p, x );
+	Put16( p + 2, x >> 16 );
+} // Put32
+
+static uint32_t Get16( const unsigned char *p )
+{
+	return p[0] | (uint32_t)p[1] << 8;
+} // Get16
+
+static uint32_t Get32( const unsigned char *p )
+{
+	return Get16( p ) | Get16( p + 2 ) << 16;
+} // Get32
+
+unsigned long KeyTraceExport( unsigned char *buffer, unsigned long size )
+{
+	unsigned long	n, i, first;
+	uint64_t	answer;	// The double's bits.
+	uint16_t	flags;
+	long	sr;
+
+	if (size < KEY_TRACE_HEADER_SIZE)
+		return 0;
+	sr = StartCritical(); // A consistent copy, though recording goes on.
+	n = (n_recorded < KEY_TRACE_RECORDS) ? n_recorded : KEY_TRACE_RECORDS;
+	if (n > (size - KEY_TRACE_HEADER_SIZE) / KEY_TRACE_RECORD_SIZE)
+		n = (size - KEY_TRACE_HEADER_SIZE) / KEY_TRACE_RECORD_SIZE; // The newest which fit.
+	first = n_recorded - n;
+	flags = first ? KEY_TRACE_WRAPPED : 0;
+	memcpy( buffer, "KTR1", 4 );
+	Put16( buffer + 4, KEY_TRACE_RECORD_SIZE );
+	Put16( buffer + 6, flags );
+	Put32( buffer + 8, n );
+	Put32( buffer + 12, first );
+	memcpy( &answer, &start_answer, sizeof answer );
+	Put32( buffer + 16, (uint32_t)answer );
+	Put32( buffer + 20, (uint32_t)(answer >> 32) );
+	memcpy( buffer + 24, start_lines[0], 16 );
+	memcpy( buffer + 40, start_lines[1], 16 );
+	for (i = 0; i < n; i++) {
+		const KeyTraceRecord	*record = &ring[ (first + i) & (KEY_TRACE_RECORDS - 1) ];
+		unsigned char	*p = buffer + KEY_TRACE_HEADER_SIZE + i * KEY_TRACE_RECORD_SIZE;
+
+		Put32( p, record->time_us );
+		p[4] = record->type;
+		p[5] = record->value;
+		Put16( p + 6, record->wait_us );
+	}
+	EndCritical( sr );
+	return KEY_TRACE_HEADER_SIZE + n * KEY_TRACE_RECORD_SIZE;
+} // KeyTraceExport
+
+int KeyTraceParse( const unsigned char *trace, unsigned long size,
+		   KeyTraceHeader *header )
+{
+	uint64_t	bits;
+
+	if (size < KEY_TRACE_HEADER_SIZE || memcmp( trace, "KTR1", 4 ) != 0
+	    || Get16( trace + 4 ) != KEY_TRACE_RECORD_SIZE)
+		return -1;
+	header->flags = (uint16_t)Get16( trace + 6 );
+	header->n_records = Get32( trace + 8 );
+	header->dropped = Get32( trace + 12 );
+	if (header->n_records > (size - KEY_TRACE_HEADER_SIZE) / KEY_TRACE_RECORD_SIZE)
+		return -1;
+	bits = Get32( trace + 16 ) | (uint64_t)Get32( trace + 20 ) << 32;
+	memcpy( &header->answer, &bits, sizeof bits );
+	memcpy( header->lines[0], trace + 24, 16 );
+	memcpy( header->lines[1], trace + 40, 16 );
+	header->lines[0][16] = header->lines[1][16] = '\0';
+	return 0;
+} // KeyTraceParse
+
+void KeyTraceGetRecord( const unsigned char *trace, unsigned long i,
+			KeyTraceRecord *record )
+{
+	const unsigned char	*p = trace + KEY_TRACE_HEADER_SIZE + i * KEY_TRACE_RECORD_SIZE;
+
+	record->time_us = Get32( p );
+	record->type = p[4];
+	record->value = p[5];
+	record->wait_us = (uint16_t)Get16( p + 6 );
+} // KeyTraceGetRecord
+
+int KeyTraceLatencies( const unsigned char *trace, KeyTraceLatency *latencies, int max )
+{
+	unsigned long	n = Get32( trace + 8 ), i, j;
+	int	n_found = 0;
+
+	for (i = 0; i < n && n_found < max; i++) {
+		KeyTraceRecord	key, next, byte;
+		uint32_t	read_us, next_read_us = 0;
+		int	bounded = 0;
+
+		KeyTraceGetRecord( trace, i, &key );
+		if (key.type != KEY_TRACE_PRESS && key.type != KEY_TRACE_REPEAT)
+			continue;
+		read_us = key.time_us + key.wait_us;
+		for (j = i + 1; j < n; j++) { // The next key read bounds the response.
+			KeyTraceGetRecord( trace, j, &next );
+			if (next.type <= KEY_TRACE_REPEAT) {
+				next_read_us = next.time_us + next.wait_us;
+				bounded = 1;
+				break;
+			}
+		}
+		for (j = i + 1; j < n; j++) { // Times compared modulo 2^32.
+			uint32_t	queued_us;
+
+			KeyTraceGetRecord( trace, j, &byte );
+			if (byte.type <= KEY_TRACE_REPEAT)
+				continue;
+			queued_us = byte.time_us - byte.wait_us;
+			if (bounded && (int32_t)(queued_us - next_read_us) >= 0)
+				break; // The LCD's queue is in order: none later is this key's.
+			if ((int32_t)(queued_us - read_us) >= 0) {
+				latencies[ n_found ].key = (char)key.value;
+				latencies[ n_found++ ].latency_us = byte.time_us - key.time_us;
+				break;
+			}
+		}
+	}
+	return n_found;
+} // KeyTraceLatencies
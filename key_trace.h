@@ -0,0 +1,156 @@
+/*! \file key_trace.h
+ * A trace of the keys read and of the bytes then sent to the LCD, kept in
+ * RAM on the device and replayed on the host, to reproduce and measure
+ * slow responses.
+ *
+ * Each key event taken by the keyboard functions (KeyTraceKey(), from
+ * WaitKeyPress()) and each byte the display task sends to the LCD
+ * (KeyTraceDisplay()) is one 8-byte record in a ring of KEY_TRACE_RECORDS,
+ * the oldest overwritten once it is full. Recording is a few dozen
+ * instructions with interrupts disabled, and always on; the ring costs
+ * 2 KB of RAM.
+ *
+ * KeyTraceExport() writes the trace in a compact binary form, the same on
+ * the device and the host: a header, then the records, oldest first, all
+ * little-endian.
+ *
+ * 	| Bytes	| Header field					|
+ * 	| :--	| :--						|
+ * 	| 4	| "KTR1"					|
+ * 	| 2	| Record size: 8				|
+ * 	| 2	| Flags: KEY_TRACE_WRAPPED			|
+ * 	| 4	| Records which follow				|
+ * 	| 4	| Records overwritten before the export		|
+ * 	| 8	| The last answer when the trace started (IEEE double) |
+ * 	| 32	| The screen when the trace started: two lines of 16 |
+ *
+ * 	| Bytes	| Record field					|
+ * 	| :--	| :--						|
+ * 	| 4	| time_us: microseconds since the trace started, modulo 2^32 |
+ * 	| 1	| type: a KeyTraceType				|
+ * 	| 1	| value: the key's character, or the LCD's byte	|
+ * 	| 2	| wait_us: see KeyTraceRecord (at most 65535)	|
+ *
+ * On the device the export is read out with the debugger, e.g. by calling
+ * KeyTraceExport() into a buffer and dumping it. On the host,
+ * test_host_sim replays a trace ("test_host_sim r file"): it starts fresh
+ * simulated hardware from the trace's answer, presses the keys at their
+ * recorded times through main()'s own cycle, checks that the LCD is sent
+ * the same bytes, and reports the latency of each key.
+ */
+
+#ifndef KEY_TRACE_H
+#define KEY_TRACE_H
+
+#include <stdint.h>
+
+#ifndef KEY_TRACE_RECORDS
+#define KEY_TRACE_RECORDS	256	// Must be a power of two.
+#endif
+
+#define KEY_TRACE_HEADER_SIZE	56
+#define KEY_TRACE_RECORD_SIZE	8
+#define KEY_TRACE_EXPORT_SIZE	(KEY_TRACE_HEADER_SIZE + KEY_TRACE_RECORDS * KEY_TRACE_RECORD_SIZE)
+#define KEY_TRACE_WRAPPED	0x0001	// Records were overwritten: the start is lost.
+
+/*! What a record is. The first three are the KeyEventType values.
+ */
+typedef enum {
+	KEY_TRACE_PRESS,	//!< A key went down.
+	KEY_TRACE_RELEASE,	//!< A key came up.
+	KEY_TRACE_REPEAT,	//!< The auto-repeat key is still down.
+	KEY_TRACE_INSTRUCTION,	//!< An instruction was sent to the LCD.
+	KEY_TRACE_DATA		//!< A character was sent to the LCD.
+} KeyTraceType;
+
+/*! One record.
+ */
+typedef struct {
+	uint32_t	time_us;	/*!< For a key, when its contact changed; for
+				 * the LCD, when the byte was sent. */
+	uint8_t	type;		//!< A KeyTraceType.
+	uint8_t	value;		//!< The key's character, or the byte.
+	uint16_t	wait_us;	/*!< For a key, how long it waited to be
+				 * read; for the LCD, how long the byte was
+				 * queued. */
+} KeyTraceRecord;
+
+/*! A trace's header.
+ */
+typedef struct {
+	uint16_t	flags;		//!< KEY_TRACE_WRAPPED, if it was.
+	uint32_t	n_records;	//!< Records in the trace.
+	uint32_t	dropped;	//!< Records overwritten.
+	double	answer;		//!< The last answer when it started.
+	char	lines[2][17];	//!< The screen when it started.
+} KeyTraceHeader;
+
+/*! The latency of one key.
+ */
+typedef struct {
+	char	key;		//!< The key's character.
+	unsigned long	latency_us;	/*!< From the contact changing to the first
+				 * byte sent in response. */
+} KeyTraceLatency;
+
+/*! Start a new trace, forgetting the old one, from the screen and answer
+ * now. Called at the end of InitAllHardware(); nothing is recorded before.
+ */
+void KeyTraceStart( void );
+
+/*! Record a key event as it is read.
+ *
+ * \param [in] type A KeyEventType.
+ * \param [in] key The key's character.
+ * \param [in] changed_us TimeNowMicrosec() when the contact changed.
+ */
+void KeyTraceKey( int type, char key, unsigned long long changed_us );
+
+/*! Record a byte as it is sent to the LCD.
+ *
+ * \param [in] byte The byte.
+ * \param [in] instruction_or_data 0 for an instruction, 1 for data.
+ * \param [in] queued_us The low 32 bits of TimeNowMicrosec() when it was
+ * 		queued.
+ */
+void KeyTraceDisplay( unsigned char byte, unsigned char instruction_or_data,
+		      unsigned long queued_us );
+
+/*! Write the trace in its binary form.
+ *
+ * \param [out] buffer Where to write it: KEY_TRACE_EXPORT_SIZE bytes is
+ * 		always enough.
+ * \param [in] size The size of \a buffer. Only the newest records which
+ * 		fit are written.
+ * \return The number of bytes written, or 0 if not even the header fits.
+ */
+unsigned long KeyTraceExport( unsigned char *buffer, unsigned long size );
+
+/*! Read a trace's header, checking the format.
+ *
+ * \param [in] trace The trace, as written by KeyTraceExport().
+ * \param [in] size Its size in bytes.
+ * \param [out] header Its header.
+ * \return 0, or -1 if it is not a trace or is cut short.
+ */
+int KeyTraceParse( const unsigned char *trace, unsigned long size,
+		   KeyTraceHeader *header );
+
+/*! Read record \a i of a trace which KeyTraceParse() has accepted.
+ */
+void KeyTraceGetRecord( const unsigned char *trace, unsigned long i,
+			KeyTraceRecord *record );
+
+/*! The latency of each key press and auto-repeat in a trace: from its
+ * contact changing to the first byte sent to the LCD which was queued
+ * after the key was read and before the next was. Keys with no such byte
+ * (e.g. with the input full) are left out.
+ *
+ * \param [in] trace A trace which KeyTraceParse() has accepted.
+ * \param [out] latencies The latencies, in the order of the keys.
+ * \param [in] max The size of \a latencies.
+ * \return How many were written.
+ */
+int KeyTraceLatencies( const unsigned char *trace, KeyTraceLatency *latencies, int max );
+
+#endif // of #ifndef KEY_TRACE_H
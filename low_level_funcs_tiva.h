@@ -18,13 +18,13 @@
  * (e.g. to make the display blink). You may, however, modify the definition of 
  * the \a #define constant \a ANSWER_FLASH_ADDRESS.
  * 
- * \note As part of this \a low_level_funcs_tiva module, you will have to define 
- * all the \a #define constants that specify port addresses, what goes in various 
- * registers, and so on. However, these must not be in this low_level_funcs_tiva.h 
- * file; they must be in low_level_funcs_tiva.c. This is because the .h file 
- * specifies how its functions should be called, i.e. what it does but not how it 
- * does it. These \a #define constants are purely internal to this module, 
- * so they do not belong in the .h file
+ * \note The \a #define constants that specify port addresses, what goes in 
+ * various registers, and so on, must not be in this low_level_funcs_tiva.h file. 
+ * This is because the .h file specifies how its functions should be called, 
+ * i.e. what it does but not how it does it. They are in hal_tiva.c: this module 
+ * reaches the hardware through the HAL (see hal.h), so that the same 
+ * low_level_funcs_tiva.c runs on the Tiva and, linked with hal_host.c, on the 
+ * host.
  * 
  * Dr Chris Trayner, 2019 September
  */
@@ -124,6 +124,14 @@ unsigned char ReadKeyboardRow( void );
  */
 void SendDisplayNibble( unsigned char byte, unsigned char instruction_or_data );
 
+/*! Write one nibble to the display's pins and pulse EN, without waiting 
+ * afterwards: the display task (see \a display_task) times the gaps.
+ * 
+ * \param [in] nibble The nibble, in the least four significant bits.
+ * \param [in] instruction_or_data 0 for instruction, 1 for data.
+ */
+void WriteDisplayNibble( unsigned char nibble, unsigned char instruction_or_data );
+
 /*! Send one byte of data or an instruction to the display.
  * 
  * \param [in] byte The byte to be sent.
@@ -144,6 +152,10 @@ void SendDisplayNibble( unsigned char byte, unsigned char instruction_or_data );
  * (The exception is in InitDisplayPort(), where some early instructions 
  * have unusual timing and format.)
  * 
+ * Once the boot is over, the byte is queued for the display task, which 
+ * sends it with these waits while the caller carries on (see 
+ * \a display_task). So are the bytes of the other display functions.
+ * 
  * \note The parameter is \a unsigned \a char, which is really a shorthand for an 
  * unsigned 8-bit integer. This is a misnomer: a \a char is a representation 
  * of ink on paper, and sign (+/-) is an irrelevant concept.
@@ -188,6 +200,28 @@ void TurnCursorOnOff( short int On );
  */
  void SetPrintPosition( short int line, short int char_pos );
 
+/*! Set the print position to any character of a line's DDRAM.
+ * 
+ * \param [in] line The line number, 1 for top or 2 for bottom.
+ * \param [in] address The character of the line's 40 in the HD44780U's 
+ * 		DDRAM, counting from 0. Only 16 of them are shown: 0 to 15 
+ * 		unless the display has been shifted (ShiftDisplay()).
+ * 
+ * Out-of-range parameters are treated as SetPrintPosition() treats them.
+ */
+void SetDisplayAddress( short int line, short int address );
+
+/*! Shift the display sideways along the DDRAM, without changing it.
+ * 
+ * \param [in] places The number of characters to move the view to the 
+ * 		right, so that the text moves left, or to the left if negative.
+ * 
+ * Both lines move together, and the view wraps round from DDRAM 
+ * character 39 to 0. Each place is one instruction. ClearDisplay() 
+ * returns the view to the start.
+ */
+void ShiftDisplay( short int places );
+
 /*! Print a character at the current position, then increment that position 
  * ready for any following character.
  * 
@@ -210,13 +244,27 @@ void PrintChar( char ch );
 //! \name Flash memory functions
 //@{
 
+/*! Size of a flash page, the unit of erasing (TM4C123: 1 KB).
+ */
+#define FLASH_PAGE_SIZE		1024
+
 /*! Address in flash where the previous answer is stored.
  * 
  * It is up to the prorammer to choose a value for this.
+ * The answer is kept in a log of records (see \a flash_log) in the 
+ * ANSWER_FLASH_PAGES pages from here: the last 4 KB of the 256 KB flash, 
+ * well clear of the program.
  */
-#define ANSWER_FLASH_ADDRESS	0x01
+#define ANSWER_FLASH_ADDRESS	0x0003F000
+#define ANSWER_FLASH_PAGES	4	/*!< With 64 records a page, an erase per 256 
+			 * answers: about 3,900 erases a page per million. */
 
 /*! Initialise flash memory.
+ * 
+ * This enables the flash interrupt, which drives writing (see 
+ * FlashLogOperationDone()), and finds the newest answer in the log, for 
+ * ReadDoubleFromFlash(), and the newest screen snapshot (see 
+ * \a ui_snapshot).
  */
 void InitFlash( void );
 
@@ -224,7 +272,10 @@ void InitFlash( void );
  * 
  * \param [in] number The number to store.
  * 
- * Store it in the address ANSWER_FLASH_ADDRESS.
+ * Store it in the address ANSWER_FLASH_ADDRESS: it is appended to the 
+ * answer log, so a page is erased only when one fills. This returns at 
+ * once: the answer is written once no newer one has come for 
+ * ANSWER_COMMIT_IDLE_US (see \a answer_store).
  */
 void WriteDoubleToFlash( double number );
 
@@ -232,7 +283,9 @@ void WriteDoubleToFlash( double number );
  * 
  * \return The number read.
  * 
- * Read it from the address ANSWER_FLASH_ADDRESS.
+ * Read it from the address ANSWER_FLASH_ADDRESS: the newest valid record 
+ * in the answer log, or 0.0 if there is none, unless a newer answer is 
+ * still waiting to be written.
  */
 double ReadDoubleFromFlash( void );
 
@@ -245,7 +298,9 @@ double ReadDoubleFromFlash( void );
 
 // Those other than keyboard, display and flash, e.g. clock initialization.
 
-/*! Initialise everything other than keyboard, display and flash.
+/*! Initialise everything other than keyboard, display and flash: the 
+ * clocks and the time source, and, if built with -DPROFILE_AT_BOOT, the 
+ * profiler (see \a profiler).
  */
 void InitAllOther( void );
 
@@ -253,6 +308,13 @@ void InitAllOther( void );
  * 
  * This will probably call other init functions 
  * rather than handling the hardware itself.
+ * 
+ * The clock is started first, then the ports, the keypad and the flash 
+ * reads, all within the LCD's power-up time, and the LCD last, so that 
+ * InitLCD() waits only for what is left of it. Then the screen from before 
+ * power was lost, if any, is restored (see \a ui_snapshot). The end of 
+ * each step is recorded in the boot timeline (see \a boot_timeline), and 
+ * the metrics (see \a metrics) start again from zero.
  */
 void InitAllHardware( void );
 
@@ -276,6 +338,9 @@ void Done_Check( int number );
 
 /*! Flash the LCD to warning user
  *
+ * Off for 0.1 s and on again, twice. This returns at once: the display 
+ * task plays the flash (DisplayFlash()) while keys are read and echoed, 
+ * and leaves the cursor as it was last set.
  */
 void LCDFlash( void );
 
@@ -284,11 +349,29 @@ void LCDFlash( void );
  */
 int HexToDeci( char Hex );
 
+// LCD initialisation times, figure 24 of HD44780.pdf:
+#define LCD_POWER_ON_US		45000	//!< More than 40 ms after Vcc rises, timed from InitTimeSource().
+#define LCD_FIRST_SET_US	4500	//!< More than 4.1 ms after the first function set.
+#define LCD_SECOND_SET_US	200	//!< More than 100 us after the second.
+
 /*! Initialize the LCD, reference figure 24 on page 46 of HD44780.pdf
  *
+ * The power-up wait ends LCD_POWER_ON_US after the clock started rather 
+ * than after this is called, so the rest of the boot overlaps it.
  */
 void InitLCD( void );
 
+/*! Sleep until an interrupt, e.g. a key press or a timer.
+ * 
+ * On the Tiva this executes WFI, and is in startup.s; on the host it is in 
+ * \a hal_host. It returns at once 
+ * if an interrupt is already pending, even with interrupts disabled, so 
+ * it may be called inside StartCritical()/EndCritical() after checking 
+ * that there is nothing to do. TimeIdle() (in \a time_source) wraps it 
+ * with the tickless wake-up timer and deep sleep.
+ */
+void WaitForInterrupt( void );
+
 // End of Sundry functions.
 //@}
 
@@ -46,8 +46,14 @@
  * 		be invisible.) This requires more complicated software. 
  * 		\a INPUT_BUFFER_SIZE can now be arbitrarily large; the 
  * 		actual value is a programmer's decision.
+ * 
+ * ReadAndEchoInput() scrolls (see \a input_editor), and takes the size 
+ * at run time, so this may be set for the whole build instead, e.g. 
+ * -DINPUT_BUFFER_SIZE=81, which also sizes CalculateAnswer()'s tables.
  */
+#ifndef INPUT_BUFFER_SIZE
 #define INPUT_BUFFER_SIZE	17
+#endif
 
 #include "high_level_funcs.h"
 #include "low_level_funcs_tiva.h"
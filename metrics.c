@@ -0,0 +1,87 @@
+/* metrics.c
+ *
+ * The table of metrics, and their names.
+ *
+ * For documentation, see the corresponding .h file.
+ */
+
+#include <string.h>
+#include "metrics.h"
+
+#define METRIC_NAME( id, name )		name,
+#define METRIC_COUNTER( id, name )	0,
+#define METRIC_GAUGE( id, name )	1,
+
+unsigned long	metrics[ METRIC_N ];
+
+static const char	*const names[] = { METRICS( METRIC_NAME, METRIC_NAME ) };
+static const unsigned char	gauges[] = { METRICS( METRIC_COUNTER, METRIC_GAUGE ) };
+
+void MetricsReset( void )
+{
+	memset( metrics, 0, sizeof metrics );
+} // MetricsReset
+
+int MetricIsGauge( int id )
+{
+	return id < METRIC_ERROR_0 && gauges[ id ];
+} // MetricIsGauge
+
+static char *PutNumber( char *text, unsigned long number )
+/* Write number in decimal at text: the end of it, unterminated. Without
+ * sprintf, which is kept out of the Tiva build. */
+{
+	char	reversed[ 3 * sizeof number ];
+	int	n = 0;
+
+	do {
+		reversed[ n++ ] = '0' + (char)(number % 10);
+		number /= 10;
+	} while (number);
+	while (n)
+		*text++ = reversed[ --n ];
+	return text;
+} // PutNumber
+
+int MetricGetName( int id, char *name )
+{
+	if (id < METRIC_ERROR_0) {
+		strcpy( name, names[ id ] );
+		return 1;
+	}
+	strcpy( name, "Error " );
+	*PutNumber( name + strlen( name ), id - METRIC_ERROR_0 ) = '\0';
+	return metrics[ id ] != 0;
+} // MetricGetName
+
+void MetricGetValue( int id, char *text )
+{
+	*PutNumber( text, metrics[ id ] ) = '\0';
+} // MetricGetValue
+
+unsigned long MetricsExport( char *text, unsigned long size )
+{
+	char	name[ METRIC_NAME_SIZE ], line[ METRIC_NAME_SIZE + 24 ];
+	unsigned long	length = 0, n;
+	int	id;
+
+	if (size == 0)
+		return 0;
+	text[0] = '\0';
+	for (id = 0; id < METRIC_N; id++) {
+		if (! MetricGetName( id, name ))
+			continue;
+		n = strlen( name );
+		memcpy( line, name, n );
+		for (; n < METRIC_NAME_SIZE - 1; n++) // Padded as "%-16s".
+			line[n] = ' ';
+		n = PutNumber( line + n, metrics[ id ] ) - line;
+		line[ n++ ] = '\n';
+		line[n] = '\0';
+		if (length + n < size) { // Room for the null too.
+			memcpy( text + length, line, n + 1 );
+			length += n;
+		}
+	}
+	return length;
+} // MetricsExport
@@ -0,0 +1,111 @@
+/*! \file metrics.h
+ * Counters and gauges of what the calculator has done since it was
+ * powered up: expressions, their tokens and errors, keys, rubouts, LCD
+ * bytes and flash operations.
+ *
+ * The metrics are named at compile time, in METRICS below, and each is a
+ * word of one static table: nothing is registered or allocated at run
+ * time. A counter is counted with MetricCount() or MetricAdd(), a gauge
+ * set with MetricSet(); each is a macro which updates the word in place,
+ * with no call and no test, so they stay in the production build. On the
+ * Cortex-M4 that is a load, an add and a store (there is no add to
+ * memory), a few cycles. Each metric is written by one context only (the
+ * main program, or one task), so no count is lost to an interrupt
+ * between the load and the store.
+ *
+ * The errors of CalculateAnswer() are counted by their error_ref_no, in
+ * METRIC_ERROR_NUMBERS metrics after the named ones, named "Error 1" and
+ * so on. Those which never happened are neither shown nor exported.
+ *
+ * Pressing D at Welcome()'s menu (it is not offered) shows the metrics on
+ * the LCD, one a screen: the name on line 1 and the value on line 2. Each
+ * key shows the next, and # goes back to the menu. MetricsExport() writes
+ * them as text, a line each: the name padded to 16 characters, then the
+ * value. The host calculator prints it when it exits.
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+/*! The metrics: COUNTER( id, name ) or GAUGE( id, name ), in the order
+ * shown. Each name fits a line of the LCD.
+ */
+#define METRICS( COUNTER, GAUGE ) \
+	COUNTER( EXPRESSIONS,	"Expressions" )		/* CalculateAnswer() calls */ \
+	COUNTER( ERRORS,	"Errors" )		/* Those with an error */ \
+	COUNTER( TOKENS,	"Tokens" )		/* Numbers and operators parsed */ \
+	GAUGE(   LAST_TOKENS,	"Last tokens" )		/* In the last expression parsed */ \
+	COUNTER( KEYS,		"Keys pressed" )	/* Debounced presses */ \
+	COUNTER( RUBOUTS,	"Rubouts" )		/* Characters deleted */ \
+	COUNTER( LCD_BYTES,	"LCD bytes" )		/* Sent by the display task */ \
+	COUNTER( FLASH_WRITES,	"Flash writes" )	/* Words programmed */ \
+	COUNTER( FLASH_ERASES,	"Flash erases" )	/* Pages erased */
+
+#define METRIC_ERROR_NUMBERS	20	// MAX_ERROR_MESSAGES, see calculate_answer.h
+#define METRIC_NAME_SIZE	17	// A line of the LCD, and the null.
+
+#define METRIC_ENUM( id, name )	METRIC_##id,
+
+/*! Where each metric is in the table.
+ */
+typedef enum {
+	METRICS( METRIC_ENUM, METRIC_ENUM )
+	METRIC_ERROR_0,		//!< The first of the errors, by error_ref_no.
+	METRIC_N = METRIC_ERROR_0 + METRIC_ERROR_NUMBERS
+} MetricId;
+
+/*! The values, by MetricId. Read them freely; write them only through the
+ * macros below.
+ */
+extern unsigned long	metrics[ METRIC_N ];
+
+/*! Count one, e.g. MetricCount( KEYS ).
+ */
+#define MetricCount( id )		(metrics[ METRIC_##id ]++)
+
+/*! Count \a n.
+ */
+#define MetricAdd( id, n )		(metrics[ METRIC_##id ] += (n))
+
+/*! Set a gauge.
+ */
+#define MetricSet( id, value )		(metrics[ METRIC_##id ] = (value))
+
+/*! Count an error of CalculateAnswer(): 1 to METRIC_ERROR_NUMBERS - 1.
+ */
+#define MetricCountError( error_ref_no )	(metrics[ METRIC_ERROR_0 + (error_ref_no) ]++)
+
+/*! Zero every metric: at power-up. Called by InitAllHardware().
+ */
+void MetricsReset( void );
+
+/*! Whether a metric is a gauge, rather than a counter.
+ */
+int MetricIsGauge( int id );
+
+/*! The name of a metric.
+ *
+ * \param [in] id A MetricId.
+ * \param [out] name At least METRIC_NAME_SIZE characters.
+ * \return Non-zero if it should be shown: all but the errors which never
+ * 		happened.
+ */
+int MetricGetName( int id, char *name );
+
+/*! The value of a metric in decimal, for the display.
+ *
+ * \param [in] id A MetricId.
+ * \param [out] text At least METRIC_NAME_SIZE characters.
+ */
+void MetricGetValue( int id, char *text );
+
+/*! Write the metrics as text (see above).
+ *
+ * \param [out] text Where to write it.
+ * \param [in] size The size of \a text. Lines which do not fit are left
+ * 		out.
+ * \return The length written, without the terminating null.
+ */
+unsigned long MetricsExport( char *text, unsigned long size );
+
+#endif // of #ifndef METRICS_H
@@ -11,9 +11,42 @@
 #include "TExaS.h"
 #include "mid_level_funcs.h"
 #include "low_level_funcs_tiva.h"
+#include "time_source.h"
+#include "key_events.h"
+#include "key_trace.h"
 
 // ------------------------ Keyboard functions ------------------------
 
+static SoftTimer key_timeout;  // Running while GetKeyboardCharWithin() waits
+
+static void KeyTimeout( void )
+{
+}  // Nothing to do: the timer only wakes TimeIdle()
+
+static int WaitKeyPress( KeyEvent *event, int timed )
+/* Take the next press or auto-repeat from the queue, sleeping until there
+ * is one. If timed, give up (returning 0) once key_timeout has fired. */
+{
+	while (1) {
+		long sr = StartCritical();
+		if (KeyEventPop(event)) {  // Queued by the keypad sampler
+			EndCritical(sr);
+			KeyTraceKey(event->type, KeyboardRowCol2Char(event->row, event->col),
+				    event->time_us);  // Before it is acted on
+			if (event->type != KEY_RELEASE) {  // Press or auto-repeat
+				return 1;
+			}
+			continue;
+		}
+		if (timed && ! TimerIsActive(&key_timeout)) {
+			EndCritical(sr);
+			return 0;
+		}
+		TimeIdle();  // Sleep tickless; wakes even with interrupts disabled
+		EndCritical(sr);  // The interrupt is taken here
+	}
+} // WaitKeyPress
+
 char GetKeyboardChar()
 {
 	int row;
@@ -22,47 +55,38 @@ char GetKeyboardChar()
 	return KeyboardRowCol2Char(row, col);
 } // GetKeyboardChar
 
-void KeyboardReadRowCol( int *row, int *col )
+char GetKeyboardCharWithin( unsigned long timeout_us )
 {
-	unsigned char nibble;
-	unsigned char input = 0x00;
-	do{
-	for (nibble = 0x01; nibble <= 0x08; nibble = nibble << 1){ 
-		WriteKeyboardCol(nibble); 
-		input = ReadKeyboardRow();
-		if (input == 0x01) {
-			*row = 0;
-			*col = HexToDeci(nibble);
-			break;
-		} else if (input == 0x02) {
-			*row = 1;
-			*col = HexToDeci(nibble);
-			break;
-		} else if (input == 0x04) {
-			*row = 2;
-			*col = HexToDeci(nibble);
-			break;
-		} else if (input == 0x08) {
-			*row = 3;
-			*col = HexToDeci(nibble);
-			break;
-		} 
+	KeyEvent event;
+	TimerStart(&key_timeout, timeout_us, KeyTimeout);
+	if (! WaitKeyPress(&event, 1)) {
+		return '\0';  // Timed out
 	}
-  }while(input == 0x00);
+	TimerStop(&key_timeout);
+	return KeyboardRowCol2Char(event.row, event.col);
+} // GetKeyboardCharWithin
+
+void KeyboardReadRowCol( int *row, int *col )
+{
+	KeyEvent event;
+	WaitKeyPress(&event, 0);
+	*row = event.row;
+	*col = event.col;
 } // KeyboardReadRowCol
 
+static const char key_chars[4][4] = {  // In flash, not rebuilt on every call
+	{'1', '2', '3', 'A'},
+	{'4', '5', '6', 'B'},
+	{'7', '8', '9', 'C'},
+	{'*', '0', '#', 'D'}
+};
+
 char KeyboardRowCol2Char( int row, int col )
 {
-	int matrix[4][4] = {'1', '2', '3', 'A',
-											'4', '5', '6', 'B',
-											'7', '8', '9', 'C',
-											'*', '0', '#', 'D'};
-	
 	if((row > 3) || (row < 0) || (col > 3) || (col < 0)) {  // 
 		return '?';
 	} else {
-		char key = matrix[row][col];									
-		return key;
+		return key_chars[row][col];
 	}
 } // KeyboardRowCol2Char
 
@@ -50,9 +50,22 @@
  * 
  * In practice, this function will probably work by calling KeyboardReadRowCol() 
  * and KeyboardRowCol2Char().
+ * 
+ * The keypad is interrupt-driven (see module \a key_events), so while waiting 
+ * the processor sleeps rather than scanning.
  */
 char GetKeyboardChar();
 
+/*! Get the next character from keyboard, if one comes in time.
+ * 
+ * \param [in] timeout_us How long to wait for a key, in microseconds.
+ * \return The character read, as GetKeyboardChar() does, or '\0' if no 
+ * 		key was pressed within \a timeout_us.
+ * 
+ * The processor sleeps until the key or the timeout, whichever is first.
+ */
+char GetKeyboardCharWithin( unsigned long timeout_us );
+
 /*! Waits until a keyboard key is pressed, then returns its row and column numbers.
  * 
  * \param [out] row The row number of the key pressed. 
@@ -64,6 +77,15 @@ char GetKeyboardChar();
  * If none is currently pressed, the function waits until one is pressed and 
  * then returns its co-ordinates.
  * 
+ * The keys are debounced and queued by module \a key_events. This function 
+ * takes the oldest press (or auto-repeat) from the queue, discarding 
+ * releases and sleeping in TimeIdle() while the queue is empty. 
+ * Each press is therefore returned once, however long the key is held.
+ * 
+ * Every scan pass reads the whole keypad, so keys pressed together are 
+ * each returned, in the order they went down. While three held keys make 
+ * a fourth ambiguous (ghosting), no key changes state. 
+ * 
  * Extra test for extra marks:
  * If two or more keys are pressed at the same time, the function waits until 
  * only one is pressed and returns that key's row and column.
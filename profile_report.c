@@ -0,0 +1,218 @@
+/* profile_report.c
+ *
+ * Symbolizes a profile written by ProfileExport() (see \a profiler) against
+ * the ELF it was taken from, on the host, and prints where the samples
+ * fell: by function, by source line, and the call stacks kept.
+ *
+ * Build with
+ * 	gcc -std=c99 -o profile_report profile_report.c
+ * and run "profile_report profile.txt elf [addr2line]", e.g.
+ * 	profile_report profile.txt calculator.axf arm-none-eabi-addr2line
+ * for the Tiva, or "profile_report profile.txt ./calculator" for a host
+ * build. The symbols come from addr2line -f and the matching nm (the same
+ * name with "nm" for "addr2line"), which must be on the path.
+ */
+
+#define _POSIX_C_SOURCE	200809L	// popen()
+#define PROG_NAME_VER		"profile_report v1.0"
+#define MAX_ADDRESSES		4096	// Different addresses in a profile.
+#define MAX_STACKS		64
+#define MAX_DEPTH		8
+#define BATCH			32	// Addresses per run of addr2line.
+#define TOP			20	// Functions and lines printed.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+	unsigned long	address;	// In the ELF.
+	unsigned long	count;
+	char	function[64];
+	char	line[96];		// file:line, without the directory.
+} Address;
+
+typedef struct {
+	char	name[96];
+	unsigned long	count;
+} Total;
+
+static Address	addresses[ MAX_ADDRESSES ];
+static int	n_addresses = 0;
+static Total	totals[ MAX_ADDRESSES ];
+static unsigned long	stacks[ MAX_STACKS ][ MAX_DEPTH ];
+static int	stack_depths[ MAX_STACKS ];
+static int	n_stacks = 0;
+static unsigned long	n_samples, n_dropped, period_us;
+
+static Address *Find( unsigned long address )
+// The entry for an address, added if it is new.
+{
+	int	i;
+
+	for (i = 0; i < n_addresses; i++)
+		if (addresses[i].address == address)
+			return &addresses[i];
+	if (n_addresses == MAX_ADDRESSES)
+		return 0;
+	addresses[ n_addresses ].address = address;
+	addresses[ n_addresses ].count = 0;
+	strcpy( addresses[ n_addresses ].function, "??" );
+	strcpy( addresses[ n_addresses ].line, "??" );
+	return &addresses[ n_addresses++ ];
+} // Find
+
+static unsigned long LinkAddress( const char *nm, const char *elf, const char *symbol )
+// The address of a symbol in the ELF, from nm; 0 if it is not found.
+{
+	char	command[512], line[256], name[128], type;
+	unsigned long	address, found = 0;
+	FILE	*pipe;
+
+	snprintf( command, sizeof command, "%s '%s'", nm, elf );
+	pipe = popen( command, "r" );
+	if (! pipe)
+		return 0;
+	while (fgets( line, sizeof line, pipe ))
+		if (sscanf( line, "%lx %c %127s", &address, &type, name ) == 3
+		    && strcmp( name, symbol ) == 0)
+			found = address;
+	pclose( pipe );
+	return found & ~1UL;  // The Thumb bit
+} // LinkAddress
+
+static void Symbolize( const char *addr2line, const char *elf )
+// Fill in the function and line of every address.
+{
+	int	first;
+
+	for (first = 0; first < n_addresses; first += BATCH) {
+		char	command[ 512 + 20 * BATCH ], function[256], where[512];
+		int	i, n = snprintf( command, sizeof command, "%s -f -e '%s'", addr2line, elf );
+		FILE	*pipe;
+
+		for (i = first; i < n_addresses && i < first + BATCH; i++)
+			n += snprintf( command + n, sizeof command - n, " %#lx", addresses[i].address );
+		pipe = popen( command, "r" );
+		if (! pipe)
+			return;
+		for (i = first; i < n_addresses && i < first + BATCH; i++) {
+			const char	*base;
+
+			if (! fgets( function, sizeof function, pipe ) || ! fgets( where, sizeof where, pipe ))
+				break;
+			function[ strcspn( function, "\r\n" ) ] = '\0';
+			where[ strcspn( where, " \r\n" ) ] = '\0';
+			base = strrchr( where, '/' );
+			snprintf( addresses[i].function, sizeof addresses[i].function, "%.*s",
+				  (int)sizeof addresses[i].function - 1, function );
+			snprintf( addresses[i].line, sizeof addresses[i].line, "%.*s",
+				  (int)sizeof addresses[i].line - 1, base ? base + 1 : where );
+		}
+		pclose( pipe );
+	}
+} // Symbolize
+
+static int ByCount( const void *a, const void *b )
+{
+	unsigned long	ca = ((const Total *)a)->count, cb = ((const Total *)b)->count;
+
+	return (ca < cb) - (ca > cb);
+} // ByCount
+
+static void PrintTotals( const char *heading, int by_line )
+// The samples added up by function or by line, most first.
+{
+	int	n = 0, i, j;
+
+	for (i = 0; i < n_addresses; i++) {
+		const char	*name = by_line ? addresses[i].line : addresses[i].function;
+
+		if (addresses[i].count == 0)
+			continue;  // Only in stacks.
+		for (j = 0; j < n && strcmp( totals[j].name, name ) != 0; j++)
+			;
+		if (j == n) {
+			snprintf( totals[n].name, sizeof totals[n].name, "%s", name );
+			totals[ n++ ].count = 0;
+		}
+		totals[j].count += addresses[i].count;
+	}
+	qsort( totals, n, sizeof totals[0], ByCount );
+	printf( "%s:\n", heading );
+	for (i = 0; i < n && i < TOP; i++)
+		printf( "\t%6.2f%%  %8lu  %s\n", 100.0 * totals[i].count / n_samples,
+			totals[i].count, totals[i].name );
+} // PrintTotals
+
+int main( int argc, char* argv[] )
+{
+	const char	*addr2line = (argc == 4) ? argv[3] : "addr2line";
+	char	nm[256], line[1024];
+	unsigned long	anchor = 0, offset;
+	size_t	tool_length;
+	FILE	*file;
+	int	i, j;
+
+	printf( "\n%s\n", PROG_NAME_VER );
+	if (argc != 3 && argc != 4) {
+		puts( "FATAL: usage is profile_report profile elf [addr2line]" );
+		exit( EXIT_FAILURE );
+	}
+	file = fopen( argv[1], "r" );
+	if (! file || ! fgets( line, sizeof line, file )
+	    || sscanf( line, "profile 1 period_us %lu samples %lu dropped %lu anchor %lx",
+		       &period_us, &n_samples, &n_dropped, &anchor ) != 4) {
+		printf( "FATAL: %s is not a profile\n", argv[1] );
+		exit( EXIT_FAILURE );
+	}
+
+	/* The addresses are where the code was when it ran: for a position-
+	 * independent host executable, not where the ELF has it. */
+	tool_length = strlen( addr2line );
+	snprintf( nm, sizeof nm, "%s", addr2line );
+	if (tool_length >= 9 && strcmp( addr2line + tool_length - 9, "addr2line" ) == 0)
+		snprintf( nm + tool_length - 9, sizeof nm - (tool_length - 9), "nm" );
+	else	snprintf( nm, sizeof nm, "nm" );
+	offset = (anchor & ~1UL) - LinkAddress( nm, argv[2], "ProfileExport" );
+
+	while (fgets( line, sizeof line, file )) {
+		unsigned long	address, count;
+		char	*p;
+
+		if (sscanf( line, "pc %lx %lu", &address, &count ) == 2) {
+			Address	*entry = Find( (address & ~1UL) - offset );
+			if (entry)
+				entry->count += count;
+		} else if (strncmp( line, "stack", 5 ) == 0 && n_stacks < MAX_STACKS) {
+			int	depth = 0;
+
+			for (p = line + 5; depth < MAX_DEPTH && sscanf( p, " %lx", &address ) == 1; depth++) {
+				/* A return address is after the call: look up the
+				 * call itself. */
+				address = (address & ~1UL) - offset - (depth ? 1 : 0);
+				stacks[ n_stacks ][ depth ] = address;
+				Find( address );
+				p = strchr( p + 1, ' ' ) ? strchr( p + 1, ' ' ) : p + strlen( p );
+			}
+			stack_depths[ n_stacks++ ] = depth;
+		}
+	}
+	fclose( file );
+	Symbolize( addr2line, argv[2] );
+
+	printf( "%lu samples every %lu us (%.3f s), %lu dropped, %d addresses\n",
+		n_samples, period_us, n_samples * period_us / 1e6, n_dropped, n_addresses );
+	if (n_samples == 0)
+		return EXIT_SUCCESS;
+	PrintTotals( "By function", 0 );
+	PrintTotals( "By line", 1 );
+	printf( "Last %d call stacks, innermost first:\n", n_stacks );
+	for (i = 0; i < n_stacks; i++) {
+		printf( "\t" );
+		for (j = 0; j < stack_depths[i]; j++)
+			printf( "%s%s", j ? " <- " : "", Find( stacks[i][j] )->function );
+		printf( "\n" );
+	}
+	return EXIT_SUCCESS;
+} // main
@@ -0,0 +1,144 @@
+/* profiler.c
+ *
+ * The profiler's histogram, call-stack ring and export, shared by the
+ * samplers (profiler_tiva.c and profiler_host.c).
+ *
+ * For documentation, see the corresponding .h file.
+ */
+
+#include <string.h>
+#include "profiler.h"
+
+static ProfileSlot	slots[ PROFILE_SLOTS ];
+static uintptr_t	stacks[ PROFILE_STACKS ][ PROFILE_STACK_DEPTH ];	// Unused entries 0.
+static unsigned long	n_samples = 0;
+static unsigned long	n_dropped = 0;
+static unsigned long	sample_period_us = PROFILE_PERIOD_US;
+
+void ProfileReset( void )
+{
+	memset( slots, 0, sizeof slots );
+	memset( stacks, 0, sizeof stacks );
+	n_samples = n_dropped = 0;
+} // ProfileReset
+
+void ProfileSetPeriod( unsigned long period_us )
+{
+	sample_period_us = period_us;
+} // ProfileSetPeriod
+
+static unsigned long Hash( uintptr_t pc )
+{
+	return (unsigned long)(((uint32_t)(pc >> 1) * 2654435761u) >> 16) & (PROFILE_SLOTS - 1);
+} // Hash, Fibonacci hashing of the halfword address
+
+void ProfileSample( const uintptr_t *stack, int depth )
+{
+	unsigned long	i = Hash( stack[0] );
+	uintptr_t	*ring = stacks[ n_samples % PROFILE_STACKS ];
+	int	probe;
+
+	for (probe = 0; probe < PROFILE_PROBES; probe++, i = (i + 1) & (PROFILE_SLOTS - 1)) {
+		if (slots[i].pc == stack[0] || slots[i].pc == 0) {
+			slots[i].pc = stack[0];
+			slots[i].count ++;
+			break;
+		}
+	}
+	if (probe == PROFILE_PROBES)
+		n_dropped ++;
+	for (probe = 0; probe < PROFILE_STACK_DEPTH; probe++)
+		ring[probe] = (probe < depth) ? stack[probe] : 0;
+	n_samples ++;
+} // ProfileSample
+
+unsigned long ProfileGetHistogram( const ProfileSlot **slots_out, unsigned long *dropped )
+{
+	*slots_out = slots;
+	*dropped = n_dropped;
+	return n_samples;
+} // ProfileGetHistogram
+
+unsigned long ProfileCountRange( uintptr_t start, uintptr_t end )
+{
+	unsigned long	count = 0;
+	int	i;
+
+	for (i = 0; i < PROFILE_SLOTS; i++)
+		if (slots[i].pc >= start && slots[i].pc < end)
+			count += slots[i].count;
+	return count;
+} // ProfileCountRange
+
+static unsigned long Append( char *text, unsigned long size, unsigned long length,
+			     const char *line )
+// Add a line if it fits, with room for the null.
+{
+	unsigned long	n = strlen( line );
+
+	if (length + n < size) {
+		memcpy( text + length, line, n + 1 );
+		length += n;
+	}
+	return length;
+} // Append
+
+static char *Put( char *text, const char *words, unsigned long number, int hex )
+/* Write words then number, in decimal or in hex after "0x", at text: the
+ * end of it, unterminated: without sprintf, which is kept out of the
+ * Tiva build. */
+{
+	char	reversed[ 3 * sizeof number ];	// Decimal needs more than hex.
+	int	n = 0;
+
+	while (*words)
+		*text++ = *words++;
+	if (hex) {
+		*text++ = '0';
+		*text++ = 'x';
+	}
+	do {
+		reversed[ n++ ] = "0123456789abcdef"[ number % (hex ? 16 : 10) ];
+		number /= hex ? 16 : 10;
+	} while (number);
+	while (n)
+		*text++ = reversed[ --n ];
+	return text;
+} // Put
+
+unsigned long ProfileExport( char *text, unsigned long size )
+{
+	char	line[ 24 * (PROFILE_STACK_DEPTH + 1) ], *end;
+	unsigned long	length = 0, i;
+	int	j;
+
+	if (size == 0)
+		return 0;
+	text[0] = '\0';
+	end = Put( line, "profile 1 period_us ", sample_period_us, 0 );
+	end = Put( end, " samples ", n_samples, 0 );
+	end = Put( end, " dropped ", n_dropped, 0 );
+	end = Put( end, " anchor ", (unsigned long)(uintptr_t)ProfileExport, 1 );
+	strcpy( end, "\n" );
+	length = Append( text, size, length, line );
+	for (i = 0; i < PROFILE_SLOTS; i++) {
+		if (slots[i].pc == 0)
+			continue;
+		end = Put( line, "pc ", (unsigned long)slots[i].pc, 1 );
+		end = Put( end, " ", slots[i].count, 0 );
+		strcpy( end, "\n" );
+		length = Append( text, size, length, line );
+	}
+	for (i = 0; i < PROFILE_STACKS && i < n_samples; i++) { // Oldest first.
+		const uintptr_t	*stack = stacks[ (n_samples < PROFILE_STACKS) ? i
+					     : (n_samples + i) % PROFILE_STACKS ];
+
+		strcpy( line, "stack" );
+		end = line + strlen( line );
+		for (j = 0; j < PROFILE_STACK_DEPTH && stack[j]; j++)
+			end = Put( end, " ", (unsigned long)stack[j], 1 );
+		strcpy( end, "\n" );
+		length = Append( text, size, length, line );
+	}
+	return length;
+} // ProfileExport
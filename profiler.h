@@ -0,0 +1,120 @@
+/*! \file profiler.h
+ * A statistical profiler: where the program counter is, sampled by a
+ * periodic interrupt, without instrumenting the code.
+ *
+ * Each sample is the address of the instruction which was interrupted,
+ * counted in a fixed histogram of PROFILE_SLOTS addresses, and a short
+ * call stack (that address, then the return addresses found), kept in a
+ * ring of the last PROFILE_STACKS. Recording a sample is a hash probe and a
+ * few stores; nothing is allocated. There are two samplers, chosen when
+ * linking, as for the time source:
+ * 	- \a profiler_tiva: the SysTick interrupt, every period, at the
+ * 		highest priority, so other interrupt handlers are sampled
+ * 		too. It reads the PC from the exception's stack frame; the
+ * 		stack is the PC and the stacked LR (the caller, while the
+ * 		interrupted function has not called another), as Thumb code
+ * 		has no frame chain to follow. SysTick is stopped while the
+ * 		processor sleeps (TimeIdle()), so only time awake is
+ * 		sampled: sleep is in TimeGetIdleStats().
+ * 	- \a profiler_host: SIGPROF, every period of the process's CPU time.
+ * 		Built with -fno-omit-frame-pointer and
+ * 		-DPROFILE_FRAME_POINTERS, the stack follows the frame chain;
+ * 		otherwise it is the PC alone. It profiles the host's CPU, not
+ * 		simulated time: the benchmarks report that.
+ *
+ * ProfileExport() writes the profile as text, the same on both:
+ *
+ * 	profile 1 period_us 1009 samples 5230 dropped 0 anchor 0x8d4
+ * 	pc 0x1f6 2211
+ * 	...
+ * 	stack 0x1f6 0x2e4
+ * 	...
+ *
+ * "anchor" is where ProfileExport() itself is, which lets profile_report
+ * (a host program) match the addresses to a position-independent host
+ * executable's symbols. It symbolizes the profile against the ELF (the
+ * Tiva's .axf, or the host executable) with addr2line, and prints the
+ * samples by function and by line:
+ *
+ * 	profile_report profile.txt calculator.axf arm-none-eabi-addr2line
+ *
+ * Built with -DPROFILE_AT_BOOT, InitAllOther() starts the profiler every
+ * PROFILE_PERIOD_US; on the host the profile is then written to
+ * PROFILE_HOST_FILE when the program exits. On the Tiva it is read out
+ * with the debugger, e.g. by calling ProfileExport() into a buffer.
+ */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+
+#ifndef PROFILE_SLOTS
+#define PROFILE_SLOTS		256	// Addresses in the histogram. Must be a power of two.
+#endif
+#define PROFILE_PROBES		8	// Slots tried for an address before it is dropped.
+#define PROFILE_STACKS		16	// Call stacks kept, the newest.
+#define PROFILE_STACK_DEPTH	4	// Addresses in each, the PC first.
+#ifndef PROFILE_PERIOD_US
+#define PROFILE_PERIOD_US	1009	/* Prime, so as not to keep step with
+				 * the 1 ms timer tick. */
+#endif
+#define PROFILE_HOST_FILE	"profile.txt"
+
+/*! One address of the histogram.
+ */
+typedef struct {
+	uintptr_t	pc;		//!< The address, or 0 for a free slot.
+	unsigned long	count;		//!< Samples there.
+} ProfileSlot;
+
+/*! Forget all samples.
+ */
+void ProfileReset( void );
+
+/*! Start sampling, every \a period_us, keeping the samples so far. Its
+ * implementation is in the sampler.
+ */
+void ProfileStart( unsigned long period_us );
+
+/*! Stop sampling. Its implementation is in the sampler.
+ */
+void ProfileStop( void );
+
+/*! Record a sample. Called by the sampler's interrupt (or signal)
+ * handler, not by the rest of the program.
+ *
+ * \param [in] stack The interrupted PC, then return addresses, innermost
+ * 		first.
+ * \param [in] depth How many: 1 to PROFILE_STACK_DEPTH.
+ */
+void ProfileSample( const uintptr_t *stack, int depth );
+
+/*! Record the sampling period, for the export. Called by ProfileStart().
+ */
+void ProfileSetPeriod( unsigned long period_us );
+
+/*! The histogram, and the samples taken and dropped (their address found
+ * no free slot).
+ *
+ * \param [out] slots PROFILE_SLOTS slots, unsorted, free ones with pc 0.
+ * \return The samples taken, including those dropped.
+ */
+unsigned long ProfileGetHistogram( const ProfileSlot **slots, unsigned long *dropped );
+
+/*! The count of samples at addresses from \a start to before \a end: for a
+ * function, from its address to the next's. For tests.
+ */
+unsigned long ProfileCountRange( uintptr_t start, uintptr_t end );
+
+/*! Write the profile as text (see above). Stop sampling first, or a sample
+ * may be half written.
+ *
+ * \param [out] text Where to write it.
+ * \param [in] size The size of \a text. Lines which do not fit are left
+ * 		out.
+ * \return The length written, without the terminating null.
+ */
+unsigned long ProfileExport( char *text, unsigned long size );
+
+#endif // of #ifndef PROFILER_H
@@ -0,0 +1,119 @@
+/* profiler_host.c
+ *
+ * Host sampler of profiler.h: SIGPROF, from setitimer( ITIMER_PROF ), which
+ * counts the CPU time the process uses.
+ *
+ * The signal handler takes the interrupted PC from the signal's context.
+ * With PROFILE_FRAME_POINTERS, and the program built with
+ * -fno-omit-frame-pointer, it follows the frame chain for the return
+ * addresses: each frame pointer points at the caller's frame pointer,
+ * with the return address after it. A chain which leaves the stack, or
+ * does not climb it, ends the stack early. The registers are those of
+ * Linux on x86-64 or AArch64; elsewhere there are no samples.
+ *
+ * With PROFILE_AT_BOOT the profile is written to PROFILE_HOST_FILE when the
+ * program exits.
+ *
+ * For documentation, see the corresponding .h file.
+ */
+
+#define _GNU_SOURCE	// For the registers in ucontext_t.
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <ucontext.h>
+#include <sys/time.h>
+#include "profiler.h"
+
+#define PROFILE_EXPORT_SIZE	(64 * PROFILE_SLOTS + 128 * PROFILE_STACKS)
+#define STACK_SPAN		(1024 * 1024)	// A frame further than this up the stack ends the chain.
+
+// =========================== FUNCTIONS ============================
+
+static void Handler( int signal, siginfo_t *info, void *context )
+// SIGPROF.
+{
+	const ucontext_t	*uc = (const ucontext_t *)context;
+	uintptr_t	stack[ PROFILE_STACK_DEPTH ];
+	uintptr_t	sp = 0, fp = 0;
+	int	depth = 1;
+
+	(void)signal;
+	(void)info;
+#if defined( __x86_64__ )
+	stack[0] = (uintptr_t)uc->uc_mcontext.gregs[ REG_RIP ];
+	sp = (uintptr_t)uc->uc_mcontext.gregs[ REG_RSP ];
+	fp = (uintptr_t)uc->uc_mcontext.gregs[ REG_RBP ];
+#elif defined( __aarch64__ )
+	stack[0] = (uintptr_t)uc->uc_mcontext.pc;
+	sp = (uintptr_t)uc->uc_mcontext.sp;
+	fp = (uintptr_t)uc->uc_mcontext.regs[29];
+#else
+	return;
+#endif
+#ifdef PROFILE_FRAME_POINTERS
+	while (depth < PROFILE_STACK_DEPTH && fp >= sp && fp < sp + STACK_SPAN
+	       && fp % sizeof (uintptr_t) == 0) {
+		const uintptr_t	*frame = (const uintptr_t *)fp;
+
+		stack[ depth++ ] = frame[1];  // The return address,
+		if (frame[0] <= fp)
+			break;
+		fp = frame[0];                // then the caller's frame, higher up.
+	}
+#else
+	(void)sp;
+	(void)fp;
+#endif
+	ProfileSample( stack, depth );
+} // Handler
+
+static void SetTimer( unsigned long period_us )
+{
+	struct itimerval	timer;
+
+	timer.it_interval.tv_sec = period_us / 1000000;
+	timer.it_interval.tv_usec = period_us % 1000000;
+	timer.it_value = timer.it_interval;
+	setitimer( ITIMER_PROF, &timer, 0 );
+} // SetTimer
+
+static void WriteAtExit( void )
+{
+	static char	text[ PROFILE_EXPORT_SIZE ];
+	FILE	*file;
+
+	ProfileStop();
+	ProfileExport( text, sizeof text );
+	file = fopen( PROFILE_HOST_FILE, "w" );
+	if (file) {
+		fputs( text, file );
+		fclose( file );
+	}
+} // WriteAtExit
+
+void ProfileStart( unsigned long period_us )
+{
+	static int	at_exit = 0;
+	struct sigaction	action;
+
+	ProfileSetPeriod( period_us );
+	action.sa_sigaction = Handler;
+	sigemptyset( &action.sa_mask );
+	action.sa_flags = SA_SIGINFO | SA_RESTART;
+	sigaction( SIGPROF, &action, 0 );
+	SetTimer( period_us );
+#ifdef PROFILE_AT_BOOT
+	if (! at_exit)
+		atexit( WriteAtExit );
+	at_exit = 1;
+#else
+	(void)at_exit;
+	(void)WriteAtExit;
+#endif
+} // ProfileStart
+
+void ProfileStop( void )
+{
+	SetTimer( 0 );
+} // ProfileStop
@@ -0,0 +1,86 @@
+/* profiler_tiva.c
+ *
+ * Tiva sampler of profiler.h: the SysTick interrupt.
+ *
+ * SysTick is left running by SysTick_Init() (see PLL.c) with no interrupt.
+ * ProfileStart() reloads it for the period and enables its interrupt, at
+ * priority 0, the highest, so that it samples the other interrupt handlers
+ * as well as the main program. TimeSourceSleep() stops SysTick while the
+ * processor sleeps and starts it again on waking, interrupt and all.
+ *
+ * On an exception the processor stacks R0-R3, R12, LR, PC and xPSR on the
+ * stack which was in use; the handler takes that frame's address (from
+ * MSP or PSP, as EXC_RETURN in LR says) and passes it to Sample(). This
+ * needs a few instructions of assembler, given for both the Keil (ARMCC)
+ * and the GNU compiler.
+ *
+ * For documentation, see the corresponding .h file.
+ */
+
+#include "profiler.h"
+
+// =========================== CONSTANTS ============================
+
+#define CLOCKS_PER_MICROSEC	80	// 80 MHz system clock, see PLL_Init().
+#define NVIC_ST_CTRL_R		(*((volatile unsigned long *)0xE000E010))
+#define NVIC_ST_RELOAD_R	(*((volatile unsigned long *)0xE000E014))
+#define NVIC_ST_CURRENT_R	(*((volatile unsigned long *)0xE000E018))
+#define NVIC_SYS_PRI3_R		(*((volatile unsigned long *)0xE000ED20))	// SysTick priority is bits 31-29
+#define STACKED_LR		5	// Words into the exception's stack frame.
+#define STACKED_PC		6
+
+// =========================== FUNCTIONS ============================
+
+void ProfileStart( unsigned long period_us )
+{
+	unsigned long	reload = period_us * CLOCKS_PER_MICROSEC - 1;
+
+	if (reload > 0x00FFFFFF)
+		reload = 0x00FFFFFF;  // 24 bits: 209 ms at most
+	ProfileSetPeriod( period_us );
+	NVIC_ST_CTRL_R = 0;                 // disable SysTick during setup
+	NVIC_ST_RELOAD_R = reload;
+	NVIC_ST_CURRENT_R = 0;              // any write to current clears it
+	NVIC_SYS_PRI3_R &= 0x1FFFFFFF;      // priority 0
+	NVIC_ST_CTRL_R = 0x00000007;        // enable, with interrupts, on the core clock
+} // ProfileStart
+
+void ProfileStop( void )
+{
+	NVIC_ST_CTRL_R = 0x00000005;        // no interrupts; counting on, as SysTick_Init() left it
+} // ProfileStop
+
+void ProfileFrameSample( const unsigned long *frame )
+// Called by SysTick_Handler() with the exception's stack frame.
+{
+	uintptr_t	stack[2];
+	int	depth = 1;
+
+	stack[0] = frame[ STACKED_PC ];
+	stack[1] = frame[ STACKED_LR ] & ~1UL;  // Thumb bit
+	if (frame[ STACKED_LR ] < 0xF0000000)
+		depth = 2;  // Not EXC_RETURN, so a return address
+	ProfileSample( stack, depth );
+} // ProfileFrameSample
+
+#if defined( __CC_ARM )
+__asm void SysTick_Handler( void )
+{
+	IMPORT	ProfileFrameSample
+	TST	LR, #4          ; which stack was in use?
+	ITE	EQ
+	MRSEQ	R0, MSP
+	MRSNE	R0, PSP
+	B	ProfileFrameSample ; returns from the exception for us
+}
+#elif defined( __GNUC__ )
+__attribute__(( naked )) void SysTick_Handler( void )
+{
+	__asm volatile (
+		"	tst	lr, #4\n"
+		"	ite	eq\n"
+		"	mrseq	r0, msp\n"
+		"	mrsne	r0, psp\n"
+		"	b	ProfileFrameSample\n" );
+}
+#endif
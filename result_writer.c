@@ -0,0 +1,107 @@
+/* result_writer.c
+ *
+ * Results formatted straight into a large buffer, written out in big
+ * write() calls.
+ *
+ * For documentation, see the corresponding .h file.
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "format_double.h"
+#include "result_writer.h"
+
+#define SHORTEST_WIDTH	24	// "-1.2345678901234567E-308" always fits.
+
+void ResultWriterOpen( ResultWriter *writer, int fd, ResultFormat format,
+		       int digits, char *buffer, size_t size )
+{
+	writer->fd = fd;
+	writer->format = format;
+	writer->digits = (digits < 1) ? 1
+		: (digits > FORMAT_MAX_DIGITS) ? FORMAT_MAX_DIGITS : digits;
+	writer->buffer = buffer;
+	writer->size = size;
+	writer->used = 0;
+	writer->error = 0;
+	writer->n_results = writer->n_bytes = writer->n_writes = 0;
+} // ResultWriterOpen
+
+int ResultWriterFlush( ResultWriter *writer )
+{
+	size_t	done = 0;
+	ssize_t	n;
+
+	while (done < writer->used) {
+		n = write( writer->fd, writer->buffer + done, writer->used - done );
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			writer->error = errno;
+			memmove( writer->buffer, writer->buffer + done, writer->used - done );
+			writer->used -= done;  // Keep what is left, to retry.
+			return -1;
+		}
+		writer->n_writes ++;
+		done += (size_t)n;
+	}
+	writer->n_bytes += done;
+	writer->used = 0;
+	return 0;
+} // ResultWriterFlush
+
+static int FixedLine( double result, int n_digits, char *line )
+// result to n_digits in E notation, as "%.*E\n" does: the length.
+{
+	char	digits[ FORMAT_MAX_DIGITS + 1 ];
+	int	n, exp10, i, length = 0;
+
+	if (result != result || result > 1.7976931348623157e308
+	    || result < -1.7976931348623157e308)
+		return FormatDouble( result, line, SHORTEST_WIDTH );  // nan, inf
+	if (result < 0 || (result == 0 && 1 / result < 0))
+		line[ length++ ] = '-';
+	n = FormatRoundedDigits( result, n_digits, digits, &exp10 );
+	if (result == 0)
+		exp10 = 0;
+	line[ length++ ] = digits[0];
+	if (n_digits > 1)
+		line[ length++ ] = '.';
+	for (i = 1; i < n_digits; i++)
+		line[ length++ ] = (i < n) ? digits[i] : '0';
+	line[ length++ ] = 'E';
+	line[ length++ ] = (exp10 < 0) ? '-' : '+';
+	if (exp10 < 0)
+		exp10 = -exp10;
+	if (exp10 >= 100)
+		line[ length++ ] = '0' + (char)(exp10 / 100);
+	line[ length++ ] = '0' + (char)(exp10 / 10 % 10);
+	line[ length++ ] = '0' + (char)(exp10 % 10);
+	return length;
+} // FixedLine
+
+int ResultWrite( ResultWriter *writer, double result )
+{
+	char	*line;
+
+	if (writer->size - writer->used < RESULT_MAX_LENGTH
+	    && ResultWriterFlush( writer ) != 0)
+		return -1;
+	line = writer->buffer + writer->used;
+	switch (writer->format) {
+	case RESULT_BINARY:
+		memcpy( line, &result, sizeof result );
+		writer->used += sizeof result;
+		break;
+	case RESULT_FIXED:
+		writer->used += FixedLine( result, writer->digits, line );
+		writer->buffer[ writer->used++ ] = '\n';
+		break;
+	default:
+		writer->used += FormatDouble( result, line, SHORTEST_WIDTH );
+		writer->buffer[ writer->used++ ] = '\n';
+	}
+	writer->n_results ++;
+	return 0;
+} // ResultWrite
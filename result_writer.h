@@ -0,0 +1,84 @@
+/*! \file result_writer.h
+ * Fast output of many results on the host, for batch runs of
+ * CalculateAnswer() (see test_calculator.c).
+ *
+ * printf( "%g\n" ) per result parses its format string, goes through the
+ * stdio locks and buffers, and converts the double the slow way, so
+ * printing a result costs more than calculating it. A ResultWriter instead
+ * formats each result straight into one large buffer, with the same
+ * formatter the calculator uses for its display (\a format_double), and
+ * passes the buffer to write() only when it is full. A run of millions of
+ * results makes only a few hundred system calls, and no stdio calls.
+ *
+ * There are three formats, one result per line except for binary:
+ * 	| Format		| Example	| Reads back exactly	|
+ * 	| :--			| :--		| :--:			|
+ * 	| RESULT_SHORTEST	| 0.1, 1.5E-7	| Yes			|
+ * 	| RESULT_FIXED (6)	| 1.00000E-1	| If 17 digits		|
+ * 	| RESULT_BINARY		| 8 raw bytes	| Yes			|
+ * RESULT_SHORTEST gives the shortest digits which read back (e.g. with
+ * strtod()) as the same double. RESULT_FIXED gives a fixed number of
+ * significant digits, correctly rounded, in E notation with a signed
+ * exponent of at least two digits (as printf's "%.*E" does), so that
+ * columns line up. RESULT_BINARY writes each double's 8 bytes in the
+ * host's byte order, for another program to read.
+ *
+ * This is for the host only: it uses write() from POSIX.
+ */
+
+#ifndef RESULT_WRITER_H
+#define RESULT_WRITER_H
+
+#include <stddef.h>
+
+#define RESULT_BUFFER_SIZE	(1 << 20)	// A suitable buffer: 1 MB.
+#define RESULT_MAX_LENGTH	32	// The longest result, with its newline.
+
+/*! How each result is written.
+ */
+typedef enum {
+	RESULT_SHORTEST,	//!< Shortest digits that read back exactly.
+	RESULT_FIXED,		//!< A fixed number of significant digits.
+	RESULT_BINARY		//!< The raw double.
+} ResultFormat;
+
+/*! A writer. The caller owns the storage and the buffer; the fields are
+ * set by ResultWriterOpen() and are private to this module.
+ */
+typedef struct {
+	int	fd;
+	ResultFormat	format;
+	int	digits;			// For RESULT_FIXED.
+	char	*buffer;
+	size_t	size, used;		// Bytes.
+	int	error;			// errno of a failed write(), or 0.
+	unsigned long long	n_results, n_bytes, n_writes;
+} ResultWriter;
+
+/*! Start writing results.
+ *
+ * \param [out] writer The writer.
+ * \param [in] fd The file descriptor to write to, e.g. 1 for standard
+ * 		output. Anything already written with stdio should be
+ * 		fflush()ed first.
+ * \param [in] format How to write each result.
+ * \param [in] digits The significant digits for RESULT_FIXED, 1 to 17.
+ * \param [in] buffer The buffer, e.g. of RESULT_BUFFER_SIZE bytes.
+ * \param [in] size Its size, at least RESULT_MAX_LENGTH bytes.
+ */
+void ResultWriterOpen( ResultWriter *writer, int fd, ResultFormat format,
+		       int digits, char *buffer, size_t size );
+
+/*! Add a result, writing out the buffer first if it might not fit.
+ *
+ * \return 0, or -1 if a write() has failed: see \a error.
+ */
+int ResultWrite( ResultWriter *writer, double result );
+
+/*! Write out whatever is in the buffer.
+ *
+ * \return 0, or -1 if a write() has failed: see \a error.
+ */
+int ResultWriterFlush( ResultWriter *writer );
+
+#endif // of #ifndef RESULT_WRITER_H
@@ -0,0 +1,87 @@
+/* scheduler.c
+ *
+ * Run-to-completion tasks with event queues, dispatched from the
+ * lowest-priority interrupt.
+ *
+ * For documentation, see the corresponding .h file.
+ */
+
+#include "time_source.h"
+#include "scheduler.h"
+#include "trace_events.h"
+
+static void	(* const task[ N_TASKS ])( unsigned char signal ) = {
+	KeypadTask, FlashTask, DisplayTask	// In the order of TaskId.
+};
+
+static struct {
+	unsigned char	signal[ SCHEDULER_QUEUE_SIZE ];
+	volatile unsigned char	head, tail;	// Fill at head, take at tail.
+} queue[ N_TASKS ];
+
+static volatile int	running = 0;	// SchedulerRun() is dispatching.
+static SchedulerStats	stats;
+
+void SchedulerInit( void )
+{
+	int	i;
+
+	for (i = 0; i < N_TASKS; i++)
+		queue[i].head = queue[i].tail = 0;
+	running = 0;
+	stats = (SchedulerStats){ { 0 }, 0, 0 };
+} // SchedulerInit
+
+int SchedulerPost( TaskId id, unsigned char signal )
+{
+	long	sr = StartCritical(); // Posted from interrupts of any priority.
+	unsigned char	head = queue[id].head, next = (head + 1) & (SCHEDULER_QUEUE_SIZE - 1);
+	unsigned char	queued = (head - queue[id].tail + 1) & (SCHEDULER_QUEUE_SIZE - 1);
+
+	if (next == queue[id].tail) {
+		stats.dropped ++;
+		EndCritical( sr );
+		return 0;
+	}
+	queue[id].signal[ head ] = signal;
+	queue[id].head = next;
+	if (queued > stats.max_queued)
+		stats.max_queued = queued;
+	EndCritical( sr );
+	PendScheduler();
+	return 1;
+} // SchedulerPost
+
+void SchedulerRun( void )
+{
+	int	id;
+
+	if (running)
+		return; // Its caller picks the new events up.
+	running = 1;
+	for (id = 0; id < N_TASKS; ) {
+		unsigned char	tail = queue[id].tail, signal;
+
+		if (tail == queue[id].head) {
+			id++; // Nothing for this task: try the next.
+			continue;
+		}
+		signal = queue[id].signal[ tail ];
+		queue[id].tail = (tail + 1) & (SCHEDULER_QUEUE_SIZE - 1); // Only taken here.
+		stats.events[id] ++;
+		TraceSetTrack( TRACE_TRACK_TASK + id );
+		TraceBeginOn( TRACE_TRACK_TASK + id, "Event", signal );
+		task[id]( signal );
+		TraceEndOn( TRACE_TRACK_TASK + id, "Event" );
+		id = 0; // It may have posted to a higher priority.
+	}
+	TraceSetTrack( TRACE_TRACK_MAIN );
+	running = 0;
+} // SchedulerRun
+
+void SchedulerGetStats( SchedulerStats *stats_out )
+{
+	long	sr = StartCritical();
+	*stats_out = stats;
+	EndCritical( sr );
+} // SchedulerGetStats
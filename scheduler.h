@@ -0,0 +1,100 @@
+/*! \file scheduler.h
+ * A small run-to-completion scheduler: tasks which handle events from
+ * their own queues, so that the LCD, the flash and the keypad each get on
+ * with their work without anything waiting for them.
+ *
+ * A task is a state machine: a function which is given one event, does
+ * what that event calls for without waiting, and returns. Anything which
+ * takes time (an LCD instruction, a flash operation, the next keypad
+ * sample) is started, and ends in another event: a software timer or an
+ * interrupt handler posts it with SchedulerPost(). The tasks are fixed at
+ * compile time, in priority order:
+ *
+ * 	| Task		| Events				| Module	|
+ * 	| :--		| :--					| :--		|
+ * 	| Keypad	| Row edge, sample timer		| \a key_events	|
+ * 	| Flash		| Append started, flash done		| \a flash_log	|
+ * 	| Display	| Bytes queued, LCD ready		| \a display_task	|
+ *
+ * The tasks run from the lowest-priority interrupt: PendSV on the Tiva,
+ * which SchedulerPost() pends, so they run as soon as no other interrupt
+ * is being handled. On the host the virtual clock emulates it
+ * (VirtualClockPendInterrupt()). SchedulerRun() takes the events in turn,
+ * from the highest-priority task with one queued, until none is left.
+ * Tasks do not preempt one another, so they share data without critical
+ * sections; each must return quickly, as the others wait until it does.
+ *
+ * The calculation is the main program itself: main() is unchanged, and is
+ * preempted by the tasks. Its calls which used to wait for the hardware
+ * now hand the work to a task and return: PrintChar() and the other
+ * display functions queue their bytes for the display task, and
+ * WriteDoubleToFlash() leaves the record to the flash task. It waits only
+ * for keys, asleep in TimeIdle(), and if the display's queue is full.
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#define SCHEDULER_QUEUE_SIZE	8	/* Events a task can have queued.
+				 * Must be a power of two; one slot is kept
+				 * empty to tell full from empty. */
+
+/*! The tasks, highest priority first.
+ */
+typedef enum {
+	TASK_KEYPAD,	//!< Keypad sampling and debouncing.
+	TASK_FLASH,	//!< Flash log records.
+	TASK_DISPLAY,	//!< The LCD's instructions and data.
+	N_TASKS
+} TaskId;
+
+/*! Forget every queued event. Called by InitAllOther(), before anything
+ * can post one.
+ */
+void SchedulerInit( void );
+
+/*! Queue an event for a task, and pend the scheduler's interrupt.
+ *
+ * \param [in] task The task.
+ * \param [in] signal What has happened; its meaning is up to the task.
+ * \return 1, or 0 if the task's queue was full and the event was lost.
+ *
+ * This may be called from anywhere: interrupt handlers, tasks or the main
+ * program.
+ */
+int SchedulerPost( TaskId task, unsigned char signal );
+
+/*! Dispatch queued events until there are none.
+ *
+ * This is the body of the scheduler's interrupt handler. If it is called
+ * while it is already running (e.g. by an interrupt taken during a task),
+ * it returns at once, and the events are dispatched by the first call.
+ */
+void SchedulerRun( void );
+
+/*! Dispatching statistics, since SchedulerInit().
+ */
+typedef struct {
+	unsigned long	events[ N_TASKS ];	//!< Events handled by each task.
+	unsigned long	dropped;	//!< Events lost to full queues.
+	unsigned char	max_queued;	//!< The most events queued for one task.
+} SchedulerStats;
+
+/*! Get the dispatching statistics.
+ */
+void SchedulerGetStats( SchedulerStats *stats );
+
+/*! The task functions, one per TaskId, each in its own module.
+ */
+void KeypadTask( unsigned char signal );
+void FlashTask( unsigned char signal );	//!< \copydoc KeypadTask
+void DisplayTask( unsigned char signal );	//!< \copydoc KeypadTask
+
+/*! Pend the scheduler's interrupt, so that SchedulerRun() is called once
+ * no other interrupt is being handled (at once from the main program). In
+ * the HAL (see hal.h): on the Tiva it sets PendSV pending, on the host it
+ * calls VirtualClockPendInterrupt().
+ */
+void PendScheduler( void );
+
+#endif // of #ifndef SCHEDULER_H
@@ -0,0 +1,89 @@
+/* soft_float.c
+ *
+ * The counts of double-precision operations, and the table which turns
+ * them into estimated Tiva cycles.
+ *
+ * For documentation, see the corresponding .h file.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "soft_float.h"
+
+#define CLOCKS_PER_MICROSEC	80	// 80 MHz system clock, see PLL_Init().
+
+unsigned long	soft_float_counts[ SOFT_OPS ];
+unsigned long	soft_float_expressions = 0;
+
+static const char	*const names[ SOFT_OPS ] = {
+	"add", "sub", "mul", "div", "convert", "compare", "pow", "sscanf"
+};
+
+/* Cycles each on a Cortex-M4 without double precision: rough figures for
+ * the compiler's library routines, until measured. */
+static unsigned long	cycles[ SOFT_OPS ] = {
+	60, 60, 70, 180, 30, 25, 2500, 6000
+};
+
+void SoftFloatReset( void )
+{
+	memset( soft_float_counts, 0, sizeof soft_float_counts );
+	soft_float_expressions = 0;
+} // SoftFloatReset
+
+int SoftFloatSetCosts( const char *text )
+{
+	char	name[16];
+	unsigned long	value;
+	int	n, op;
+
+	while (sscanf( text, " %15s%n", name, &n ) == 1) {
+		text += n;
+		for (op = 0; op < SOFT_OPS && strcmp( name, names[op] ) != 0; op++)
+			;
+		if (op == SOFT_OPS || sscanf( text, " %lu%n", &value, &n ) != 1)
+			return 0;
+		text += n;
+		cycles[op] = value;
+	}
+	return 1;
+} // SoftFloatSetCosts
+
+unsigned long long SoftFloatCycles( void )
+{
+	unsigned long long	total = 0;
+	int	op;
+
+	for (op = 0; op < SOFT_OPS; op++)
+		total += (unsigned long long)soft_float_counts[op] * cycles[op];
+	return total;
+} // SoftFloatCycles
+
+unsigned long SoftFloatReport( char *text, unsigned long size )
+{
+	char	line[ 128 ];
+	unsigned long	length = 0, n, per = soft_float_expressions ? soft_float_expressions : 1;
+	unsigned long long	total = SoftFloatCycles();
+	int	op;
+
+	if (size == 0)
+		return 0;
+	text[0] = '\0';
+	for (op = -1; op <= SOFT_OPS; op++) {
+		if (op < 0)
+			n = sprintf( line, "\t%-10s%10s%10s%10s%12s\n", "", "count",
+				     "per expr.", "cycles", "per expr." );
+		else if (op < SOFT_OPS)
+			n = sprintf( line, "\t%-10s%10lu%10.1f%10lu%12.0f\n", names[op],
+				     soft_float_counts[op], (double)soft_float_counts[op] / per,
+				     cycles[op], (double)soft_float_counts[op] * cycles[op] / per );
+		else	n = sprintf( line, "\t%lu expressions: %.0f cycles, %.0f us at 80 MHz, each\n",
+				     soft_float_expressions, (double)total / per,
+				     (double)total / per / CLOCKS_PER_MICROSEC );
+		if (length + n < size) { // Room for the null too.
+			memcpy( text + length, line, n + 1 );
+			length += n;
+		}
+	}
+	return length;
+} // SoftFloatReport
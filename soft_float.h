@@ -0,0 +1,101 @@
+/*! \file soft_float.h
+ * Counts of the double-precision operations the calculation does, to
+ * estimate what it costs on the Tiva from a host run.
+ *
+ * The TM4C123's FPU does single precision only, so on the Tiva every
+ * double add, multiply, compare or conversion is a call into the
+ * compiler's floating-point library, tens to hundreds of cycles, and pow()
+ * and sscanf() thousands. The host does them in hardware, so its timings
+ * hide this, and the simulator does not time computation at all.
+ *
+ * The double arithmetic of the calculation (CalculateAnswer(): chiefly
+ * ExtractNumber() and MergeNumbers()) and of the display of its result
+ * (FormatDouble(), from DisplayResult()) is written with the macros
+ * below. Built with -DSOFT_FLOAT_COUNT (and soft_float.c), each also
+ * counts its operation; otherwise each is just the operation, and costs
+ * nothing extra. The counts are turned into estimated Tiva cycles with a
+ * table of cycles per operation. The defaults are rough figures for a
+ * Cortex-M4 without a double-precision FPU; measure them on the board
+ * (e.g. with the DWT cycle counter) and give them to SoftFloatSetCosts().
+ *
+ * With -DSOFT_FLOAT_COUNT, test_host_sim reports the estimate after each
+ * test of its automatic run, test_calculator after each expression of its
+ * automatic test, and bench_latency after each script, per expression
+ * calculated.
+ */
+
+#ifndef SOFT_FLOAT_H
+#define SOFT_FLOAT_H
+
+/*! What is counted.
+ */
+typedef enum {
+	SOFT_ADD,	//!< Double addition,
+	SOFT_SUB,	//!< subtraction,
+	SOFT_MUL,	//!< multiplication
+	SOFT_DIV,	//!< and division.
+	SOFT_CONVERT,	//!< Double to or from an integer.
+	SOFT_COMPARE,	//!< Double comparison.
+	SOFT_POW,	//!< pow() calls.
+	SOFT_SSCANF,	//!< sscanf() calls, reading a double.
+	SOFT_OPS
+} SoftFloatOp;
+
+/*! The counts, by SoftFloatOp, since SoftFloatReset().
+ */
+extern unsigned long	soft_float_counts[ SOFT_OPS ];
+
+/*! CalculateAnswer() calls since SoftFloatReset().
+ */
+extern unsigned long	soft_float_expressions;
+
+#ifdef SOFT_FLOAT_COUNT
+#define SoftFloatCount( op )	(soft_float_counts[ op ]++)
+#define SoftFloatExpression()	(soft_float_expressions++)
+#else
+#define SoftFloatCount( op )	((void)0)
+#define SoftFloatExpression()	((void)0)
+#endif
+
+/*! The operations, counted. Each argument is evaluated once.
+ */
+#define DAdd( a, b )		(SoftFloatCount( SOFT_ADD ), (a) + (b))
+#define DSub( a, b )		(SoftFloatCount( SOFT_SUB ), (a) - (b))
+#define DMul( a, b )		(SoftFloatCount( SOFT_MUL ), (a) * (b))
+#define DDiv( a, b )		(SoftFloatCount( SOFT_DIV ), (a) / (b))
+#define DLess( a, b )		(SoftFloatCount( SOFT_COMPARE ), (a) < (b))
+#define DEqual( a, b )		(SoftFloatCount( SOFT_COMPARE ), (a) == (b))
+#define DConvert( type, x )	(SoftFloatCount( SOFT_CONVERT ), (type)(x))
+#define DPow( a, b )		(SoftFloatCount( SOFT_POW ), pow( a, b ))
+
+/*! Zero the counts.
+ */
+void SoftFloatReset( void );
+
+/*! Set the cycles of some operations.
+ *
+ * \param [in] text Pairs of a name and cycles, separated by white space,
+ * 		e.g. "add 60 div 180". The names are those of
+ * 		SoftFloatReport(): add, sub, mul, div, convert, compare, pow and
+ * 		sscanf.
+ * \return 1, or 0 if a name or a number was not understood; those before
+ * 		it are set.
+ */
+int SoftFloatSetCosts( const char *text );
+
+/*! The estimated Tiva cycles of the operations counted.
+ */
+unsigned long long SoftFloatCycles( void );
+
+/*! Write the counts as text, a line for each operation: its name, count,
+ * count per expression, cycles each and estimated cycles per expression,
+ * then the total.
+ *
+ * \param [out] text Where to write it: 80 characters a line is enough.
+ * \param [in] size The size of \a text. Lines which do not fit are left
+ * 		out.
+ * \return The length written, without the terminating null.
+ */
+unsigned long SoftFloatReport( char *text, unsigned long size );
+
+#endif // of #ifndef SOFT_FLOAT_H
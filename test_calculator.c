@@ -4,18 +4,25 @@
  */
 
 #define PROG_NAME_VER		"test_calculator v1.1 (2019nov05)"
+#ifndef INPUT_BUFFER_SIZE	// May be set for the whole build, as for main.c.
 #define INPUT_BUFFER_SIZE	17
+#endif
 #define AUTO_TEST_RESULTS_LEVEL	3	/* 0: Nothing (silly)
 					 * 1: Just totals of tests and successes
 					 * 2: Nature and result of each test
 					 */
 #define AUTO_TEST_ERROR_MARGIN	1.00001	/* To pass, the result must be no different 
 					 * (as a ratio) than this from the correct value. */
+#define BATCH_FIXED_DIGITS	10	// Significant digits in batch format f.
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include "calculate_answer.h"
+#include "result_writer.h"
+#include "metrics.h"
+#include "soft_float.h"
 
 
 void ReadAndEchoInput( char *input_buffer, int input_buffer_size )
@@ -74,14 +81,20 @@ void AutomaticTest_Correct_One( const char *input, double correct_ans,
 char	spaces[50] = "                        "; // Used to tab.
 double	actual_ans;
 int	error_ref_no, passed;
+#ifdef SOFT_FLOAT_COUNT
+char	report[ 1024 ];
+#endif
 	
 	// Parameter correctness check:
-	if (strnlen( input, 17 ) >= 17) {
+	if (strnlen( input, INPUT_BUFFER_SIZE ) >= INPUT_BUFFER_SIZE) {
 		printf( "\tERROR: input \"%s\" is too long (%d chars)\n", 
-			input, (int)strnlen( input, 17 ) );
+			input, (int)strnlen( input, INPUT_BUFFER_SIZE ) );
 		return;
 	}
 
+#ifdef SOFT_FLOAT_COUNT
+	SoftFloatReset();
+#endif
 	actual_ans = CalculateAnswer( (char*)input, 
 				INPUT_BUFFER_SIZE,  &error_ref_no ); /* In 
 							calculate_answer. */
@@ -101,14 +114,22 @@ int	error_ref_no, passed;
 	
 	if (AUTO_TEST_RESULTS_LEVEL >= 1)
 		printf( "\t\"%s\"%sshould give %g,\tgave %g,\t%s\n", 
-			input, &(spaces[ strlen( input ) ]), 
+			input, &(spaces[ (strlen( input ) < 24) ? strlen( input ) : 24 ]), 
 			correct_ans, actual_ans, 
 	  		passed ? "passed" : "failed" );
+#ifdef SOFT_FLOAT_COUNT
+	/* The double operations of the calculation, and their estimated Tiva 
+	 * cycles (see soft_float.h). */
+	SoftFloatReport( report, sizeof report );
+	printf( "%s", report );
+#endif
 } // AutomaticTest_Correct_One
 
 void AutomaticTest_Correct( void )
 {
-int	n_tested = 0, n_passed = 0;
+int	n_tested = 0, n_passed = 0, i;
+char	full_sum[ INPUT_BUFFER_SIZE ];	// "1+1+...+1", as long as fits.
+char	long_number[ INPUT_BUFFER_SIZE ];	// "00...01.5", likewise.
 
 	if (AUTO_TEST_RESULTS_LEVEL >= 1)
 		printf( "Error margin = %g\n", AUTO_TEST_ERROR_MARGIN );
@@ -124,6 +145,17 @@ int	n_tested = 0, n_passed = 0;
 	AutomaticTest_Correct_One( "1+2x10",		21,	&n_tested, &n_passed );
 	AutomaticTest_Correct_One( "1.2E3/3x1.25+9-4",	505,	&n_tested, &n_passed );
 	AutomaticTest_Correct_One( "0-4+9x6/4E-2",	-1354,	&n_tested, &n_passed );
+	// As many numbers as the buffer holds (more with -DINPUT_BUFFER_SIZE=81):
+	for (i=0; i < INPUT_BUFFER_SIZE/2; i++) {
+		full_sum[ 2*i ] = '1';
+		full_sum[ 2*i + 1 ] = '+';
+	}
+	full_sum[ 2*i - 1 ] = '\0';
+	AutomaticTest_Correct_One( full_sum, INPUT_BUFFER_SIZE/2, &n_tested, &n_passed );
+	// A number as long as the buffer holds:
+	memset( long_number, '0', INPUT_BUFFER_SIZE - 4 );
+	strcpy( &(long_number[ INPUT_BUFFER_SIZE - 4 ]), "1.5" );
+	AutomaticTest_Correct_One( long_number, 1.5, &n_tested, &n_passed );
 
 /*
 	AutomaticTest_Correct_One( "",		,	&n_tested, &n_passed );
@@ -133,13 +165,102 @@ int	n_tested = 0, n_passed = 0;
 			n_passed, n_tested );
 } // AutomaticTest_Correct
 
+char *PutNumber( char *text, unsigned long number )
+// Write number in decimal at text: the end of it.
+{
+char	reversed[12];
+int	n = 0;
+
+	do {
+		reversed[ n++ ] = '0' + (char)(number % 10);
+		number /= 10;
+	} while (number);
+	while (n)
+		*text++ = reversed[ --n ];
+	return text;
+} // PutNumber
+
+void BatchExpression( unsigned long long i, char *input )
+/* The i'th of a varied series of expressions, such as "4711/93", built
+ * without stdio so that it costs little next to the calculation. */
+{
+char	*end = input;
+
+	end = PutNumber( end, (unsigned long)(i % 99991) );
+	switch (i % 4) {
+	case 0:	*end++ = '/';
+		end = PutNumber( end, (unsigned long)(i % 997 + 1) );
+		break;
+	case 1:	*end++ = '.';
+		end = PutNumber( end, (unsigned long)(i % 1000) );
+		*end++ = 'x';
+		end = PutNumber( end, (unsigned long)(i % 77) );
+		break;
+	case 2:	*end++ = 'E';
+		*end++ = '-';
+		end = PutNumber( end, (unsigned long)(i % 9) );
+		*end++ = '+';
+		end = PutNumber( end, (unsigned long)(i % 12345) );
+		break;
+	default:
+		*end++ = '-';
+		end = PutNumber( end, (unsigned long)(i % 9999999) );
+	}
+	*end = '\0';
+} // BatchExpression
+
+void BatchTest( unsigned long long n_results, char format )
+/* Calculate n_results expressions and write their answers to standard
+ * output, then report the rate, of results and of the tokens parsed, on
+ * standard error. Format s, f or b uses
+ * a ResultWriter (shortest, fixed or binary); p uses printf( "%g\n" ),
+ * for comparison; n writes nothing, to time the calculation alone. */
+{
+static char	buffer[ RESULT_BUFFER_SIZE ];
+ResultWriter	writer;
+char	input_buffer[ INPUT_BUFFER_SIZE ];
+int	error_ref_no;
+double	answer, seconds;
+unsigned long long	i;
+clock_t	start;
+
+	fflush( stdout );
+	MetricsReset();
+	ResultWriterOpen( &writer, 1, (format == 'b') ? RESULT_BINARY
+			  : (format == 'f') ? RESULT_FIXED : RESULT_SHORTEST,
+			  BATCH_FIXED_DIGITS, buffer, sizeof buffer );
+	start = clock();
+	for (i = 0; i < n_results; i++) {
+		BatchExpression( i, input_buffer );
+		answer = CalculateAnswer( input_buffer, INPUT_BUFFER_SIZE, &error_ref_no );
+		if (format == 'p')
+			printf( "%g\n", answer );
+		else if (format != 'n' && ResultWrite( &writer, answer ) != 0)
+			break;
+	}
+	if (format == 'p')
+		fflush( stdout );
+	else	ResultWriterFlush( &writer );
+	seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+	if (writer.error)
+		fprintf( stderr, "Writing failed: %s\n", strerror( writer.error ) );
+	fprintf( stderr, "%llu results in format %c: %.2f s, %.3g results/s, "
+		 "%lu tokens, %.3g tokens/s, %llu bytes in %llu write() calls\n",
+		 i, format, seconds, seconds > 0 ? i / seconds : 0.0,
+		 metrics[ METRIC_TOKENS ],
+		 seconds > 0 ? metrics[ METRIC_TOKENS ] / seconds : 0.0,
+		 writer.n_bytes, writer.n_writes );
+} // BatchTest
+
 int main( int argc, char* argv[] )
 {
 int	args_ok = 1;
 				 
-	printf( "\n%s\n", PROG_NAME_VER );
-	puts( "Testing the CalculateAnswer() function." );
-	if (argc != 2) 
+	if (argc < 2 || (argv[1][0] != 'b' && argv[1][0] != 'B')) {  // Batch output is only answers
+		printf( "\n%s\n", PROG_NAME_VER );
+		puts( "Testing the CalculateAnswer() function." );
+	}
+	if (argc < 2) 
 		ManualTest();
 /*		args_ok = 0;*/
 	else	switch (argv[1][0]) {
@@ -150,12 +271,19 @@ int	args_ok = 1;
 			case 'A':	AutomaticTest_Correct();
 					//AutomaticTest_Error();
 					break;
+			case 'b':	argv[1][0] = 'B'; // Render UC and carry on.
+					/* fall through */
+			case 'B':	BatchTest( (argc > 2) ? strtoull( argv[2], NULL, 10 ) : 1000000,
+						   (argc > 3) ? argv[3][0] : 's' );
+					break;
 			default:	args_ok = 0;
 		} // switch
 	if (! args_ok) {
 		puts( "FATAL: usage is test_calculator [<mode>]" );
 		puts( "where <mode> is\tA or a for Automatic (set of pre-chosen tests)" );
-		puts( "or\t\tM or m for Manual (enter your own input string)\n" );
+		puts( "or\t\tM or m for Manual (enter your own input string)" );
+		puts( "or\t\tB or b [<n> [s|f|b|p|n]] for Batch: n answers to standard" );
+		puts( "\t\toutput, shortest, fixed, binary, printf or none\n" );
 		puts( "If <mode> is absent, a manual test will be performed." );
 		exit( EXIT_FAILURE );
 	}
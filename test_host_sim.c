@@ -0,0 +1,1438 @@
+/* test_host_sim.c
+ *
+ * Regression tests of the display and keyboard layers, run on a host
+ * (Linux/PC) against the simulated LCD and keypad in \a host_sim.
+ *
+ * Build with
+ * 	gcc -std=c99 -o test_host_sim test_host_sim.c host_sim.c
+ * 		virtual_clock.c time_source.c key_events.c crc.c flash_log.c
+ * 		answer_store.c boot_timeline.c ui_snapshot.c format_double.c
+ * 		input_editor.c scheduler.c display_task.c key_trace.c Welcome.c
+ * 		low_level_funcs_tiva.c hal_host.c mid_level_funcs.c
+ * 		high_level_funcs.c calculate_answer.c metrics.c trace_events.c
+ * 		profiler.c profiler_host.c -lm
+ * and run "test_host_sim a". The exit status is non-zero if any test fails.
+ * Add -DSOFT_FLOAT_COUNT and soft_float.c for the estimated soft-float cost
+ * of each test's calculations.
+ * "test_host_sim r file" replays a key trace (see \a key_trace) instead.
+ */
+
+#define PROG_NAME_VER		"test_host_sim v1.0"
+#define INPUT_BUFFER_SIZE	17
+#define KEY_HOLD_US		50000	// A quick but realistic key press.
+#define KEY_GAP_US		50000	// Ten keys a second: a fast typist.
+#define KEY_BOUNCE_US		3000	// Within the default debounce window.
+#define SESSION_EXPRESSIONS	1000	// Of 5 keys each, for the long session.
+#define TASK_EXPRESSIONS	200	// Each way, for the scheduler's session.
+#define FORMAT_CHECK_VALUES	100000	// Answers checked against strtod().
+#define FORMAT_BENCH_VALUES	1000000	// Answers timed.
+#define SNAPSHOT_WEAR_WRITES	10240	// Snapshots, for the wear of their log.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <time.h>
+#include <math.h>
+#include "host_sim.h"
+#include "time_source.h"
+#include "key_events.h"
+#include "flash_log.h"
+#include "answer_store.h"
+#include "boot_timeline.h"
+#include "ui_snapshot.h"
+#include "input_editor.h"
+#include "format_double.h"
+#include "scheduler.h"
+#include "display_task.h"
+#include "key_trace.h"
+#include "profiler.h"
+#include "metrics.h"
+#include "trace_events.h"
+#include "soft_float.h"
+#include "Welcome.h"
+#include "low_level_funcs_tiva.h"
+#include "mid_level_funcs.h"
+#include "high_level_funcs.h"
+#include "calculate_answer.h"
+
+static int	n_tested = 0, n_passed = 0;
+static jmp_buf	idle_jump;
+static char	timer_order[8];
+static unsigned long long	timer_fired_at[8];
+static int	n_timers_fired;
+static SoftTimer	timer_a, timer_b, timer_c;
+
+void Check( const char *what, int passed )
+{
+	n_tested ++;
+	if (passed) n_passed ++;
+	printf( "\t%-44s%s\n", what, passed ? "passed" : "FAILED" );
+} // Check
+
+void CheckLine( const char *what, short int line, const char *expected )
+/* Compare a display line, once the display task has sent everything
+ * queued, with the expected text, which is padded with spaces to the full
+ * 16 characters. */
+{
+char	actual[17], padded[17];
+	DisplayFlush();
+	SimLCDGetLine( line, actual );
+	snprintf( padded, sizeof padded, "%-16s", expected );
+	Check( what, strcmp( actual, padded ) == 0 );
+	if (strcmp( actual, padded ) != 0)
+		printf( "\t\tline %d is \"%s\", expected \"%s\"\n",
+			line, actual, padded );
+} // CheckLine
+
+void IdleJump( void )
+{
+	longjmp( idle_jump, 1 );
+} // IdleJump
+
+void PowerUp( void )
+// Fresh simulated hardware, initialised as main() would.
+{
+	SimReset();
+	SimSetIdleHandler( IdleJump );
+	InitAllHardware();
+} // PowerUp
+
+void TypeAndReadSize( const char *keys, char *input_buffer, int input_buffer_size )
+{
+	SimKeypadType( keys, KEY_GAP_US, KEY_HOLD_US );
+	ReadAndEchoInput( input_buffer, input_buffer_size );
+} // TypeAndReadSize
+
+void TypeAndRead( const char *keys, char *input_buffer )
+{
+	TypeAndReadSize( keys, input_buffer, INPUT_BUFFER_SIZE );
+} // TypeAndRead
+
+void TimerFired( char name )
+{
+	timer_fired_at[ n_timers_fired ] = TimeNowMicrosec();
+	timer_order[ n_timers_fired++ ] = name;
+	timer_order[ n_timers_fired ] = '\0';
+} // TimerFired
+
+void TimerAFired( void ) { TimerFired( 'a' ); }
+void TimerBFired( void ) { TimerFired( 'b' ); TimerStart( &timer_b, 250, TimerBFired ); }
+void TimerCFired( void ) { TimerFired( 'c' ); }
+
+void TestVirtualClock( void )
+{
+unsigned long long	start_us;
+TimeDelayError	delay_errors[ TIME_SELF_TEST_DELAYS ];
+
+	puts( "Virtual clock:" );
+	PowerUp();
+	start_us = TimeNowMicrosec();
+	WaitMicrosec( 3000000 );
+	Check( "WaitMicrosec() advances simulated time",
+		TimeNowMicrosec() - start_us == 3000000 );
+
+	n_timers_fired = 0;
+	TimerStart( &timer_a, 300, TimerAFired );
+	TimerStart( &timer_b, 100, TimerBFired ); // Restarts itself every 250 us.
+	TimerStart( &timer_c, 200, TimerCFired );
+	TimerStop( &timer_c );
+	TimerStart( &timer_c, 200, TimerCFired );
+	WaitMicrosec( 300 );
+	Check( "Timers fire in deadline order", strcmp( timer_order, "bca" ) == 0 );
+	Check( "Timers see their own deadline",
+		timer_fired_at[0] == start_us + 3000100
+		&& timer_fired_at[2] == start_us + 3000300 );
+	WaitMicrosec( 50 );
+	Check( "A timer may restart itself", strcmp( timer_order, "bcab" ) == 0 );
+	TimerStop( &timer_b );
+	Check( "TimerStop() stops a timer", ! TimerIsActive( &timer_b ) );
+
+	start_us = TimeNowMicrosec();
+	TimeWaitUntilMicrosec( start_us + 1234 );
+	TimeWaitUntilMicrosec( start_us + 1000 );
+	Check( "Deadline wait, not before the deadline",
+		TimeNowMicrosec() == start_us + 1234 );
+	Check( "Delay self-test exact on the virtual clock",
+		TimeDelaySelfTest( delay_errors ) == 0
+		&& delay_errors[ TIME_SELF_TEST_DELAYS-1 ].delay_us == 1000000 );
+} // TestVirtualClock
+
+void TestDisplay( void )
+{
+SimStats	stats;
+short int	line, char_pos;
+
+	puts( "Display:" );
+	PowerUp();
+	SimGetStats( &stats );
+	Check( "InitLCD() meets the LCD timing", stats.timing_violations == 0 );
+	Check( "Display on with cursor after InitLCD()",
+		SimLCDDisplayOn() && SimLCDGetCursor( &line, &char_pos ) );
+
+	PrintString( 1, 1, "Hello" );
+	CheckLine( "PrintString() on line 1", 1, "Hello" );
+	PrintString( 2, 14, "abcdefgh" );
+	CheckLine( "PrintString() stops at end of line", 2, "             abc" );
+	ClearDisplay();
+	CheckLine( "ClearDisplay() blanks line 1", 1, "" );
+	CheckLine( "ClearDisplay() blanks line 2", 2, "" );
+
+	SimResetStats();
+	PrintChar( 'x' );
+	SimGetStats( &stats );
+	Check( "PrintChar() returns once queued", stats.elapsed_us <= 1 );
+	DisplayFlush();
+	SimGetStats( &stats );
+	Check( "PrintChar() is 8 pin writes, 2 nibbles",
+		stats.lcd_pin_writes == 8 && stats.lcd_nibbles == 2
+		&& stats.lcd_data_writes == 1 );
+	Check( "and takes the LCD 502 us", stats.elapsed_us == 502 );
+
+	SimResetStats();
+	SimWriteLCD_EN( 0x04 );
+	SimWriteLCD_EN( 0x00 );
+	SimGetStats( &stats );
+	Check( "Short EN pulse is a timing violation",
+		stats.timing_violations == 1 );
+} // TestDisplay
+
+void TestKeyboard( void )
+{
+char	input_buffer[INPUT_BUFFER_SIZE];
+SimStats	stats;
+TimeIdleStats	idle;
+
+	puts( "Keyboard:" );
+	PowerUp();
+	SimKeypadPress( '5' );
+	Check( "GetKeyboardChar() reads a held key", GetKeyboardChar() == '5' );
+	SimKeypadRelease( '5' );
+
+	TypeAndRead( "12A3*", input_buffer );
+	Check( "Digits and + read", strcmp( input_buffer, "12+3" ) == 0 );
+	CheckLine( "Input echoed", 1, "12+3" );
+	TypeAndRead( "1DA4DB6DC2*", input_buffer );
+	Check( "Shift goes off after a character", strcmp( input_buffer, "1x4/6E2" ) == 0 );
+	SimResetStats();
+	TypeAndRead( "12#3*", input_buffer );
+	Check( "Rubout removes the last character",
+		strcmp( input_buffer, "13" ) == 0 );
+	CheckLine( "Rubout is echoed", 1, "13" );
+	SimGetStats( &stats );
+	TimeGetIdleStats( &idle );
+	Check( "Keypad sampled only while keys are down",
+		stats.key_interrupts == 5 && idle.asleep_us > 0
+		&& stats.key_row_reads <= 5 * 5
+			* ((KEY_HOLD_US + KEY_DEBOUNCE_US) / KEY_SAMPLE_US + 2) );
+
+	if (setjmp( idle_jump ) == 0) {
+		GetKeyboardChar();
+		Check( "Idle handler ends a finished script", 0 );
+	} else	Check( "Idle handler ends a finished script", 1 );
+	SimGetStats( &stats );
+	Check( "Keypad scans are counted",
+		stats.key_col_writes > 0 && stats.key_row_reads > 0 );
+} // TestKeyboard
+
+void TestDebounce( void )
+{
+char	input_buffer[INPUT_BUFFER_SIZE];
+KeyEvent	event;
+unsigned long long	press_us;
+int	n_repeats = 0;
+
+	puts( "Debouncing:" );
+	PowerUp();
+	press_us = TimeNowMicrosec() + 1000;
+	SimKeypadScript( '5', press_us, 30000 );
+	WaitMicrosec( 50000 );
+	Check( "Press event, timestamped",
+		KeyEventPop( &event ) && event.type == KEY_PRESS
+		&& event.row == 1 && event.col == 1
+		&& event.time_us >= press_us && event.time_us < press_us + 10 );
+	Check( "Release event, timestamped",
+		KeyEventPop( &event ) && event.type == KEY_RELEASE
+		&& event.time_us >= press_us + 30000
+		&& event.time_us <= press_us + 30000 + KEY_SAMPLE_US );
+	Check( "Nothing else queued", ! KeyEventPop( &event ) );
+
+	SimKeypadSetBounce( KEY_BOUNCE_US );
+	TypeAndRead( "1234567890*", input_buffer );
+	Check( "Bouncing keys at 10 a second all read once",
+		strcmp( input_buffer, "1234567890" ) == 0 );
+	SimKeypadSetBounce( 0 );
+
+	/* Hold Rubout for 0.85 s: one press, then repeats 0.5, 0.6, 0.7
+	 * and 0.8 s after it. */
+	SimKeypadType( "#", KEY_GAP_US, 850000 );
+	while (SimKeypadScriptPending())
+		WaitMicrosec( 10000 );
+	WaitMicrosec( 10000 );
+	while (KeyEventPop( &event ))
+		n_repeats += (event.type == KEY_REPEAT);
+	Check( "Rubout auto-repeats while held", n_repeats == 4 );
+
+	SimKeypadType( "123456", KEY_GAP_US, KEY_HOLD_US );
+	SimKeypadType( "#", KEY_GAP_US, 750000 );
+	SimKeypadType( "*", KEY_GAP_US, KEY_HOLD_US );
+	ReadAndEchoInput( input_buffer, INPUT_BUFFER_SIZE );
+	Check( "Held Rubout deletes repeatedly", strcmp( input_buffer, "12" ) == 0 );
+} // TestDebounce
+
+void TestScanning( void )
+{
+KeyEvent	event;
+KeyScanStats	scan;
+char	pressed[8];
+int	n_pressed = 0;
+
+	puts( "Full-matrix scanning:" );
+	PowerUp();
+	SimKeypadPress( '2' );
+	SimKeypadPress( '5' ); // The same column.
+	WaitMicrosec( 10000 );
+	Check( "Two keys in one column both found", KeyEventsKeyMask() == 0x0022 );
+	SimKeypadPress( '1' ); // 1, 2 and 5 make a ghost 4.
+	WaitMicrosec( 10000 );
+	KeyEventsGetScanStats( &scan );
+	Check( "Ghosting detected", scan.ghost_passes > 0
+		&& scan.last_mask == 0x0033 && KeyEventsKeyMask() == 0x0022 );
+	SimKeypadRelease( '5' );
+	WaitMicrosec( 10000 );
+	Check( "Keys found once the ghost clears", KeyEventsKeyMask() == 0x0003 );
+	SimKeypadRelease( '1' );
+	SimKeypadRelease( '2' );
+	WaitMicrosec( 10000 );
+	while (KeyEventPop( &event ))
+		if (event.type == KEY_PRESS)
+			pressed[ n_pressed++ ] = KeyboardRowCol2Char( event.row, event.col );
+	pressed[ n_pressed ] = '\0';
+	Check( "Each real key pressed once, no ghost", strcmp( pressed, "251" ) == 0 );
+	KeyEventsGetScanStats( &scan );
+	Check( "Pass cost is counted",
+		scan.passes > 0 && scan.port_accesses == scan.passes * KEY_SCAN_ACCESSES
+		&& scan.multi_key_passes > 0 );
+
+	KeyEventsResetScanStats();
+	KeyEventsSetSamplePeriod( 250 );
+	SimKeypadType( "5", KEY_GAP_US, KEY_HOLD_US );
+	while (SimKeypadScriptPending())
+		WaitMicrosec( 10000 );
+	WaitMicrosec( 10000 );
+	KeyEventsGetScanStats( &scan );
+	KeyEventsSetSamplePeriod( KEY_SAMPLE_US );
+	Check( "Sample rate can be raised",
+		scan.passes >= 4 * (KEY_HOLD_US + KEY_DEBOUNCE_US) / KEY_SAMPLE_US );
+	Check( "Press still reported",
+		KeyEventPop( &event ) && event.type == KEY_PRESS
+		&& KeyboardRowCol2Char( event.row, event.col ) == '5' );
+} // TestScanning
+
+void TestIdle( void )
+/* Waiting for keys, the processor should be asleep nearly all the time,
+ * deeply between keys and lightly between samples while a key is down. */
+{
+char	input_buffer[INPUT_BUFFER_SIZE];
+SimStats	stats;
+TimeIdleStats	idle;
+
+	puts( "Tickless idle:" );
+	PowerUp();
+	SimResetStats();
+	SimKeypadType( "12A3*", 1000000, KEY_HOLD_US );
+	ReadAndEchoInput( input_buffer, INPUT_BUFFER_SIZE );
+	SimGetStats( &stats );
+	TimeGetIdleStats( &idle );
+	Check( "Residency adds up", // To the microsecond each is rounded to.
+		idle.asleep_us + idle.awake_us + 1 >= stats.elapsed_us
+		&& idle.asleep_us + idle.awake_us <= stats.elapsed_us + 1 );
+	Check( "Asleep over 90% of the time",
+		idle.asleep_us * 10 > stats.elapsed_us * 9 );
+	Check( "Deep sleep between keys", idle.deep_sleeps >= 5
+		&& idle.deep_asleep_us > 5 * (1000000 - TIME_DEEP_SLEEP_MIN_US) );
+	Check( "Light sleep between samples", idle.sleeps > idle.deep_sleeps );
+	printf( "\t%llu us asleep (%llu us deeply), %llu us awake\n",
+		idle.asleep_us, idle.deep_asleep_us, idle.awake_us );
+} // TestIdle
+
+void TestSession( void )
+/* A long scripted session: it should take a fraction of a second of real
+ * time, yet report the device time it represents. */
+{
+char	input_buffer[INPUT_BUFFER_SIZE];
+SimStats	stats;
+clock_t	start = clock();
+int	i, n_correct = 0;
+
+	printf( "Session of %d key presses:\n", SESSION_EXPRESSIONS * 5 );
+	SimFlashReset(); // No screen left by earlier tests to restore.
+	PowerUp();
+	SimResetStats();
+	for (i=0; i < SESSION_EXPRESSIONS; i++)
+		SimKeypadType( "12A3*", KEY_GAP_US, KEY_HOLD_US );
+	for (i=0; i < SESSION_EXPRESSIONS; i++) {
+		ReadAndEchoInput( input_buffer, INPUT_BUFFER_SIZE );
+		n_correct += strcmp( input_buffer, "12+3" ) == 0;
+	}
+	SimGetStats( &stats );
+	Check( "Every expression read correctly", n_correct == SESSION_EXPRESSIONS );
+	Check( "Every key echoed", stats.key_echoes == SESSION_EXPRESSIONS * 5 );
+	printf( "\t%.0f ms real time for %llu s device time; "
+		"key to echo mean %llu us, max %llu us\n",
+		1000.0 * (clock() - start) / CLOCKS_PER_SEC,
+		stats.elapsed_us / 1000000, stats.key_echo_total_us / stats.key_echoes,
+		stats.key_echo_max_us );
+} // TestSession
+
+void TestCalculation( void )
+{
+char	input_buffer[INPUT_BUFFER_SIZE];
+int	error_ref_no;
+double	answer;
+
+	puts( "Calculation, as main() does it:" );
+	SimFlashReset();
+	PowerUp();
+	TypeAndRead( "12A3*", input_buffer );
+	answer = CalculateAnswer( input_buffer, INPUT_BUFFER_SIZE, &error_ref_no );
+	DisplayResult( answer );
+	CheckLine( "Expression stays on line 1", 1, "12+3" );
+	CheckLine( "Answer on line 2", 2, "15" );
+
+	TypeAndRead( "1AA2*", input_buffer );
+	answer = CalculateAnswer( input_buffer, INPUT_BUFFER_SIZE, &error_ref_no );
+	DisplayErrorMessage( error_message_line1[error_ref_no],
+			     error_message_line2[error_ref_no] );
+	CheckLine( "Error message line 1", 1, error_message_line1[error_ref_no] );
+	CheckLine( "Error message line 2", 2, error_message_line2[error_ref_no] );
+} // TestCalculation
+
+static unsigned long long	random_state = 88172645463325252ULL;
+
+unsigned long long RandomBits( void )
+// xorshift64: repeatable from run to run, unlike rand().
+{
+	random_state ^= random_state << 13;
+	random_state ^= random_state >> 7;
+	random_state ^= random_state << 17;
+	return random_state;
+} // RandomBits
+
+double RandomAnswer( int i )
+/* Alternately any finite double and a quotient of small whole numbers,
+ * as a calculator might give. */
+{
+unsigned long long	bits;
+double	x;
+
+	if (i % 2)
+		return (double)(RandomBits() % 100000) / (double)(RandomBits() % 999 + 1);
+	do {
+		bits = RandomBits();
+		memcpy( &x, &bits, sizeof x );
+	} while (x != x || x - x != 0.0);
+	return x;
+} // RandomAnswer
+
+void TestFormat( void )
+/* Answers should show as the shortest digits which read back as the same
+ * double, fitted to 16 columns, without sprintf(). */
+{
+static const struct { double x; const char *text; } cases[] = {
+	{ 15.0, "15" }, { 0.1, "0.1" }, { 1.0/3, "0.33333333333333" },
+	{ -2.0/3, "-0.6666666666667" }, { 1e15, "1000000000000000" },
+	{ 1e16, "1E16" }, { 2.5e-3, "0.0025" }, { 1.5e-6, "1.5E-6" },
+	{ -0.0, "0" }, { 1.7976931348623157e308, "1.7976931349E308" },
+	{ 5e-324, "5E-324" } };
+char	text[17], digits[ FORMAT_MAX_DIGITS + 1 ], check[40];
+int	i, n, p, exp10, n_laid_out = 0, n_round_trip = 0, n_shortest = 0;
+int	n_fit = 0, n_full = 0;
+double	x, answer;
+static double	answers[ FORMAT_BENCH_VALUES ];
+clock_t	start;
+double	ours_ns, printf_ns, printf17_ns;
+
+	puts( "Formatting answers:" );
+	for (i = 0; i < (int)(sizeof cases / sizeof cases[0]); i++) {
+		FormatDouble( cases[i].x, text, 16 );
+		if (strcmp( text, cases[i].text ) == 0)
+			n_laid_out ++;
+		else	printf( "\t\t%.17g shows as \"%s\", expected \"%s\"\n",
+				cases[i].x, text, cases[i].text );
+	}
+	Check( "Typical answers laid out", n_laid_out == i );
+	PowerUp();
+	DisplayResult( 1.0/3 );
+	CheckLine( "DisplayResult() shows 14 places", 2, "0.33333333333333" );
+
+	for (i = 0; i < FORMAT_CHECK_VALUES; i++) {
+		answer = RandomAnswer( i );
+		x = fabs( answer );
+		n = FormatShortestDigits( x, digits, &exp10 );
+		snprintf( check, sizeof check, "%c.%sE%d", digits[0], digits + 1, exp10 );
+		if (strtod( check, NULL ) == x)
+			n_round_trip ++;
+		for (p = 1; p < n; p++) { // Does printf know a shorter one?
+			snprintf( check, sizeof check, "%.*e", p - 1, x );
+			if (strtod( check, NULL ) == x)
+				break;
+		}
+		if (p == n)
+			n_shortest ++;
+		n = FormatDouble( answer, text, 16 );
+		if (n > 0 && n <= 16 && n == (int)strlen( text ))
+			n_fit ++;
+		if (strtod( text, NULL ) == answer)
+			n_full ++;
+	}
+	Check( "Shortest digits read back exactly", n_round_trip == FORMAT_CHECK_VALUES );
+	Check( "No shorter digits read back", n_shortest == FORMAT_CHECK_VALUES );
+	Check( "Every answer fits 16 columns", n_fit == FORMAT_CHECK_VALUES );
+
+	for (i = 0; i < FORMAT_BENCH_VALUES; i++)
+		answers[i] = RandomAnswer( i );
+	start = clock();
+	for (i = 0; i < FORMAT_BENCH_VALUES; i++)
+		FormatDouble( answers[i], text, 16 );
+	ours_ns = (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / FORMAT_BENCH_VALUES;
+	start = clock();
+	for (i = 0; i < FORMAT_BENCH_VALUES; i++)
+		snprintf( check, sizeof check, "%g", answers[i] );
+	printf_ns = (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / FORMAT_BENCH_VALUES;
+	start = clock();
+	for (i = 0; i < FORMAT_BENCH_VALUES; i++)
+		snprintf( check, sizeof check, "%.17g", answers[i] );
+	printf17_ns = (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / FORMAT_BENCH_VALUES;
+	printf( "\t%d%% of answers shown to full precision; host time per answer: "
+		"FormatDouble() %.0f ns, sprintf %%g %.0f ns, %%.17g %.0f ns\n",
+		n_full * 100 / FORMAT_CHECK_VALUES, ours_ns, printf_ns, printf17_ns );
+} // TestFormat
+
+void TestFlash( void )
+/* The last answer survives power cycles and torn writes, and the log
+ * spreads its erases evenly over its pages. */
+{
+SimStats	stats;
+unsigned long	address, erases, most = 0, least = ~0UL;
+long	i;
+
+	puts( "Flash log of answers:" );
+	SimFlashReset();
+	PowerUp();
+	Check( "Blank flash reads as 0", ReadDoubleFromFlash() == 0.0 );
+	WriteDoubleToFlash( 15.0 );
+	WriteDoubleToFlash( -2.5 );
+	WaitMicrosec( ANSWER_COMMIT_IDLE_US + SIM_FLASH_ERASE_US );
+	SimGetStats( &stats );
+	Check( "Answers in quick succession make one record",
+		stats.flash_words_written == FLASH_LOG_RECORD_WORDS( 8 ) );
+	PowerUp();
+	Check( "Newest answer survives power-up", ReadDoubleFromFlash() == -2.5 );
+
+	for (address = ANSWER_FLASH_ADDRESS;
+	     SimFlashReadWord( address ) != 0xFFFFFFFF; address += FLASH_LOG_SLOT_SIZE( 8 ))
+		;
+	SimFlashWriteWord( address, 0x7FFFFFFF ); // Power fails mid-record:
+	WaitMicrosec( SIM_FLASH_PROGRAM_US );	  // a high sequence number
+	SimFlashWriteWord( address + 4, 0x12345678 ); // but no CRC.
+	WaitMicrosec( SIM_FLASH_PROGRAM_US );
+	PowerUp();
+	Check( "Torn record ignored", ReadDoubleFromFlash() == -2.5 );
+	WriteDoubleToFlash( 42.0 );
+	AnswerStoreFlush();
+	PowerUp();
+	Check( "Appending skips the torn record", ReadDoubleFromFlash() == 42.0 );
+
+	SimFlashReset();
+	PowerUp();
+	for (i = 0; i < 1000000; i++) { // Each committed before the next.
+		WriteDoubleToFlash( (double)i );
+		AnswerStoreFlush();
+	}
+	SimGetStats( &stats );
+	for (address = ANSWER_FLASH_ADDRESS, erases = 0;
+	     address < ANSWER_FLASH_ADDRESS + ANSWER_FLASH_PAGES * FLASH_PAGE_SIZE;
+	     address += FLASH_PAGE_SIZE) {
+		erases += SimFlashPageErases( address );
+		if (SimFlashPageErases( address ) > most)
+			most = SimFlashPageErases( address );
+		if (SimFlashPageErases( address ) < least)
+			least = SimFlashPageErases( address );
+	}
+	Check( "Erase only when a page fills", erases == stats.flash_page_erases
+		&& erases <= 1000000 / (FLASH_PAGE_SIZE / FLASH_LOG_SLOT_SIZE( 8 )) );
+	Check( "Erases spread evenly", most - least <= 1 );
+	Check( "No flash programming errors", stats.flash_errors == 0 );
+	PowerUp();
+	Check( "Last of a million answers read back", ReadDoubleFromFlash() == 999999.0 );
+	printf( "\t%lu page erases per million calculations (%lu for the most "
+		"worn page; a page in place would need 1000000)\n", erases, most );
+} // TestFlash
+
+void TestDeferredCommit( void )
+/* Storing the answer after '=' should not keep the user waiting for the
+ * flash, and a burst of calculations should be written once. */
+{
+const char	*keys[5] = { "1A2*", "4*", "8B1*", "9*", "3*" };
+char	input_buffer[INPUT_BUFFER_SIZE];
+int	error_ref_no;
+double	answer;
+SimStats	stats;
+unsigned long long	start_ns, deferred_ns, flush_ns;
+int	i;
+
+	puts( "Deferred answer commit:" );
+	SimFlashReset();
+	PowerUp();
+	SimResetStats();
+	for (i = 0; i < 5; i++) { // As main() does it.
+		TypeAndRead( keys[i], input_buffer );
+		answer = CalculateAnswer( input_buffer, INPUT_BUFFER_SIZE,
+					  &error_ref_no );
+		DisplayResult( answer );
+		start_ns = TimeNowNanosec();
+		WriteDoubleToFlash( answer );
+		deferred_ns = TimeNowNanosec() - start_ns;
+	}
+	Check( "Answer readable before it is written",
+		ReadDoubleFromFlash() == 3.0 && AnswerStorePending() );
+	SimGetStats( &stats );
+	Check( "Nothing written while typing", stats.flash_words_written == 0 );
+	WaitMicrosec( ANSWER_COMMIT_IDLE_US + SIM_FLASH_ERASE_US );
+	SimGetStats( &stats );
+	Check( "A burst of answers written once",
+		stats.flash_words_written == FLASH_LOG_RECORD_WORDS( 8 )
+		&& ! AnswerStorePending() );
+	WriteDoubleToFlash( 3.0 );
+	WaitMicrosec( ANSWER_COMMIT_IDLE_US + SIM_FLASH_ERASE_US );
+	SimGetStats( &stats );
+	Check( "An unchanged answer is not rewritten",
+		stats.flash_words_written == FLASH_LOG_RECORD_WORDS( 8 ) );
+
+	WriteDoubleToFlash( 4.0 );
+	start_ns = TimeNowNanosec();
+	AnswerStoreFlush(); // What WriteDoubleToFlash() used to cost.
+	flush_ns = TimeNowNanosec() - start_ns;
+	Check( "'=' no longer waits for the flash",
+		deferred_ns < 1000 && flush_ns >= 4000ULL * SIM_FLASH_PROGRAM_US );
+	PowerUp();
+	Check( "Flushed answer survives power-up", ReadDoubleFromFlash() == 4.0 );
+	printf( "\tStoring the answer takes %llu ns, rather than %llu us\n",
+		deferred_ns, flush_ns / 1000 );
+} // TestDeferredCommit
+
+int RunWelcome( const char *keys )
+// Type keys at Welcome(): non-zero if it returned, to the calculator.
+{
+	SimKeypadType( keys, KEY_GAP_US, KEY_HOLD_US );
+	if (setjmp( idle_jump ) != 0)
+		return 0; // Still waiting for more keys.
+	Welcome();
+	return 1;
+} // RunWelcome
+
+void TestBoot( void )
+/* The LCD's power-up wait should overlap the rest of the boot, the banner
+ * should give way to a key, and flash should be written only when the
+ * password changes. */
+{
+const BootStep	*steps;
+int	i, n_steps;
+SimStats	stats;
+
+	puts( "Boot:" );
+	SimFlashReset();
+	PowerUp();
+	n_steps = BootGetTimeline( &steps );
+	for (i = 0; i < n_steps; i++)
+		printf( "\t%8llu us  %s\n", steps[i].done_us, steps[i].name );
+	Check( "Every boot step marked", n_steps == 7 );
+	Check( "Flash read during the LCD power-up wait",
+		steps[3].done_us < LCD_POWER_ON_US && steps[4].done_us < LCD_POWER_ON_US );
+	Check( "LCD ready soon after its power-up wait",
+		steps[ n_steps-1 ].done_us < LCD_POWER_ON_US + 10000 );
+	SimGetStats( &stats );
+	Check( "No LCD timing violations at boot", stats.timing_violations == 0 );
+
+	Check( "Any key skips the banner", RunWelcome( "5" "6666*" "1" ) );
+	n_steps = BootGetTimeline( &steps );
+	Check( "Banner gone soon after the key", n_steps == 8
+		&& steps[7].done_us < steps[6].done_us + KEY_GAP_US + KEY_DEBOUNCE_US + 1000 );
+	SimGetStats( &stats );
+	Check( "Default password not written", stats.flash_words_written == 0 );
+
+	PowerUp();
+	Check( "Password changed", RunWelcome( "5" "6666*" "2" "1234*" "1" ) );
+	SimGetStats( &stats );
+	Check( "New password written once",
+		stats.flash_words_written == FLASH_LOG_RECORD_WORDS( 8 ) );
+	PowerUp();
+	Check( "Same password again", RunWelcome( "5" "1234*" "2" "1234*" "1" ) );
+	SimGetStats( &stats );
+	Check( "Unchanged password not rewritten", stats.flash_words_written == 0 );
+	PowerUp();
+	Check( "Old password refused", ! RunWelcome( "5" "6666*" ) );
+} // TestBoot
+
+int ReadWithinSize( const char *keys, char *input_buffer, int input_buffer_size )
+// Type keys at ReadAndEchoInput(): non-zero if the input was ended.
+{
+	SimKeypadType( keys, KEY_GAP_US, KEY_HOLD_US );
+	if (setjmp( idle_jump ) != 0)
+		return 0; // Still waiting for more keys.
+	ReadAndEchoInput( input_buffer, input_buffer_size );
+	return 1;
+} // ReadWithinSize
+
+int ReadWithin( const char *keys, char *input_buffer )
+{
+	return ReadWithinSize( keys, input_buffer, INPUT_BUFFER_SIZE );
+} // ReadWithin
+
+void TestSnapshot( void )
+/* After a power cycle the calculator should come back at the same screen,
+ * part-typed input and all, within milliseconds of the LCD being ready. */
+{
+char	input_buffer[INPUT_BUFFER_SIZE];
+char	line1[17], line2[17], text[17];
+short int	line, char_pos, before_line, before_pos;
+int	error_ref_no, cursor, i, n_steps;
+unsigned long long	restore_us;
+unsigned long	address, most = 0;
+double	answer;
+const BootStep	*steps;
+
+	puts( "UI snapshot:" );
+	SimFlashReset();
+	PowerUp();
+	TypeAndRead( "1A2*", input_buffer );
+	answer = CalculateAnswer( input_buffer, INPUT_BUFFER_SIZE, &error_ref_no );
+	DisplayResult( answer );
+	WriteDoubleToFlash( answer );
+	Check( "Input stopped part way", ! ReadWithin( "4A5", input_buffer ) );
+	SimLCDGetLine( 1, line1 );
+	SimLCDGetLine( 2, line2 );
+	cursor = SimLCDGetCursor( &before_line, &before_pos );
+	UiShadowGetLine( 1, text );
+	Check( "Shadow matches the LCD", strcmp( text, line1 ) == 0 );
+
+	PowerUp(); // The snapshot was written while idle.
+	n_steps = BootGetTimeline( &steps );
+	CheckLine( "Screen restored, line 1", 1, line1 );
+	CheckLine( "Screen restored, line 2", 2, line2 );
+	Check( "Cursor restored", SimLCDGetCursor( &line, &char_pos ) == cursor
+		&& line == before_line && char_pos == before_pos );
+	restore_us = steps[ n_steps-1 ].done_us - steps[ n_steps-2 ].done_us;
+	Check( "Restored within 20 ms of the LCD",
+		strcmp( steps[ n_steps-1 ].name, "Screen" ) == 0 && restore_us < 20000 );
+	answer = ReadDoubleFromFlash(); // As main() does after InitAllHardware().
+	DisplayResult( answer );
+	CheckLine( "Restored screen kept by DisplayResult()", 2, line2 );
+	TypeAndRead( "6*", input_buffer );
+	Check( "Input carries on where it stopped", strcmp( input_buffer, "4+56" ) == 0 );
+
+	WaitMicrosec( UI_SNAPSHOT_IDLE_US + SIM_FLASH_ERASE_US );
+	for (address = UI_SNAPSHOT_FLASH_ADDRESS; // Corrupt every snapshot.
+	     address < UI_SNAPSHOT_FLASH_ADDRESS + UI_SNAPSHOT_FLASH_PAGES * FLASH_PAGE_SIZE;
+	     address += 64)
+		if (SimFlashReadWord( address ) != 0xFFFFFFFF) {
+			SimFlashWriteWord( address + 8, 0 );
+			WaitMicrosec( SIM_FLASH_PROGRAM_US );
+		}
+	PowerUp();
+	for (i = 1; i <= 2; i++)
+		CheckLine( "Corrupt snapshot gives a clean screen", i, "" );
+	Check( "and a new input", ! ReadWithin( "7", input_buffer ) );
+	CheckLine( "which starts afresh", 1, "7" );
+	printf( "\tScreen restored %llu us after the LCD was ready\n", restore_us );
+
+	SimFlashReset();
+	PowerUp();
+	for (i = 0; i < SNAPSHOT_WEAR_WRITES; i++) { // Each a new answer.
+		DisplayResult( (double)i );
+		UiSnapshotFlush();
+	}
+	for (address = UI_SNAPSHOT_FLASH_ADDRESS;
+	     address < UI_SNAPSHOT_FLASH_ADDRESS + UI_SNAPSHOT_FLASH_PAGES * FLASH_PAGE_SIZE;
+	     address += FLASH_PAGE_SIZE)
+		if (SimFlashPageErases( address ) > most)
+			most = SimFlashPageErases( address );
+	Check( "Snapshots wear no page faster than answers", most > 0
+		&& most <= SNAPSHOT_WEAR_WRITES / (ANSWER_FLASH_PAGES
+			* (FLASH_PAGE_SIZE / FLASH_LOG_SLOT_SIZE( 8 ))) );
+	printf( "\t%lu erases of the most worn snapshot page per %d snapshots\n",
+		most, SNAPSHOT_WEAR_WRITES );
+} // TestSnapshot
+
+void TestEditor( void )
+/* Editing part way along the input, rewriting only the display cells
+ * that change. */
+{
+char	input_buffer[INPUT_BUFFER_SIZE], text[INPUT_BUFFER_SIZE];
+InputEditor	editor;
+SimStats	stats;
+short int	line, char_pos;
+int	i;
+
+	puts( "Input editor:" );
+	SimFlashReset();
+	PowerUp();
+	EditorOpen( &editor, text, sizeof text, 0, 0, 0 );
+	for (i = 0; i < 5; i++)
+		EditorInsert( &editor, "12345"[i] );
+	DisplayFlush();
+	SimResetStats();
+	EditorInsert( &editor, '6' );
+	DisplayFlush();
+	SimGetStats( &stats );
+	Check( "Typing at the end writes one character",
+		stats.lcd_data_writes == 1 && stats.lcd_instructions == 0 );
+	SimResetStats();
+	Check( "Cursor moves left", EditorMove( &editor, -3 ) == -3 );
+	DisplayFlush();
+	SimGetStats( &stats );
+	SimLCDGetCursor( &line, &char_pos );
+	Check( "Moving the cursor is one instruction",
+		stats.lcd_data_writes == 0 && stats.lcd_instructions == 1
+		&& line == 1 && char_pos == 4 );
+	SimResetStats();
+	EditorInsert( &editor, '9' );
+	DisplayFlush();
+	SimGetStats( &stats );
+	CheckLine( "Character inserted", 1, "1239456" );
+	Check( "Only the characters after it rewritten",
+		stats.lcd_data_writes == 4 && stats.lcd_instructions == 1 );
+	SimResetStats();
+	EditorMove( &editor, -1 );
+	EditorRubout( &editor );
+	DisplayFlush();
+	SimGetStats( &stats );
+	SimLCDGetCursor( &line, &char_pos );
+	CheckLine( "Character rubbed out", 1, "129456" );
+	Check( "Cursor stays where the character was", char_pos == 3 );
+	Check( "Cursor stops at the end", EditorMove( &editor, 100 ) == 4 );
+	for (i = 0; EditorInsert( &editor, '0' ); i++)
+		;
+	Check( "Input stops at one line", i == 10 && EditorLength( &editor ) == 16 );
+	EditorClose( &editor );
+	Check( "Closed into a string", strcmp( text, "1294560000000000" ) == 0 );
+
+	TypeAndRead( "123D44D9*", input_buffer );
+	Check( "Shift 4 moves left", strcmp( input_buffer, "1923" ) == 0 );
+	TypeAndRead( "12D44D9D6D#*", input_buffer );
+	Check( "Shift 6 moves right", strcmp( input_buffer, "92" ) == 0 );
+	TypeAndRead( "12D#D3*", input_buffer );
+	Check( "Shift Rubout clears the input", strcmp( input_buffer, "3" ) == 0 );
+	CheckLine( "and the line", 1, "3" );
+
+	Check( "Input stopped part way", ! ReadWithin( "123D4D", input_buffer ) );
+	PowerUp();
+	TypeAndRead( "9*", input_buffer );
+	Check( "Cursor restored after a power cycle", strcmp( input_buffer, "1293" ) == 0 );
+} // TestEditor
+
+void TestScrolling( void )
+/* Inputs longer than a line scroll with the display shift, rewriting
+ * only the cells that come into view, and survive a power cycle. */
+{
+static const int	sizes[3] = { 17, 41, 81 };
+static const char	*what[3] = { "16 characters read", "40 characters read",
+				     "80 characters read" };
+char	input_buffer[81], keys[100], line1[17], text[17];
+SimStats	stats;
+short int	line, char_pos;
+double	bytes_per_key[3];
+int	i, n;
+
+	puts( "Scrolling input:" );
+	for (n = 0; n < 3; n++) { // Type the buffer full.
+		for (i = 0; i < sizes[n] - 1; i++)
+			keys[i] = '0' + (i * 7) % 10;
+		keys[i] = '\0';
+		SimFlashReset();
+		PowerUp();
+		SimResetStats();
+		ReadWithinSize( keys, input_buffer, sizes[n] );
+		SimGetStats( &stats );
+		bytes_per_key[n] = (double)(stats.lcd_instructions + stats.lcd_data_writes)
+			/ (sizes[n] - 1);
+		SimFlashReset();
+		PowerUp();
+		strcat( keys, "*" );
+		TypeAndReadSize( keys, input_buffer, sizes[n] );
+		keys[ sizes[n] - 1 ] = '\0';
+		Check( what[n], strcmp( input_buffer, keys ) == 0 );
+	}
+	CheckLine( "Line shows the start once read", 1, "0741852963074185" );
+	Check( "Cost per key bounded as the input grows", bytes_per_key[0] < 1.5
+		&& bytes_per_key[1] < 2.5 && bytes_per_key[2] < 4 );
+
+	Check( "Input stopped part way",
+		! ReadWithinSize( "123456789012345678901234D444D", input_buffer, 41 ) );
+	CheckLine( "Scrolled to keep the cursor shown", 1, "012345678901234" );
+	SimLCDGetCursor( &line, &char_pos );
+	Check( "Cursor in the window", line == 1 && char_pos == 13 );
+	SimLCDGetLine( 1, line1 );
+	UiShadowGetLine( 1, text );
+	Check( "Shadow follows the display shift", strcmp( text, line1 ) == 0 );
+	PowerUp();
+	CheckLine( "Scrolled screen restored", 1, line1 );
+	TypeAndReadSize( "D4444444444444444444444D0*", input_buffer, 41 );
+	Check( "Long input resumed and edited at the start",
+		strcmp( input_buffer, "0123456789012345678901234" ) == 0 );
+	CheckLine( "and shown from the start", 1, "0123456789012345" );
+	for (i = 0; i < UI_SNAPSHOT_MAX_INPUT + 1; i++)
+		keys[i] = '1';
+	keys[i] = '\0';
+	Check( "Input too long to keep stopped part way",
+		! ReadWithinSize( keys, input_buffer, 81 ) );
+	PowerUp();
+	TypeAndReadSize( "2*", input_buffer, 81 );
+	Check( "and not resumed cut short", strcmp( input_buffer, "2" ) == 0 );
+	printf( "\tLCD bytes per key typed: %.2f for 16 characters, "
+		"%.2f for 40, %.2f for 80\n",
+		bytes_per_key[0], bytes_per_key[1], bytes_per_key[2] );
+} // TestScrolling
+
+void TestEffects( void )
+/* The warning of a full input, a flash and a message over line 2, should
+ * play while keys are read and echoed, and leave the display as the keys
+ * and the display functions left it. */
+{
+static unsigned char	trace[ KEY_TRACE_EXPORT_SIZE ];
+static KeyTraceLatency	latencies[ KEY_TRACE_RECORDS ];
+char	input_buffer[INPUT_BUFFER_SIZE], line2[17];
+short int	line, char_pos;
+int	n;
+
+	puts( "Display effects:" );
+	SimFlashReset();
+	PowerUp();
+	KeyTraceStart();
+	ReadWithin( "1234567890123456" "7##8", input_buffer ); // 7 is one too many.
+	KeyTraceExport( trace, sizeof trace );
+	n = KeyTraceLatencies( trace, latencies, KEY_TRACE_RECORDS );
+	Check( "Keys after the warning echoed at once", n == 20
+		&& latencies[17].latency_us < 2 * KEY_DEBOUNCE_US
+		&& latencies[18].latency_us < 2 * KEY_DEBOUNCE_US
+		&& latencies[19].latency_us < 2 * KEY_DEBOUNCE_US );
+	CheckLine( "and edit the input", 1, "123456789012348" );
+	Check( "Display and cursor on afterwards",
+		SimLCDDisplayOn() && SimLCDGetCursor( &line, &char_pos ) );
+	CheckLine( "Line 2 back afterwards", 2, "" );
+	PowerUp(); // Abandoned part way, as after a power cut.
+	TypeAndRead( "*", input_buffer );
+
+	TypeAndRead( "1234567890123456" "7*", input_buffer );
+	Check( "'=' during the warning ends the input",
+		strcmp( input_buffer, "1234567890123456" ) == 0 );
+	DisplayFlush();
+	Check( "and leaves the display on, cursor off",
+		SimLCDDisplayOn() && ! SimLCDGetCursor( &line, &char_pos ) );
+
+	PrintString( 2, 1, "15" );
+	DisplayFlush();
+	DisplayMessage( 2, "Hello", 500000 );
+	WaitMicrosec( 100000 );
+	SimLCDGetLine( 2, line2 );
+	Check( "Message shown over line 2", strcmp( line2, "Hello           " ) == 0 );
+	PrintString( 2, 1, "42" );
+	CheckLine( "Line 2 restored, as written meanwhile", 2, "42" );
+	SimLCDGetCursor( &line, &char_pos );
+	Check( "Address counter put back", line == 2 && char_pos == 3 );
+	printf( "\tKey after the warning echoed %lu us after it was pressed\n",
+		latencies[17].latency_us );
+} // TestEffects
+
+void TestTasks( void )
+/* main()'s cycle over a scripted session, first with the display task
+ * sending the LCD's bytes and then with each byte waited for, as before
+ * the scheduler. The screen and the key echoes should be the same either
+ * way, but main() should no longer wait for the LCD. */
+{
+char	input_buffer[INPUT_BUFFER_SIZE], lines[2][2][17];
+SimStats	stats[2];
+TimeIdleStats	idle[2];
+SchedulerStats	sched;
+unsigned long long	held_us[2], start_us;
+double	answer;
+int	way, i, error_ref_no;
+
+	puts( "Tasks, as main() runs:" );
+	for (way = 0; way < 2; way++) {
+		SimFlashReset();
+		PowerUp();
+		if (way == 1)
+			InitDisplayTask(); // Back to sending each byte at once.
+		SimResetStats();
+		for (i = 0; i < TASK_EXPRESSIONS; i++)
+			SimKeypadType( (i % 2) ? "12A3*" : "7C5B2A40*", KEY_GAP_US, KEY_HOLD_US );
+		held_us[way] = 0;
+		for (i = 0; i < TASK_EXPRESSIONS; i++) {
+			ReadAndEchoInput( input_buffer, INPUT_BUFFER_SIZE );
+			start_us = TimeNowMicrosec();
+			error_ref_no = 0;
+			answer = CalculateAnswer( input_buffer, INPUT_BUFFER_SIZE, &error_ref_no );
+			DisplayResult( answer );
+			WriteDoubleToFlash( answer );
+			held_us[way] += TimeNowMicrosec() - start_us;
+		}
+		DisplayFlush();
+		SimGetStats( &stats[way] );
+		TimeGetIdleStats( &idle[way] );
+		SimLCDGetLine( 1, lines[way][0] );
+		SimLCDGetLine( 2, lines[way][1] );
+		if (way == 0)
+			SchedulerGetStats( &sched );
+	}
+	Check( "Same screen either way", memcmp( lines[0], lines[1], sizeof lines[0] ) == 0
+		&& strcmp( lines[0][1], "15              " ) == 0 );
+	Check( "Same key echoes either way",
+		stats[0].key_echoes == stats[1].key_echoes
+		&& stats[0].key_echo_total_us == stats[1].key_echo_total_us );
+	Check( "main() does not wait for the LCD",
+		held_us[0] * 100 < held_us[1] );
+	Check( "Awake a tenth as long", idle[0].awake_us * 10 < idle[1].awake_us );
+	Check( "No events lost", sched.dropped == 0 );
+	printf( "\tAnswer to next input %llu us, was %llu us; awake %llu us, "
+		"was %llu us; key to echo mean %llu us, max %llu us\n",
+		held_us[0] / TASK_EXPRESSIONS, held_us[1] / TASK_EXPRESSIONS,
+		idle[0].awake_us, idle[1].awake_us,
+		stats[0].key_echo_total_us / stats[0].key_echoes, stats[0].key_echo_max_us );
+	printf( "\tEvents: %lu keypad, %lu flash, %lu display; at most %u queued\n",
+		sched.events[ TASK_KEYPAD ], sched.events[ TASK_FLASH ],
+		sched.events[ TASK_DISPLAY ], sched.max_queued );
+} // TestTasks
+
+void RunMain( void )
+/* main() after InitAllHardware(), until the scripted keys have run out and
+ * the simulation is idle, and then until the LCD has been sent everything. */
+{
+char	input_buffer[INPUT_BUFFER_SIZE];
+double	answer;
+int	error_ref_no;
+
+	if (setjmp( idle_jump ) == 0) {
+		answer = ReadDoubleFromFlash();
+		DisplayResult( answer );
+		while (1) {
+			ReadAndEchoInput( input_buffer, INPUT_BUFFER_SIZE );
+			error_ref_no = 0;
+			answer = CalculateAnswer( input_buffer, INPUT_BUFFER_SIZE, &error_ref_no );
+			DisplayResult( answer );
+			WriteDoubleToFlash( answer );
+		}
+	}
+	DisplayFlush();
+} // RunMain
+
+int SameDisplay( const unsigned char *trace, const KeyTraceHeader *header,
+		 const unsigned char *other, const KeyTraceHeader *other_header )
+// Non-zero if two traces sent the LCD the same bytes.
+{
+KeyTraceRecord	a, b;
+unsigned long	i = 0, j = 0;
+
+	while (1) {
+		for (; i < header->n_records; i++) {
+			KeyTraceGetRecord( trace, i, &a );
+			if (a.type > KEY_TRACE_REPEAT)
+				break;
+		}
+		for (; j < other_header->n_records; j++) {
+			KeyTraceGetRecord( other, j, &b );
+			if (b.type > KEY_TRACE_REPEAT)
+				break;
+		}
+		if (i == header->n_records || j == other_header->n_records)
+			return i == header->n_records && j == other_header->n_records;
+		if (a.type != b.type || a.value != b.value)
+			return 0;
+		i++, j++;
+	}
+} // SameDisplay
+
+int ReplayTrace( const unsigned char *trace, unsigned long size,
+		 unsigned char *replayed, unsigned long *replayed_size )
+/* Replay a key trace through main()'s cycle on fresh simulated hardware:
+ * boot with the trace's answer, press its keys at their recorded times,
+ * run until they are done, and leave the replay's own trace in replayed
+ * (KEY_TRACE_EXPORT_SIZE bytes). Returns 1 if the LCD was sent the same
+ * bytes, 0 if not, 2 if they cannot be compared because the trace did not
+ * start from the screen a boot gives (it wrapped, or the screen had been
+ * restored), or -1 if it is not a trace. */
+{
+KeyTraceHeader	header, again;
+KeyTraceRecord	press, release;
+unsigned long long	at_us;
+unsigned long	i, j, hold_us;
+uint32_t	last_us = 0;
+char	lines[2][17];
+
+	if (KeyTraceParse( trace, size, &header ) != 0)
+		return -1;
+	SimFlashReset();
+	PowerUp();
+	AnswerStoreSet( header.answer );
+	AnswerStoreFlush();
+	PowerUp(); // Starts the replay's trace, as the device started the original.
+	UiShadowGetLine( 1, lines[0] );
+	UiShadowGetLine( 2, lines[1] );
+	at_us = TimeNowMicrosec();
+	for (i = 0; i < header.n_records; i++) {
+		KeyTraceGetRecord( trace, i, &press );
+		if (press.type != KEY_TRACE_PRESS)
+			continue;
+		at_us += (int32_t)(press.time_us - last_us); // Presses are in order.
+		last_us = press.time_us;
+		hold_us = KEY_HOLD_US; // If it was still down at the end.
+		for (j = i + 1; j < header.n_records; j++) {
+			KeyTraceGetRecord( trace, j, &release );
+			if (release.type == KEY_TRACE_RELEASE && release.value == press.value) {
+				hold_us = release.time_us - press.time_us;
+				break;
+			}
+		}
+		SimKeypadScript( (char)press.value, at_us, hold_us );
+	}
+	RunMain();
+	*replayed_size = KeyTraceExport( replayed, KEY_TRACE_EXPORT_SIZE );
+	KeyTraceParse( replayed, *replayed_size, &again );
+	if ((header.flags & KEY_TRACE_WRAPPED)
+	    || strcmp( header.lines[0], lines[0] ) != 0 || strcmp( header.lines[1], lines[1] ) != 0)
+		return 2;
+	return SameDisplay( trace, &header, replayed, &again );
+} // ReplayTrace
+
+int CompareLatency( const void *a, const void *b )
+{
+	unsigned long	x = *(const unsigned long *)a, y = *(const unsigned long *)b;
+	return (x > y) - (x < y);
+} // CompareLatency
+
+void PrintLatencies( const KeyTraceLatency *latencies, int n )
+// The distribution of key latencies: overall, and then for each key.
+{
+static const char	keys[] = "0123456789ABCD*#";
+static unsigned long	sorted[ KEY_TRACE_RECORDS ];
+int	k, i, m;
+
+	for (k = -1; k < (int)sizeof keys - 1; k++) {
+		for (i = m = 0; i < n; i++)
+			if (k < 0 || latencies[i].key == keys[k])
+				sorted[ m++ ] = latencies[i].latency_us;
+		if (m == 0)
+			continue;
+		qsort( sorted, m, sizeof sorted[0], CompareLatency );
+		if (k < 0)
+			printf( "\t%d keys: latency p50 %lu us, p90 %lu us, p99 %lu us, max %lu us\n",
+				m, sorted[ (m - 1) * 50 / 100 ], sorted[ (m - 1) * 90 / 100 ],
+				sorted[ (m - 1) * 99 / 100 ], sorted[ m - 1 ] );
+		else
+			printf( "\t\t'%c' %4d: p50 %6lu us, max %6lu us\n",
+				keys[k], m, sorted[ (m - 1) / 2 ], sorted[ m - 1 ] );
+	}
+} // PrintLatencies
+
+void TestTrace( void )
+/* A session through main()'s cycle should leave a trace of its keys and
+ * of the LCD's bytes which, replayed on fresh hardware, sends the LCD the
+ * same bytes with the same latencies. */
+{
+static unsigned char	trace[ KEY_TRACE_EXPORT_SIZE ], replayed[ KEY_TRACE_EXPORT_SIZE ];
+static KeyTraceLatency	latencies[2][ KEY_TRACE_RECORDS ];
+KeyTraceHeader	header;
+KeyTraceRecord	record;
+unsigned long	size, replayed_size, i;
+int	n_keys, n_presses = 0, n_bytes = 0, n[2], i_way;
+
+	puts( "Key trace:" );
+	SimFlashReset();
+	PowerUp();
+	AnswerStoreSet( 7.0 );
+	AnswerStoreFlush();
+	PowerUp();
+	n_keys = SimKeypadType( "12A3*" "7C5B2A40*" "9B9B9*", KEY_GAP_US, KEY_HOLD_US );
+	RunMain();
+	size = KeyTraceExport( trace, sizeof trace );
+	Check( "Trace exported", KeyTraceParse( trace, size, &header ) == 0
+		&& header.answer == 7.0 && header.flags == 0 );
+	for (i = 0; i < header.n_records; i++) {
+		KeyTraceGetRecord( trace, i, &record );
+		n_presses += record.type == KEY_TRACE_PRESS;
+		n_bytes += record.type == KEY_TRACE_DATA;
+	}
+	Check( "Every key and character recorded",
+		n_presses == n_keys && n_bytes >= n_keys );
+
+	Check( "Replay sends the LCD the same bytes",
+		ReplayTrace( trace, size, replayed, &replayed_size ) == 1 );
+	n[0] = KeyTraceLatencies( trace, latencies[0], KEY_TRACE_RECORDS );
+	n[1] = KeyTraceLatencies( replayed, latencies[1], KEY_TRACE_RECORDS );
+	Check( "Replay has the same key latencies", n[0] == n_keys && n[1] == n[0]
+		&& memcmp( latencies[0], latencies[1], n[0] * sizeof latencies[0][0] ) == 0 );
+	PrintLatencies( latencies[0], n[0] );
+
+	SimFlashReset();
+	PowerUp();
+	for (i_way = 0; i_way < 20; i_way++)
+		SimKeypadType( "7C5B2A40*", KEY_GAP_US, KEY_HOLD_US );
+	RunMain();
+	size = KeyTraceExport( trace, sizeof trace );
+	KeyTraceParse( trace, size, &header );
+	Check( "A long trace keeps the newest records",
+		(header.flags & KEY_TRACE_WRAPPED) && header.n_records == KEY_TRACE_RECORDS
+		&& header.dropped > 0 );
+	Check( "and replays without comparing the LCD",
+		ReplayTrace( trace, size, replayed, &replayed_size ) == 2 );
+} // TestTrace
+
+int ReplayFile( const char *name )
+/* Replay a key trace read from a file, e.g. one exported on the device,
+ * and report the latencies in it and in the replay. */
+{
+static unsigned char	replayed[ KEY_TRACE_EXPORT_SIZE ];
+static KeyTraceLatency	latencies[ KEY_TRACE_RECORDS ];
+unsigned char	*trace;
+unsigned long	size, replayed_size;
+KeyTraceHeader	header;
+FILE	*file = fopen( name, "rb" );
+long	length;
+int	result;
+
+	if (file == NULL || fseek( file, 0, SEEK_END ) != 0 || (length = ftell( file )) < 0) {
+		printf( "FATAL: cannot read %s\n", name );
+		return 0;
+	}
+	rewind( file );
+	trace = malloc( length ? length : 1 );
+	size = fread( trace, 1, length, file );
+	fclose( file );
+	if (KeyTraceParse( trace, size, &header ) != 0) {
+		printf( "FATAL: %s is not a key trace\n", name );
+		return 0;
+	}
+	printf( "%s: %lu records (%lu overwritten), answer %g, screen\n"
+		"\t\"%s\"\n\t\"%s\"\n", name, (unsigned long)header.n_records,
+		(unsigned long)header.dropped, header.answer, header.lines[0], header.lines[1] );
+	puts( "As recorded:" );
+	PrintLatencies( latencies, KeyTraceLatencies( trace, latencies, KEY_TRACE_RECORDS ) );
+	result = ReplayTrace( trace, size, replayed, &replayed_size );
+	puts( "Replayed:" );
+	PrintLatencies( latencies, KeyTraceLatencies( replayed, latencies, KEY_TRACE_RECORDS ) );
+	puts( result == 1 ? "The LCD was sent the same bytes."
+		: result == 2 ? "The LCD's bytes were not compared: the trace does not start at boot."
+		: "The LCD was sent DIFFERENT bytes." );
+	free( trace );
+	return result > 0;
+} // ReplayFile
+
+void Spin( long n )
+// Burn CPU for the profiler to find.
+{
+volatile long	i;
+	for (i = 0; i < n; i++)
+		;
+} // Spin
+
+void TestProfiler( void )
+/* Samples should be counted by address, with addresses which find no slot
+ * dropped, and SIGPROF should find a loop which uses the CPU. */
+{
+static char	text[ 64 * PROFILE_SLOTS + 128 * PROFILE_STACKS ];
+void	(*volatile spin)( long ) = Spin;
+const ProfileSlot	*slots;
+uintptr_t	stack[2] = { 0x1000, 0x2000 };
+unsigned long	dropped, samples, i;
+clock_t	start;
+
+	puts( "Profiler:" );
+	ProfileReset();
+	ProfileSample( stack, 2 );
+	ProfileSample( stack, 1 );
+	stack[0] = 0x1002;
+	ProfileSample( stack, 2 );
+	ProfileExport( text, sizeof text );
+	Check( "Samples counted by address", ProfileCountRange( 0x1000, 0x1001 ) == 2
+		&& ProfileCountRange( 0x1000, 0x1004 ) == 3 );
+	Check( "and exported", strstr( text, "samples 3 dropped 0" ) != 0
+		&& strstr( text, "\npc 0x1000 2\n" ) != 0
+		&& strstr( text, "\nstack 0x1002 0x2000\n" ) != 0 );
+	ProfileReset();
+	for (i = 0; i < PROFILE_SLOTS + 100; i++) {
+		stack[0] = 0x1000 + 2 * i;
+		ProfileSample( stack, 1 );
+	}
+	samples = ProfileGetHistogram( &slots, &dropped );
+	Check( "Addresses beyond the histogram dropped",
+		samples == PROFILE_SLOTS + 100 && dropped >= 100
+		&& ProfileCountRange( 0x1000, 0x1000 + 2 * (PROFILE_SLOTS + 100) )
+			== samples - dropped );
+
+	ProfileReset();
+	ProfileStart( 1000 );
+	start = clock();
+	while (ProfileGetHistogram( &slots, &dropped ) < 50
+	       && clock() - start < 5 * CLOCKS_PER_SEC)
+		spin( 100000 );
+	ProfileStop();
+	samples = ProfileGetHistogram( &slots, &dropped );
+	Check( "SIGPROF finds the busy loop", samples >= 50
+		&& ProfileCountRange( (uintptr_t)Spin, (uintptr_t)Spin + 256 ) > samples * 3 / 4 );
+	printf( "\t%lu samples, %lu in Spin()\n", samples,
+		ProfileCountRange( (uintptr_t)Spin, (uintptr_t)Spin + 256 ) );
+} // TestProfiler
+
+void TestMetrics( void )
+/* The metrics should count from power-up, errors by their number, and be
+ * shown by the hidden key at the menu. */
+{
+char	input_buffer[INPUT_BUFFER_SIZE], text[ 32 * METRIC_N ];
+int	error_ref_no;
+
+	puts( "Metrics:" );
+	SimFlashReset();
+	PowerUp();
+	Check( "Zero at power-up", metrics[ METRIC_KEYS ] == 0
+		&& metrics[ METRIC_EXPRESSIONS ] == 0 );
+	TypeAndRead( "12#A3*", input_buffer );
+	CalculateAnswer( input_buffer, INPUT_BUFFER_SIZE, &error_ref_no );
+	TypeAndRead( "1AA2*", input_buffer );
+	CalculateAnswer( input_buffer, INPUT_BUFFER_SIZE, &error_ref_no );
+	WriteDoubleToFlash( 4.0 );
+	AnswerStoreFlush();
+	Check( "Keys and rubouts counted", metrics[ METRIC_KEYS ] == 11
+		&& metrics[ METRIC_RUBOUTS ] == 1 && metrics[ METRIC_LCD_BYTES ] > 0 );
+	Check( "Expressions, tokens and errors counted",
+		metrics[ METRIC_EXPRESSIONS ] == 2 && metrics[ METRIC_ERRORS ] == 1
+		&& metrics[ METRIC_ERROR_0 + error_ref_no ] == 1
+		&& metrics[ METRIC_TOKENS ] == 3 && metrics[ METRIC_LAST_TOKENS ] == 3 );
+	Check( "Flash words counted", metrics[ METRIC_FLASH_WRITES ] == FLASH_LOG_RECORD_WORDS( 8 )
+		&& metrics[ METRIC_FLASH_ERASES ] == 0 );
+	MetricsExport( text, sizeof text );
+	Check( "Exported, errors only once they happen",
+		strstr( text, "Expressions     2\n" ) != 0
+		&& strstr( text, "Error 9         1\n" ) != 0 && strstr( text, "Error 1 " ) == 0 );
+	Check( "Hidden at the menu", ! RunWelcome( "5" "6666*" "D" ) );
+	CheckLine( "D shows the first metric", 1, "Expressions" );
+	CheckLine( "and its value", 2, "2" );
+} // TestMetrics
+
+int CountOf( const char *text, const char *what )
+{
+	int	n = 0;
+
+	for (; (text = strstr( text, what )) != 0; text++)
+		n++;
+	return n;
+} // CountOf
+
+void TestTraceEvents( void )
+/* Spans should be timed on the simulated clock, and the export should stay
+ * balanced when the ring has wrapped or a span is still open. (The
+ * firmware's own spans need -DTRACE_EVENTS, so are not tested here.) */
+{
+static char	text[ TRACE_EVENTS_EXPORT_SIZE ];
+char	expected[ 128 ];
+unsigned long long	start_ns;
+unsigned long	i;
+
+	puts( "Trace events:" );
+	PowerUp();
+	TraceEventsReset();
+	TraceEvent( 'B', "Outer", TRACE_TRACK_MAIN, -1 );
+	start_ns = TimeNowNanosec();
+	WaitMicrosec( 5 );
+	TraceEvent( 'B', "Byte", TRACE_TRACK_LCD, 0x38 );
+	TraceEvent( 'E', "Byte", TRACE_TRACK_LCD, -1 );
+	TraceEvent( 'E', "Outer", TRACE_TRACK_MAIN, -1 );
+	TraceEventsExport( text, sizeof text );
+	snprintf( expected, sizeof expected, "\"name\":\"Byte\",\"ph\":\"B\",\"pid\":1,"
+		  "\"tid\":%d,\"ts\":%llu.%03u,\"args\":{\"value\":56}}", TRACE_TRACK_LCD,
+		  (start_ns + 5000) / 1000, (unsigned)((start_ns + 5000) % 1000) );
+	Check( "Span timed on the simulated clock", strstr( text, expected ) != 0 );
+	Check( "Tracks named", strstr( text, "\"args\":{\"name\":\"LCD\"}" ) != 0 );
+
+	TraceEventsReset();
+	TraceEvent( 'B', "Lost", TRACE_TRACK_MAIN, -1 );
+	for (i = 0; i < TRACE_EVENT_RECORDS / 2; i++) {
+		TraceEvent( 'B', "Kept", TRACE_TRACK_TASK, -1 );
+		TraceEvent( 'E', "Kept", TRACE_TRACK_TASK, -1 );
+	}
+	TraceEvent( 'E', "Lost", TRACE_TRACK_MAIN, -1 );
+	TraceEvent( 'B', "Open", TRACE_TRACK_MAIN, -1 );
+	TraceEventsExport( text, sizeof text );
+	Check( "Ends whose begins were overwritten left out",
+		TraceEventsRecorded() == TRACE_EVENT_RECORDS + 3 && strstr( text, "Lost" ) == 0 );
+	Check( "Spans still open ended", CountOf( text, "\"ph\":\"B\"" )
+		== CountOf( text, "\"ph\":\"E\"" ) && strcmp( text + strlen( text ) - 4, "\n]}\n" ) == 0 );
+	TraceEventsReset();
+} // TestTraceEvents
+
+void AutomaticTest( void )
+/* With -DSOFT_FLOAT_COUNT, each test which calculates is followed by the
+ * double-precision operations it did, and their estimated Tiva cycles (see
+ * soft_float.h). */
+{
+	static const struct {
+		const char	*name;
+		void	(*test)( void );
+	} tests[] = {
+		{ "VirtualClock", TestVirtualClock },
+		{ "Display", TestDisplay },
+		{ "Keyboard", TestKeyboard },
+		{ "Debounce", TestDebounce },
+		{ "Scanning", TestScanning },
+		{ "Idle", TestIdle },
+		{ "Session", TestSession },
+		{ "Tasks", TestTasks },
+		{ "Calculation", TestCalculation },
+		{ "Format", TestFormat },
+		{ "Flash", TestFlash },
+		{ "DeferredCommit", TestDeferredCommit },
+		{ "Boot", TestBoot },
+		{ "Snapshot", TestSnapshot },
+		{ "Editor", TestEditor },
+		{ "Scrolling", TestScrolling },
+		{ "Effects", TestEffects },
+		{ "Trace", TestTrace },
+		{ "Profiler", TestProfiler },
+		{ "Metrics", TestMetrics },
+		{ "TraceEvents", TestTraceEvents },
+	};
+	unsigned	i;
+
+	for (i = 0; i < sizeof tests / sizeof tests[0]; i++) {
+#ifdef SOFT_FLOAT_COUNT
+		char	report[ 1024 ];
+
+		SoftFloatReset();
+		tests[i].test();
+		if (soft_float_expressions != 0) {
+			SoftFloatReport( report, sizeof report );
+			printf( "Soft float, Test%s:\n%s", tests[i].name, report );
+		}
+#else
+		tests[i].test();
+#endif
+	}
+	printf( "Total of %d tests passed out of %d conducted.\n",
+		n_passed, n_tested );
+} // AutomaticTest
+
+int main( int argc, char* argv[] )
+{
+	printf( "\n%s\n", PROG_NAME_VER );
+	puts( "Testing the display and keyboard layers on simulated hardware." );
+	if (argc == 3 && (argv[1][0] == 'r' || argv[1][0] == 'R'))
+		return ReplayFile( argv[2] ) ? EXIT_SUCCESS : EXIT_FAILURE;
+	if (argc != 2 || (argv[1][0] != 'a' && argv[1][0] != 'A')) {
+		puts( "FATAL: usage is test_host_sim A, or test_host_sim R file" );
+		puts( "where A or a runs the Automatic tests, and R or r replays" );
+		puts( "the key trace in file." );
+		exit( EXIT_FAILURE );
+	}
+	AutomaticTest();
+	return (n_passed == n_tested) ? EXIT_SUCCESS : EXIT_FAILURE;
+} // main
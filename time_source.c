@@ -0,0 +1,176 @@
+/* time_source.c
+ *
+ * Software timers, shared by the Tiva time source and the host virtual clock.
+ *
+ * The running timers are kept in a singly-linked list sorted by deadline, so
+ * the next to fire is always at the head. Timers with equal deadlines fire in
+ * the order they were started.
+ *
+ * For documentation, see the corresponding .h file.
+ */
+
+#include "time_source.h"
+
+static SoftTimer	*timer_list = 0;	// Earliest deadline first.
+
+static void Unlink( SoftTimer *timer )
+// Remove a timer from the list. Interrupts must be disabled.
+{
+	SoftTimer	**link;
+	for (link = &timer_list; *link; link = &(*link)->next)
+		if (*link == timer) {
+			*link = timer->next;
+			break;
+		}
+	timer->next = 0;
+	timer->active = 0;
+} // Unlink
+
+void TimerStart( SoftTimer *timer, unsigned long delay_us, void (*callback)( void ) )
+{
+	unsigned long long	deadline_us = TimeNowMicrosec() + delay_us;
+	SoftTimer	**link;
+	long	sr = StartCritical();
+
+	if (timer->active)
+		Unlink( timer );
+	timer->deadline_us = deadline_us;
+	timer->callback = callback;
+	for (link = &timer_list; *link; link = &(*link)->next)
+		if ((*link)->deadline_us > deadline_us)
+			break;
+	timer->next = *link;
+	*link = timer;
+	timer->active = 1;
+	EndCritical( sr );
+} // TimerStart
+
+void TimerStop( SoftTimer *timer )
+{
+	long	sr = StartCritical();
+	if (timer->active)
+		Unlink( timer );
+	EndCritical( sr );
+} // TimerStop
+
+int TimerIsActive( const SoftTimer *timer )
+{
+	return timer->active;
+} // TimerIsActive
+
+int TimerNextDeadline( unsigned long long *deadline_us )
+{
+	int	found = 0;
+	long	sr = StartCritical();
+	if (timer_list) {
+		*deadline_us = timer_list->deadline_us;
+		found = 1;
+	}
+	EndCritical( sr );
+	return found;
+} // TimerNextDeadline
+
+void TimerRunDue( unsigned long long now_us )
+{
+	while (1) {
+		SoftTimer	*timer;
+		long	sr = StartCritical();
+
+		timer = timer_list;
+		if (timer == 0 || timer->deadline_us > now_us) {
+			EndCritical( sr );
+			return;
+		}
+		timer_list = timer->next;
+		timer->next = 0;
+		timer->active = 0;
+		EndCritical( sr );
+
+		timer->callback(); // May restart this or any other timer.
+	}
+} // TimerRunDue
+
+void TimerStopAll( void )
+{
+	long	sr = StartCritical();
+	while (timer_list)
+		Unlink( timer_list );
+	EndCritical( sr );
+} // TimerStopAll
+
+long TimeDelaySelfTest( TimeDelayError results[ TIME_SELF_TEST_DELAYS ] )
+{
+	unsigned long long	start_ns, read_ns;
+	long	delay_us = 1, worst_ns = 0;
+	int	i;
+
+	start_ns = TimeNowNanosec();
+	read_ns = TimeNowNanosec() - start_ns;	// The cost of timing itself.
+	for (i = 0; i < TIME_SELF_TEST_DELAYS; i++, delay_us *= 10) {
+		long	error_ns;
+		start_ns = TimeNowNanosec();
+		TimeWaitMicrosec( delay_us );
+		error_ns = (long)(TimeNowNanosec() - start_ns - read_ns)
+			   - delay_us * 1000L;
+		results[i].delay_us = delay_us;
+		results[i].error_ns = error_ns;
+		if (error_ns > worst_ns || -error_ns > worst_ns)
+			worst_ns = (error_ns < 0) ? -error_ns : error_ns;
+	}
+	return worst_ns;
+} // TimeDelaySelfTest
+
+// ------------------------ Tickless idle ------------------------
+
+static TimeIdleStats	idle_stats;
+static unsigned long long	idle_stats_since_us = 0;
+static volatile int	awake_holds = 0;	// See TimeHoldAwake().
+
+void TimeIdle( void )
+{
+	unsigned long long	deadline_us, from_us = TimeNowMicrosec();
+	int	has_deadline = TimerNextDeadline( &deadline_us );
+	unsigned long long	asleep_us;
+	int	deep;
+
+	if (has_deadline && deadline_us <= from_us)
+		return; // A timer is due: its interrupt will be taken at once.
+	deep = awake_holds == 0
+	       && (! has_deadline || deadline_us - from_us >= TIME_DEEP_SLEEP_MIN_US);
+	TimeSourceSleep( has_deadline ? &deadline_us : 0, deep );
+
+	asleep_us = TimeNowMicrosec() - from_us;
+	idle_stats.sleeps ++;
+	idle_stats.asleep_us += asleep_us;
+	if (deep) {
+		idle_stats.deep_sleeps ++;
+		idle_stats.deep_asleep_us += asleep_us;
+	}
+} // TimeIdle
+
+void TimeHoldAwake( int hold )
+{
+	long	sr = StartCritical();
+	if (hold)
+		awake_holds ++;
+	else if (awake_holds > 0)
+		awake_holds --;
+	EndCritical( sr );
+} // TimeHoldAwake
+
+void TimeGetIdleStats( TimeIdleStats *stats )
+{
+	long	sr = StartCritical();
+	*stats = idle_stats;
+	stats->awake_us = TimeNowMicrosec() - idle_stats_since_us - idle_stats.asleep_us;
+	EndCritical( sr );
+} // TimeGetIdleStats
+
+void TimeResetIdleStats( void )
+{
+	long	sr = StartCritical();
+	idle_stats.sleeps = idle_stats.deep_sleeps = 0;
+	idle_stats.asleep_us = idle_stats.deep_asleep_us = idle_stats.awake_us = 0;
+	idle_stats_since_us = TimeNowMicrosec();
+	EndCritical( sr );
+} // TimeResetIdleStats
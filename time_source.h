@@ -0,0 +1,214 @@
+/*! \file time_source.h
+ * Time source for the calculator: a monotonic microsecond clock, delays and
+ * software timers.
+ *
+ * WaitMicrosec() in the low level, and anything else that needs to know the
+ * time, goes through these functions. There are two implementations, chosen
+ * when linking:
+ * 	- \a time_source_tiva, for the Tiva. The clock is Wide Timer 0,
+ * 		counting system clock cycles in 64 bits, and delays
+ * 		busy-wait on it until their deadline. A periodic tick from
+ * 		Timer 2A runs the software timers.
+ * 	- \a virtual_clock, for host builds. This is a discrete-event clock:
+ * 		a delay advances simulated time instantly, firing any timers
+ * 		which fall due on the way, in deadline order. A host run of
+ * 		the user interface layers is therefore not slowed by their
+ * 		long waits (3 s welcome banner, 200 ms key delay, 400 ms flash).
+ *
+ * The timer list itself (\a time_source.c) is shared by both.
+ */
+
+#ifndef TIME_SOURCE_H
+#define TIME_SOURCE_H
+
+/*! A software timer. The caller owns the storage, which must stay valid
+ * while the timer is running; the fields are private to the time source.
+ */
+typedef struct SoftTimer {
+	unsigned long long	deadline_us;
+	void	(*callback)( void );
+	struct SoftTimer	*next;
+	int	active;
+} SoftTimer;
+
+//! \name Clock and delays
+//@{
+
+/*! Initialise the time source. Called by InitAllOther().
+ */
+void InitTimeSource( void );
+
+/*! The current time, in microseconds since InitTimeSource() (on the host,
+ * since the simulation was reset). It never goes backwards, and at 64 bits
+ * it never wraps.
+ */
+unsigned long long TimeNowMicrosec( void );
+
+/*! The current time in nanoseconds, on the same clock as TimeNowMicrosec().
+ * Its resolution is one system clock cycle (12.5 ns) on the Tiva, and 1 ns
+ * on the host. For measuring short intervals.
+ */
+unsigned long long TimeNowNanosec( void );
+
+/*! Wait a specified number of microseconds.
+ *
+ * \param [in] wait_microsecs The time (in microseconds) to delay.
+ *
+ * The deadline is taken on entry and the wait is a single busy-wait on
+ * the clock, shortened by the calibrated cost of the call itself, so the
+ * error does not grow with the length of the wait. Timers which fall due
+ * during the wait are run: by the timer interrupt on the Tiva, or in
+ * deadline order by the virtual clock on the host.
+ */
+void TimeWaitMicrosec( long int wait_microsecs );
+
+/*! Wait until TimeNowMicrosec() reaches \a deadline_us. Returns at once if
+ * it already has. Waiting for successive deadlines gives a period which
+ * does not drift, however long the work between them takes.
+ */
+void TimeWaitUntilMicrosec( unsigned long long deadline_us );
+
+#define TIME_SELF_TEST_DELAYS	7	//!< 1 us to 1 s, in decades.
+
+/*! The result of timing one delay.
+ */
+typedef struct {
+	long	delay_us;	//!< The delay asked for.
+	long	error_ns;	//!< How much longer it took (negative if shorter).
+} TimeDelayError;
+
+/*! Measure the error of TimeWaitMicrosec() from 1 us to 1 s.
+ *
+ * \param [out] results TIME_SELF_TEST_DELAYS results, shortest first.
+ * \return The largest error, in nanoseconds, either way.
+ *
+ * Each delay is timed with TimeNowNanosec(), less the cost of reading it.
+ * This takes just over 1.1 s (of simulated time, on the host).
+ */
+long TimeDelaySelfTest( TimeDelayError results[ TIME_SELF_TEST_DELAYS ] );
+
+//@}
+// End of Clock and delays
+
+//! \name Software timers
+//@{
+
+/*! Start (or restart) a one-shot timer.
+ *
+ * \param [in] timer The timer. If it is already running it is restarted.
+ * \param [in] delay_us When it should fire, in microseconds from now.
+ * \param [in] callback The function to call. On the Tiva this is called
+ * 		from the timer interrupt, so it must be short.
+ */
+void TimerStart( SoftTimer *timer, unsigned long delay_us, void (*callback)( void ) );
+
+/*! Stop a timer. Harmless if it is not running.
+ */
+void TimerStop( SoftTimer *timer );
+
+/*! Non-zero if the timer is running (started and not yet fired or stopped).
+ */
+int TimerIsActive( const SoftTimer *timer );
+
+/*! The deadline of the earliest running timer.
+ *
+ * \param [out] deadline_us The deadline, in microseconds.
+ * \return Non-zero if any timer is running; otherwise \a deadline_us
+ * 		is unchanged.
+ */
+int TimerNextDeadline( unsigned long long *deadline_us );
+
+/*! Run every timer whose deadline is at or before \a now_us, earliest first.
+ *
+ * This is called by the time source implementations, not by the rest of
+ * the program. A callback may start timers, including its own.
+ */
+void TimerRunDue( unsigned long long now_us );
+
+/*! Stop all timers. Used when the host simulation is reset.
+ */
+void TimerStopAll( void );
+
+//@}
+// End of Software timers
+
+//! \name Tickless idle
+//@{
+
+#define TIME_DEEP_SLEEP_MIN_US	10000	/* Sleep deeply only if nothing is
+				 * due for this long: waking from deep sleep costs
+				 * the PLL re-locking. */
+
+/*! Sleep until the next interrupt: a key, or the next software timer.
+ *
+ * Call this with interrupts disabled (inside StartCritical()), having
+ * checked that no work is pending, and call EndCritical() after it: the
+ * interrupt which wakes the processor is then taken. Checking and sleeping
+ * with interrupts disabled means an interrupt between the two cannot be
+ * slept through.
+ *
+ * While idle there is no tick. On the Tiva, SysTick is stopped and Timer 2A
+ * is programmed to fire once, at the earliest timer deadline. If that is at
+ * least TIME_DEEP_SLEEP_MIN_US away (or there is none, so only a key can
+ * wake it), and nothing holds it awake (TimeHoldAwake()), the processor
+ * enters deep sleep on the 16 MHz PIOSC; on waking
+ * it waits for the PLL and corrects the clock for the slower count while
+ * asleep. Otherwise it enters ordinary sleep. On the host, simulated time
+ * simply jumps to the deadline.
+ */
+void TimeIdle( void );
+
+/*! Hold off deep sleep, or release a hold.
+ *
+ * \param [in] hold Non-zero to add a hold, 0 to release one.
+ *
+ * While any hold remains, TimeIdle() uses only ordinary sleep, in which the
+ * peripherals keep the full system clock. The flash log holds it while the
+ * flash controller is busy.
+ */
+void TimeHoldAwake( int hold );
+
+/*! Residency counters: where the time went since InitTimeSource() or
+ * TimeResetIdleStats().
+ */
+typedef struct {
+	unsigned long	sleeps;		//!< Calls of TimeIdle() which slept,
+	unsigned long	deep_sleeps;	//!< of which this many deeply.
+	unsigned long long	asleep_us;	//!< Time asleep in TimeIdle(),
+	unsigned long long	deep_asleep_us;	//!< of which this much deeply.
+	unsigned long long	awake_us;	//!< Time running.
+} TimeIdleStats;
+
+/*! Get the residency counters.
+ */
+void TimeGetIdleStats( TimeIdleStats *stats );
+
+/*! Zero the residency counters.
+ */
+void TimeResetIdleStats( void );
+
+/*! Sleep until an interrupt or \a deadline_us (if not 0), deeply if \a deep.
+ *
+ * This is called by TimeIdle(), and is provided by each time source
+ * implementation, like TimerRunDue() it is not for the rest of the program.
+ */
+void TimeSourceSleep( const unsigned long long *deadline_us, int deep );
+
+//@}
+// End of Tickless idle
+
+//! \name Critical sections
+//@{
+
+/*! Disable interrupts, returning the previous state for EndCritical().
+ *
+ * On the Tiva these are in startup.s; on the host (which has no
+ * interrupts) they do nothing.
+ */
+long StartCritical( void );
+void EndCritical( long sr );	//!< \copydoc StartCritical
+
+//@}
+// End of Critical sections
+
+#endif // of #ifndef TIME_SOURCE_H
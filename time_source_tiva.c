@@ -0,0 +1,225 @@
+/* time_source_tiva.c
+ *
+ * Tiva implementation of time_source.h.
+ *
+ * The clock is Wide Timer 0, concatenated into one 64-bit timer counting up
+ * at the system clock from InitTimeSource(). It is free-running and at
+ * 80 MHz would take over 7000 years to wrap, so the clock is monotonic and
+ * has a resolution of one cycle. Delays busy-wait on it until a deadline
+ * taken on entry, less the cost of a call (measured when the time source
+ * is initialised), so their error is the same for 1 us as for 1 s.
+ * SysTick_Wait() counted one microsecond per call instead, adding the call
+ * overhead to every microsecond.
+ *
+ * Timer 2A runs periodically with a TIME_TICK_US period while the program
+ * runs: its interrupt runs the software timers which have fallen due. In
+ * TimeIdle() the tick is suppressed: Timer 2A is made one-shot, set to
+ * fire at the next deadline, and SysTick is stopped. In deep sleep the
+ * timers count the 16 MHz PIOSC rather than the 80 MHz PLL, so the wake-up
+ * time is set in PIOSC cycles, and on waking the clock is advanced by the
+ * cycles that the slower count missed. Only the count from WFI to waking
+ * is slow: the set-up before it and the PLL relock after it run at 80 MHz,
+ * so the clock is read either side of WFI alone, less the cost of the
+ * reads (measured when the time source is initialised).
+ *
+ * For documentation, see the corresponding .h file.
+ */
+
+#include "time_source.h"
+
+// =========================== CONSTANTS ============================
+
+#define TIME_TICK_US		1000	// Timer tick period, which is the timer resolution.
+#define CLOCKS_PER_MICROSEC	80	// 80 MHz system clock, see PLL_Init().
+#define DEEP_CLOCKS_PER_MICROSEC	16	// 16 MHz PIOSC in deep sleep.
+#define TICK_RELOAD		(TIME_TICK_US * CLOCKS_PER_MICROSEC - 1)
+
+// Timer 2A (datasheet page 722 onwards, base 0x4003.2000):
+#define SYSCTL_RCGCTIMER_R	(*((volatile unsigned long *)0x400FE604))
+#define TIMER2_CFG_R		(*((volatile unsigned long *)0x40032000))
+#define TIMER2_TAMR_R		(*((volatile unsigned long *)0x40032004))
+#define TIMER2_CTL_R		(*((volatile unsigned long *)0x4003200C))
+#define TIMER2_IMR_R		(*((volatile unsigned long *)0x40032018))
+#define TIMER2_ICR_R		(*((volatile unsigned long *)0x40032024))
+#define TIMER2_TAILR_R		(*((volatile unsigned long *)0x40032028))
+#define TIMER2_TAPR_R		(*((volatile unsigned long *)0x40032038))
+
+// Wide Timer 0 (same register layout, base 0x4003.6000):
+#define SYSCTL_RCGCWTIMER_R	(*((volatile unsigned long *)0x400FE65C))
+#define WTIMER0_CFG_R		(*((volatile unsigned long *)0x40036000))
+#define WTIMER0_TAMR_R		(*((volatile unsigned long *)0x40036004))
+#define WTIMER0_CTL_R		(*((volatile unsigned long *)0x4003600C))
+#define WTIMER0_TAILR_R		(*((volatile unsigned long *)0x40036028))
+#define WTIMER0_TBILR_R		(*((volatile unsigned long *)0x4003602C))
+#define WTIMER0_TAV_R		(*((volatile unsigned long *)0x40036050))	// Low 32 bits.
+#define WTIMER0_TBV_R		(*((volatile unsigned long *)0x40036054))	// High 32 bits.
+
+// NVIC: Timer 2A is interrupt 23.
+#define NVIC_EN0_R		(*((volatile unsigned long *)0xE000E100))
+#define NVIC_PRI5_R		(*((volatile unsigned long *)0xE000E414))
+
+// Sleep control:
+#define NVIC_ST_CTRL_R		(*((volatile unsigned long *)0xE000E010))	// SysTick
+#define NVIC_SYS_CTRL_R		(*((volatile unsigned long *)0xE000ED10))	// SCR, bit 2 SLEEPDEEP
+#define SYSCTL_DSLPCLKCFG_R	(*((volatile unsigned long *)0x400FE144))
+#define SYSCTL_PLLSTAT_R	(*((volatile unsigned long *)0x400FE168))
+#define SYSCTL_DCGCTIMER_R	(*((volatile unsigned long *)0x400FE804))
+#define SYSCTL_DCGCGPIO_R	(*((volatile unsigned long *)0x400FE808))
+#define SYSCTL_DCGCWTIMER_R	(*((volatile unsigned long *)0x400FE85C))
+
+extern void EnableInterrupts( void );	// In startup.s
+extern void WaitForInterrupt( void );	// In startup.s
+
+static unsigned long	wait_overhead = 0;	// Cycles a call adds to a delay.
+static unsigned long	read_overhead = 0;	/* Cycles counted between two
+						 * back-to-back reads. */
+static unsigned long long	deep_sleep_correction = 0;	/* Cycles the count
+						 * missed in deep sleep. */
+
+// =========================== FUNCTIONS ============================
+
+static unsigned long long CountedCycles( void )
+// Wide Timer 0's count.
+{
+	unsigned long	high, low;
+
+	do { // Re-read if the low half carried between the reads.
+		high = WTIMER0_TBV_R;
+		low = WTIMER0_TAV_R;
+	} while (WTIMER0_TBV_R != high);
+	return ((unsigned long long)high << 32) | low;
+} // CountedCycles
+
+static unsigned long long Cycles( void )
+// System clock cycles since InitTimeSource().
+{
+	return CountedCycles() + deep_sleep_correction;
+} // Cycles
+
+static void WaitUntilCycles( unsigned long long deadline )
+{
+	while (Cycles() < deadline)
+		;
+} // WaitUntilCycles
+
+void InitTimeSource( void )
+{
+	volatile unsigned long delay;
+	unsigned long long	start;
+
+	SYSCTL_RCGCWTIMER_R |= 0x01;        // activate Wide Timer 0
+	delay = SYSCTL_RCGCWTIMER_R;        // delay
+	WTIMER0_CTL_R = 0x00;               // disable during setup
+	WTIMER0_CFG_R = 0x00;               // 64-bit (concatenated) mode
+	WTIMER0_TAMR_R = 0x12;              // periodic, up-count
+	WTIMER0_TAILR_R = 0xFFFFFFFF;       // count through all 64 bits
+	WTIMER0_TBILR_R = 0xFFFFFFFF;
+	WTIMER0_CTL_R = 0x01;               // enable; starts from zero
+
+	SYSCTL_RCGCTIMER_R |= 0x04;         // activate Timer 2
+	delay = SYSCTL_RCGCTIMER_R;         // delay
+	TIMER2_CTL_R = 0x00;                // disable Timer 2A during setup
+	TIMER2_CFG_R = 0x00;                // 32-bit mode
+	TIMER2_TAMR_R = 0x02;               // periodic, down-count
+	TIMER2_TAILR_R = TICK_RELOAD;       // one tick
+	TIMER2_TAPR_R = 0;                  // no prescale
+	TIMER2_ICR_R = 0x01;                // clear timeout flag
+	TIMER2_IMR_R = 0x01;                // arm timeout interrupt
+	NVIC_PRI5_R = (NVIC_PRI5_R & 0x00FFFFFF) | 0x40000000; // priority 2
+	NVIC_EN0_R = 1 << 23;               // enable interrupt 23 in NVIC
+	TIMER2_CTL_R = 0x01;                // enable Timer 2A
+
+	SYSCTL_DSLPCLKCFG_R = 0x00000010;   // deep sleep on PIOSC, undivided
+	SYSCTL_DCGCWTIMER_R |= 0x01;        // the clock runs in deep sleep,
+	SYSCTL_DCGCTIMER_R |= 0x04;         // so does the wake-up timer,
+	SYSCTL_DCGCGPIO_R |= 0x18;          // and the keypad ports D and E
+	deep_sleep_correction = 0;
+	TimeResetIdleStats();
+
+	/* Calibrate: time the shortest delay with no compensation. Whatever
+	 * it takes beyond one microsecond is the cost of the call. */
+	wait_overhead = 0;
+	start = Cycles();
+	TimeWaitMicrosec( 1 );
+	wait_overhead = (unsigned long)(Cycles() - start) - CLOCKS_PER_MICROSEC;
+	if (wait_overhead > CLOCKS_PER_MICROSEC)
+		wait_overhead = CLOCKS_PER_MICROSEC; // Interrupted: be cautious.
+	start = CountedCycles();
+	read_overhead = (unsigned long)(CountedCycles() - start);
+
+	EnableInterrupts();
+} // InitTimeSource
+
+void Timer2A_Handler( void )
+{
+	TIMER2_ICR_R = 0x01;  // Acknowledge the timeout
+	TimerRunDue( TimeNowMicrosec() );
+} // Timer2A_Handler
+
+unsigned long long TimeNowMicrosec( void )
+{
+	return Cycles() / CLOCKS_PER_MICROSEC;
+} // TimeNowMicrosec
+
+unsigned long long TimeNowNanosec( void )
+{
+	return Cycles() * 25 / 2;  // 12.5 ns per cycle
+} // TimeNowNanosec
+
+void TimeWaitMicrosec( long int wait_microsecs )
+{
+	unsigned long long	start = Cycles();
+	unsigned long long	length;
+
+	if (wait_microsecs <= 0)
+		return;
+	length = (unsigned long long)wait_microsecs * CLOCKS_PER_MICROSEC;
+	WaitUntilCycles( start + length - (length > wait_overhead ? wait_overhead : 0) );
+} // TimeWaitMicrosec
+
+void TimeWaitUntilMicrosec( unsigned long long deadline_us )
+{
+	WaitUntilCycles( deadline_us * CLOCKS_PER_MICROSEC );
+} // TimeWaitUntilMicrosec
+
+void TimeSourceSleep( const unsigned long long *deadline_us, int deep )
+{
+	unsigned long	rate = deep ? DEEP_CLOCKS_PER_MICROSEC : CLOCKS_PER_MICROSEC;
+	unsigned long	systick = NVIC_ST_CTRL_R;
+	unsigned long long	asleep;	// Cycles counted from WFI to waking.
+
+	NVIC_ST_CTRL_R = 0;                 // stop SysTick
+	TIMER2_CTL_R = 0x00;                // stop the tick
+	if (deadline_us) {                  // one shot at the deadline
+		unsigned long long	now_us = TimeNowMicrosec();
+		unsigned long long	wait_us = (*deadline_us > now_us) ? *deadline_us - now_us : 1;
+		if (wait_us > 0xFFFFFFFF / rate)
+			wait_us = 0xFFFFFFFF / rate; // wake early, sleep again
+		TIMER2_TAMR_R = 0x01;
+		TIMER2_TAILR_R = (unsigned long)wait_us * rate - 1;
+		TIMER2_CTL_R = 0x01;
+	}
+	if (deep)
+		NVIC_SYS_CTRL_R |= 0x04;    // SLEEPDEEP
+	asleep = CountedCycles();
+	WaitForInterrupt();
+	asleep = CountedCycles() - asleep;
+	NVIC_SYS_CTRL_R &= ~0x04;
+	if (deep) {
+		while ((SYSCTL_PLLSTAT_R & 0x01) == 0)
+			;                   // wait for the PLL to lock again
+		/* Only the PIOSC part was slow: if an interrupt was already
+		 * pending, WFI did not sleep at all. */
+		if (asleep > read_overhead)
+			deep_sleep_correction += (asleep - read_overhead)
+				* (CLOCKS_PER_MICROSEC / DEEP_CLOCKS_PER_MICROSEC - 1);
+	}
+
+	/* Back to the periodic tick. If the one-shot fired its flag is still
+	 * set, so its interrupt is taken after EndCritical(). */
+	TIMER2_CTL_R = 0x00;
+	TIMER2_TAMR_R = 0x02;
+	TIMER2_TAILR_R = TICK_RELOAD;
+	TIMER2_CTL_R = 0x01;
+	NVIC_ST_CTRL_R = systick;           // restore SysTick
+} // TimeSourceSleep
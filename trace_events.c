@@ -0,0 +1,121 @@
+/* trace_events.c
+ *
+ * A RAM ring of span begins and ends, and its export as Chrome trace-event
+ * JSON.
+ *
+ * For documentation, see the corresponding .h file.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "time_source.h"
+#include "trace_events.h"
+
+typedef struct {
+	unsigned long long	ns;	// TimeNowNanosec().
+	const char	*name;
+	long	value;		// Negative for none.
+	char	phase;		// 'B' or 'E'.
+	unsigned char	track;
+} TraceRecord;
+
+static TraceRecord	ring[ TRACE_EVENT_RECORDS ];
+static unsigned long	n_recorded = 0;	// Since the reset; the newest is at (n_recorded - 1) % TRACE_EVENT_RECORDS.
+volatile unsigned char	trace_track = TRACE_TRACK_MAIN;
+
+static const char	*const track_names[ TRACE_TRACKS ] = {
+	"main", "Keypad task", "Flash task", "Display task", "LCD", "Flash"
+};
+
+void TraceEventsReset( void )
+{
+	long	sr = StartCritical();
+
+	n_recorded = 0;
+	trace_track = TRACE_TRACK_MAIN;
+	EndCritical( sr );
+} // TraceEventsReset
+
+void TraceEvent( char phase, const char *name, int track, long value )
+{
+	long	sr = StartCritical(); // From the main program and the tasks.
+	TraceRecord	*record = &ring[ n_recorded & (TRACE_EVENT_RECORDS - 1) ];
+
+	record->ns = TimeNowNanosec();
+	record->name = name;
+	record->value = value;
+	record->phase = phase;
+	record->track = (unsigned char)track;
+	n_recorded ++;
+	EndCritical( sr );
+} // TraceEvent
+
+unsigned long TraceEventsRecorded( void )
+{
+	return n_recorded;
+} // TraceEventsRecorded
+
+static unsigned long Append( char *text, unsigned long size, unsigned long length,
+			     const char *line )
+// Add a line if it fits, with room for the null.
+{
+	unsigned long	n = strlen( line );
+
+	if (length + n < size) {
+		memcpy( text + length, line, n + 1 );
+		length += n;
+	}
+	return length;
+} // Append
+
+static void Event( char *line, const char *name, char phase, int track,
+		   unsigned long long ns, long value )
+// One trace event, with the comma which separates it from the one before.
+{
+	int	n = sprintf( line, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"pid\":1,\"tid\":%d,"
+			     "\"ts\":%llu.%03u", name, phase, track, ns / 1000, (unsigned)(ns % 1000) );
+
+	if (value >= 0)
+		n += sprintf( line + n, ",\"args\":{\"value\":%ld}", value );
+	sprintf( line + n, "}" );
+} // Event
+
+unsigned long TraceEventsExport( char *text, unsigned long size )
+{
+	char	line[ 160 ];
+	unsigned long	length = 0, first, i, room = size - sizeof "\n]}\n";
+	unsigned long long	last_ns = 0;
+	int	depth[ TRACE_TRACKS ] = { 0 }, track;
+
+	if (size < sizeof "\n]}\n")
+		return 0;
+	text[0] = '\0';
+	length = Append( text, room, length,
+			 "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"
+			 "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"calculator\"}}" );
+	for (track = 0; track < TRACE_TRACKS; track++) {
+		sprintf( line, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+			 "\"args\":{\"name\":\"%s\"}}", track, track_names[ track ] );
+		length = Append( text, room, length, line );
+	}
+
+	first = (n_recorded > TRACE_EVENT_RECORDS) ? n_recorded - TRACE_EVENT_RECORDS : 0;
+	for (i = first; i < n_recorded; i++) {
+		const TraceRecord	*record = &ring[ i & (TRACE_EVENT_RECORDS - 1) ];
+
+		if (record->phase == 'E' && depth[ record->track ] == 0)
+			continue; // Its begin was overwritten, or there was none.
+		depth[ record->track ] += (record->phase == 'B') ? 1 : -1;
+		Event( line, record->name, record->phase, record->track, record->ns, record->value );
+		if (Append( text, room, length, line ) == length)
+			break; // Full: the rest is left out.
+		length += strlen( line );
+		last_ns = record->ns;
+	}
+	for (track = 0; track < TRACE_TRACKS; track++) // End what is still open.
+		for (; depth[ track ] > 0; depth[ track ]--) {
+			Event( line, "", 'E', track, last_ns, -1 );
+			length = Append( text, room, length, line );
+		}
+	return Append( text, size, length, "\n]}\n" );
+} // TraceEventsExport
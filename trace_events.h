@@ -0,0 +1,98 @@
+/*! \file trace_events.h
+ * Spans of what the firmware was doing when, in simulated time, written as
+ * Chrome trace-event JSON for chrome://tracing or Perfetto.
+ *
+ * Histograms and the latency benchmark say how long things take; a trace
+ * shows their order: an LCD clear on the bus while the keypad task scans,
+ * or the flash's operations under a cycle of main(). Built with
+ * -DTRACE_EVENTS, these are traced:
+ * 	- on the main program's track: ReadAndEchoInput(), each
+ * 		SendDisplayByte() and ClearDisplay() (which queue the bytes),
+ * 		CalculateAnswer() and its stages, WaitMicrosec() and
+ * 		Done_Check();
+ * 	- on each task's track: each event the task handles, with its
+ * 		signal;
+ * 	- on the LCD's track: each byte, from its first nibble on the bus
+ * 		until the LCD is ready for the next, with the byte;
+ * 	- on the flash's track: each word programmed or page erased, until
+ * 		it completes.
+ *
+ * The host's simulated time advances only for the hardware (bus accesses
+ * and waits), so the code between them, e.g. CalculateAnswer()'s stages,
+ * takes no time: its spans show order, not cost. Without -DTRACE_EVENTS
+ * the macros below are empty, and trace_events.c need not be linked.
+ *
+ * Each begin or end is a record in a ring of TRACE_EVENT_RECORDS, the
+ * oldest overwritten once it is full, so a session of any length can be
+ * traced: its end is kept. TraceEventsExport() leaves out the ends whose
+ * begins were overwritten, and ends the spans still open at the time of
+ * the export. On the host, the calculator (main() with hal_host.c) writes
+ * it to TRACE_EVENTS_FILE when it exits.
+ */
+
+#ifndef TRACE_EVENTS_H
+#define TRACE_EVENTS_H
+
+#ifndef TRACE_EVENT_RECORDS
+#define TRACE_EVENT_RECORDS	65536	// Must be a power of two.
+#endif
+#define TRACE_EVENTS_EXPORT_SIZE	(128UL * TRACE_EVENT_RECORDS + 1024)
+#define TRACE_EVENTS_FILE	"trace.json"
+
+/*! The tracks, shown as threads.
+ */
+typedef enum {
+	TRACE_TRACK_MAIN,	//!< The main program.
+	TRACE_TRACK_TASK,	//!< The first task's; TaskId after it.
+	TRACE_TRACK_LCD = TRACE_TRACK_TASK + 3,	//!< The LCD's bytes.
+	TRACE_TRACK_FLASH,	//!< The flash's operations.
+	TRACE_TRACKS
+} TraceTrack;
+
+/*! The track of the code running now: set by the scheduler while a task
+ * runs.
+ */
+extern volatile unsigned char	trace_track;
+
+/*! Forget every record, and go back to the main program's track.
+ */
+void TraceEventsReset( void );
+
+/*! Record a begin ('B') or an end ('E') of a span, now. Called through the
+ * macros below.
+ *
+ * \param [in] phase 'B' or 'E'.
+ * \param [in] name A string constant, which is not copied.
+ * \param [in] track A TraceTrack.
+ * \param [in] value Shown with the span, unless negative.
+ */
+void TraceEvent( char phase, const char *name, int track, long value );
+
+/*! The records taken since the reset, including those overwritten.
+ */
+unsigned long TraceEventsRecorded( void );
+
+/*! Write the trace as JSON, oldest first.
+ *
+ * \param [out] text Where to write it.
+ * \param [in] size The size of \a text: TRACE_EVENTS_EXPORT_SIZE is
+ * 		enough. If it is not, the newer records are left out.
+ * \return The length written, without the terminating null.
+ */
+unsigned long TraceEventsExport( char *text, unsigned long size );
+
+#ifdef TRACE_EVENTS
+#define TraceBegin( name )		TraceEvent( 'B', name, trace_track, -1 )
+#define TraceEnd( name )		TraceEvent( 'E', name, trace_track, -1 )
+#define TraceBeginOn( track, name, value )	TraceEvent( 'B', name, track, value )
+#define TraceEndOn( track, name )	TraceEvent( 'E', name, track, -1 )
+#define TraceSetTrack( track )		(trace_track = (track))
+#else
+#define TraceBegin( name )		((void)0)
+#define TraceEnd( name )		((void)0)
+#define TraceBeginOn( track, name, value )	((void)0)
+#define TraceEndOn( track, name )	((void)0)
+#define TraceSetTrack( track )		((void)0)
+#endif
+
+#endif // of #ifndef TRACE_EVENTS_H
@@ -0,0 +1,235 @@
+/* ui_snapshot.c
+ *
+ * The display shadow, and snapshots of it and the input in flash.
+ *
+ * For documentation, see the corresponding .h file.
+ */
+
+#include <string.h>
+#include "time_source.h"
+#include "flash_log.h"
+#include "answer_store.h"
+#include "low_level_funcs_tiva.h"
+#include "Welcome.h"
+#include "ui_snapshot.h"
+
+#define LINE_LENGTH	16
+#define DDRAM_LINE	40	// Characters a line holds, LINE_LENGTH of them shown.
+#define NOT_EDITING	0xFF
+#define COMMIT_RETRY_US	1000	// If the flash is still busy.
+
+typedef struct {
+	unsigned char	version;	// UI_SNAPSHOT_VERSION
+	unsigned char	cursor_line, cursor_pos;	// From 1; the position may be off the screen.
+	unsigned char	cursor_on;
+	unsigned char	input_length;	// NOT_EDITING if no input is in progress.
+	unsigned char	shift;
+	unsigned char	input_cursor, input_first;	/* The cursor's place in the
+					 * input, and the first character shown. */
+	char	lines[2][ LINE_LENGTH ];	// As shown.
+	double	answer;
+	char	input[ UI_SNAPSHOT_MAX_INPUT ];
+} UiSnapshot;	// 112 bytes, a flash log value.
+
+static struct {	// The shadow of the LCD.
+	char	ddram[2][ DDRAM_LINE ];
+	unsigned char	line, address;	// The address counter: line from 1, address from 0.
+	unsigned char	shift;		// The display shift, 0 to DDRAM_LINE - 1.
+	unsigned char	cursor_on;
+} lcd = { { "                                        ",
+	    "                                        " }, 1, 0, 0, 0 };
+static UiSnapshot	now = {	// The input state; the screen is taken from the shadow.
+	UI_SNAPSHOT_VERSION, 1, 1, 0, NOT_EDITING, 0, 0, 0, { "", "" }, 0.0, "" };
+static UiSnapshot	written;	// The newest in flash, or being written.
+static FlashLog	snapshot_log;
+static SoftTimer	idle_timer;
+static int	capturing = 0;		// Once restored.
+static int	restored = 0;		// A snapshot was found.
+static int	keep_screen = 0, resume_input = 0;	// Left for the high level.
+
+static void Take( UiSnapshot *snapshot )
+// The input state, with the screen as the shadow shows it.
+{
+	int	line, i;
+
+	*snapshot = now;
+	for (line = 0; line < 2; line++)
+		for (i = 0; i < LINE_LENGTH; i++)
+			snapshot->lines[ line ][i] = lcd.ddram[ line ][ (i + lcd.shift) % DDRAM_LINE ];
+	snapshot->cursor_line = lcd.line;
+	snapshot->cursor_pos = (lcd.address + DDRAM_LINE - lcd.shift) % DDRAM_LINE + 1;
+	snapshot->cursor_on = lcd.cursor_on;
+	snapshot->answer = AnswerStoreGet();
+} // Take
+
+static void Commit( void )
+// Idle timer callback: start writing the snapshot, if it has changed.
+{
+	UiSnapshot	snapshot;
+
+	if (FlashLogBusy( 0 )) { // Do not wait for it in an interrupt.
+		TimerStart( &idle_timer, COMMIT_RETRY_US, Commit );
+		return;
+	}
+	Take( &snapshot );
+	if (memcmp( &snapshot, &written, sizeof snapshot ) == 0)
+		return;
+	written = snapshot;
+	FlashLogAppendStart( &snapshot_log, &written );
+} // Commit
+
+static void Changed( void )
+{
+	long	sr;
+
+	if (! capturing)
+		return;
+	sr = StartCritical();
+	TimerStart( &idle_timer, UI_SNAPSHOT_IDLE_US, Commit );
+	EndCritical( sr );
+} // Changed
+
+// ------------------------ Display shadow ------------------------
+
+void UiShadowClear( void )
+{
+	memset( lcd.ddram, ' ', sizeof lcd.ddram );
+	lcd.line = 1;
+	lcd.address = lcd.shift = 0;
+	Changed();
+} // UiShadowClear
+
+void UiShadowSetPosition( short int line, short int char_pos )
+{
+	if ((line < 1) || (line > 2))  // As SetPrintPosition() does
+		line = 1;
+	if ((char_pos < 1) || (char_pos > DDRAM_LINE))
+		char_pos = 1;
+	lcd.line = (unsigned char)line;
+	lcd.address = (unsigned char)(char_pos - 1);
+} // UiShadowSetPosition
+
+void UiShadowPrintChar( char ch )
+{
+	lcd.ddram[ lcd.line - 1 ][ lcd.address ] = ch;
+	if (++lcd.address == DDRAM_LINE) { // On to the start of the other line.
+		lcd.address = 0;
+		lcd.line = 3 - lcd.line;
+	}
+	Changed();
+} // UiShadowPrintChar
+
+void UiShadowShift( short int places )
+{
+	lcd.shift = (unsigned char)((lcd.shift + places % DDRAM_LINE + DDRAM_LINE) % DDRAM_LINE);
+	Changed();
+} // UiShadowShift
+
+void UiShadowCursor( short int on )
+{
+	lcd.cursor_on = (on != 0);
+	Changed();
+} // UiShadowCursor
+
+void UiShadowGetLine( short int line, char text[17] )
+{
+	UiSnapshot	snapshot;
+
+	Take( &snapshot );
+	memcpy( text, snapshot.lines[ (line == 2) ? 1 : 0 ], LINE_LENGTH );
+	text[ LINE_LENGTH ] = '\0';
+} // UiShadowGetLine
+
+// ------------------------ Snapshots ------------------------
+
+void UiSnapshotSetInput( const InputEditor *editor, int shift )
+{
+	int	i, length = 0, cursor = 0, first = 0;
+
+	if (editor && EditorLength( editor ) > UI_SNAPSHOT_MAX_INPUT)
+		editor = 0; /* Too long to keep whole: resuming only its start 
+			     * would make it another expression. */
+	if (editor) {
+		length = EditorLength( editor );
+		cursor = EditorCursor( editor );
+		first = EditorFirstShown( editor );
+	}
+	memset( now.input, 0, sizeof now.input );
+	for (i = 0; i < length; i++)
+		now.input[i] = EditorCharAt( editor, i );
+	now.input_length = editor ? (unsigned char)length : NOT_EDITING;
+	now.input_cursor = (unsigned char)cursor;
+	now.input_first = (unsigned char)first;
+	now.shift = (shift != 0);
+	Changed();
+} // UiSnapshotSetInput
+
+int UiSnapshotOpen( void )
+{
+	TimerStop( &idle_timer );
+	capturing = keep_screen = resume_input = 0;
+	memset( lcd.ddram, ' ', sizeof lcd.ddram );  // A new LCD is blank.
+	lcd.line = 1;
+	lcd.address = lcd.shift = lcd.cursor_on = 0;
+	UiSnapshotSetInput( 0, 0 );
+	restored = FlashLogOpen( &snapshot_log, UI_SNAPSHOT_FLASH_ADDRESS,
+				 UI_SNAPSHOT_FLASH_PAGES, &written, sizeof written )
+		   && written.version == UI_SNAPSHOT_VERSION;
+	if (! restored)
+		memset( &written, 0, sizeof written ); // Clean boot.
+	return restored;
+} // UiSnapshotOpen
+
+void UiSnapshotRestore( void )
+{
+	int	line, i;
+
+	if (restored) {
+		for (line = 1; line <= 2; line++) {
+			SetPrintPosition( line, 1 );
+			for (i = 0; i < LINE_LENGTH; i++)
+				PrintChar( written.lines[ line-1 ][i] );
+		}
+		SetDisplayAddress( written.cursor_line, written.cursor_pos - 1 );
+		TurnCursorOnOff( written.cursor_on );
+		now = written;
+		keep_screen = 1;
+		resume_input = (written.input_length != NOT_EDITING);
+	}
+	capturing = 1;
+} // UiSnapshotRestore
+
+int UiSnapshotKeepScreen( double answer )
+{
+	int	keep = keep_screen && memcmp( &answer, &written.answer, sizeof answer ) == 0;
+	keep_screen = 0;
+	return keep;
+} // UiSnapshotKeepScreen
+
+int UiSnapshotResumeInput( char *input_buffer, int input_buffer_size,
+			   int *shift, int *cursor, int *first )
+{
+	int	length = now.input_length;
+
+	if (! resume_input)
+		return -1;
+	resume_input = 0;
+	if (length > input_buffer_size - 1)
+		length = input_buffer_size - 1;
+	memcpy( input_buffer, now.input, length );
+	input_buffer[ length ] = '\0';
+	*shift = now.shift;
+	*cursor = (now.input_cursor <= length) ? now.input_cursor : length;
+	*first = (now.input_first <= *cursor) ? now.input_first : *cursor;
+	return length;
+} // UiSnapshotResumeInput
+
+void UiSnapshotFlush( void )
+{
+	long	sr = StartCritical();
+	TimerStop( &idle_timer );
+	Commit();
+	EndCritical( sr );
+	while (TimerIsActive( &idle_timer ) || FlashLogBusy( &snapshot_log ))
+		WaitMicrosec( 10 );
+} // UiSnapshotFlush
@@ -0,0 +1,136 @@
+/*! \file ui_snapshot.h
+ * A snapshot of the calculator's screen and input, kept in flash so that
+ * after a power cycle the calculator comes back at the same screen.
+ *
+ * A snapshot holds
+ * 	- the 32 characters on the display, from a shadow copy of the
+ * 		LCD's DDRAM and display shift which the low-level display
+ * 		functions keep up to date;
+ * 	- the cursor position, and whether the cursor is shown;
+ * 	- whether ReadAndEchoInput() is part way through an input, and if
+ * 		so the input, where the cursor is in it, the part of it
+ * 		shown and the shift state. An input longer than
+ * 		UI_SNAPSHOT_MAX_INPUT characters is not kept: after a power
+ * 		cycle its screen is shown, but the next key starts afresh;
+ * 	- the last answer.
+ *
+ * It is 112 bytes, with a version number (UI_SNAPSHOT_VERSION), and is
+ * stored as one record of a \a flash_log, which adds a sequence number and
+ * a CRC. It is written once nothing on the screen has changed for
+ * UI_SNAPSHOT_IDLE_US, and only if it differs from the last one written,
+ * so a calculator left alone costs no flash writes. UiSnapshotFlush() writes
+ * it at once, for when power is about to be lost.
+ *
+ * At boot, InitFlash() calls UiSnapshotOpen() to read the newest valid
+ * snapshot while the LCD powers up, and once the LCD is ready
+ * UiSnapshotRestore() redraws it: two lines and the cursor, under 20 ms of
+ * LCD writes. If there is no snapshot, or it is of another version, the boot
+ * is clean. Snapshots are only taken from then on, so the welcome screens
+ * are never saved.
+ *
+ * Restoring leaves two things for the high level to pick up once:
+ * DisplayResult() does not redraw the restored screen for the restored
+ * answer (UiSnapshotKeepScreen()), and ReadAndEchoInput() carries on with
+ * a restored part-typed input (UiSnapshotResumeInput()).
+ */
+
+#ifndef UI_SNAPSHOT_H
+#define UI_SNAPSHOT_H
+
+#include "input_editor.h"
+
+#define UI_SNAPSHOT_VERSION	2
+#define UI_SNAPSHOT_MAX_INPUT	64	//!< Characters of a part-typed input kept.
+
+#ifndef UI_SNAPSHOT_IDLE_US
+#define UI_SNAPSHOT_IDLE_US	5000000	/* Write the snapshot once the
+				 * screen has not changed for this long. */
+#endif
+
+/*! Address in flash of the snapshot log, UI_SNAPSHOT_FLASH_PAGES pages
+ * ending just below the password log (so it needs PASSWORD_FLASH_ADDRESS
+ * from Welcome.h and FLASH_PAGE_SIZE from low_level_funcs_tiva.h).
+ *
+ * A snapshot takes a 128-byte slot, so a page holds 8, and one may be
+ * written after every UI_SNAPSHOT_IDLE_US of idle: far more often than an
+ * answer. The log is spread over as many pages as it takes to wear each
+ * page no faster than the answer log: an erase per 256 snapshots, about
+ * 3,900 erases a page per million snapshots (the TM4C123 is rated for
+ * 100,000). On 4 pages it would be 31,000.
+ */
+#define UI_SNAPSHOT_FLASH_ADDRESS	(PASSWORD_FLASH_ADDRESS \
+					 - UI_SNAPSHOT_FLASH_PAGES * FLASH_PAGE_SIZE)
+#define UI_SNAPSHOT_FLASH_PAGES	32	//!< With 8 snapshots a page, an erase per 256.
+
+//! \name Display shadow
+//@{
+
+/*! Called by the low-level display functions of the same names, so that
+ * the shadow holds what the LCD shows. Arguments are as theirs.
+ */
+void UiShadowClear( void );
+void UiShadowSetPosition( short int line, short int char_pos );	//!< \copydoc UiShadowClear
+void UiShadowPrintChar( char ch );				//!< \copydoc UiShadowClear
+void UiShadowShift( short int places );				//!< \copydoc UiShadowClear
+void UiShadowCursor( short int on );				//!< \copydoc UiShadowClear
+
+/*! Get a line of the shadow as it is shown, as SimLCDGetLine() does on
+ * the host.
+ *
+ * \param [in] line 1 or 2.
+ * \param [out] text The 16 characters and a trailing null.
+ */
+void UiShadowGetLine( short int line, char text[17] );
+
+//@}
+// End of Display shadow
+
+//! \name Snapshots
+//@{
+
+/*! Record the state of ReadAndEchoInput().
+ *
+ * \param [in] editor The input being edited, or 0 if it is finished.
+ * \param [in] shift Non-zero if Shift is active.
+ */
+void UiSnapshotSetInput( const InputEditor *editor, int shift );
+
+/*! Find the newest valid snapshot in flash. Called by InitFlash().
+ *
+ * \return 1 if there is one to restore, 0 for a clean boot.
+ */
+int UiSnapshotOpen( void );
+
+/*! Redraw the snapshot found by UiSnapshotOpen(), if any, and start taking
+ * snapshots. Called once the LCD is initialised.
+ */
+void UiSnapshotRestore( void );
+
+/*! Non-zero (once) if the screen was restored with \a answer as the last
+ * answer, so DisplayResult() should leave it as it is.
+ */
+int UiSnapshotKeepScreen( double answer );
+
+/*! Take (once) a part-typed input restored from the snapshot.
+ *
+ * \param [out] input_buffer The input, as a C string.
+ * \param [in] input_buffer_size Its size, including the trailing null.
+ * \param [out] shift The shift state.
+ * \param [out] cursor Where the cursor was in the input, from 0.
+ * \param [out] first The first character of the input that was shown.
+ * \return The length of the input, or -1 if none was restored.
+ *
+ * The restored screen shows the input unshifted, so if \a first is not 0
+ * the editor must redraw it (see EditorOpen()).
+ */
+int UiSnapshotResumeInput( char *input_buffer, int input_buffer_size,
+			   int *shift, int *cursor, int *first );
+
+/*! Write the snapshot now, if it has changed, and wait until it is in flash.
+ */
+void UiSnapshotFlush( void );
+
+//@}
+// End of Snapshots
+
+#endif // of #ifndef UI_SNAPSHOT_H
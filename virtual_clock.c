@@ -0,0 +1,119 @@
+/* virtual_clock.c
+ *
+ * Discrete-event virtual clock: the host implementation of time_source.h.
+ *
+ * For documentation, see the corresponding .h file and time_source.h.
+ */
+
+#include "time_source.h"
+#include "virtual_clock.h"
+
+static unsigned long long	now_ns = 0;
+static void	(*sleep_handler)( const unsigned long long *deadline_us ) = 0;
+static int	in_timers = 0;		// Depth of TimerRunDue() calls running.
+static void	(*pended)( void ) = 0;	// The software interrupt, if pending.
+
+static void RunPended( void )
+// Take the software interrupt, unless a timer callback is running.
+{
+	while (pended && ! in_timers) {
+		void	(*handler)( void ) = pended;
+		pended = 0;
+		handler();
+	}
+} // RunPended
+
+void VirtualClockReset( void )
+{
+	TimerStopAll();
+	now_ns = 0;
+	in_timers = 0;
+	pended = 0;
+} // VirtualClockReset
+
+unsigned long long VirtualClockNowNanosec( void )
+{
+	return now_ns;
+} // VirtualClockNowNanosec
+
+void VirtualClockAdvanceTo( unsigned long long when_ns )
+{
+	unsigned long long	deadline_us;
+
+	/* Step from one timer deadline to the next, so that each callback
+	 * sees the time at which it was due and any timers it starts are
+	 * run in their turn. */
+	while (TimerNextDeadline( &deadline_us ) && deadline_us * 1000 <= when_ns) {
+		if (deadline_us * 1000 > now_ns)
+			now_ns = deadline_us * 1000;
+		in_timers ++;
+		TimerRunDue( now_ns / 1000 );
+		in_timers --;
+		RunPended(); // Once the timer "interrupt" returns.
+	}
+	if (when_ns > now_ns)
+		now_ns = when_ns;
+} // VirtualClockAdvanceTo
+
+void VirtualClockAdvanceNanosec( unsigned long long nanosecs )
+{
+	VirtualClockAdvanceTo( now_ns + nanosecs );
+} // VirtualClockAdvanceNanosec
+
+void VirtualClockSetSleepHandler( void (*handler)( const unsigned long long *deadline_us ) )
+{
+	sleep_handler = handler;
+} // VirtualClockSetSleepHandler
+
+void VirtualClockPendInterrupt( void (*handler)( void ) )
+{
+	pended = handler;
+	RunPended();
+} // VirtualClockPendInterrupt
+
+// ------------------------ time_source functions ------------------------
+
+void InitTimeSource( void )
+{
+	TimeResetIdleStats();
+} // InitTimeSource, the clock starts at VirtualClockReset().
+
+unsigned long long TimeNowMicrosec( void )
+{
+	return now_ns / 1000;
+} // TimeNowMicrosec
+
+unsigned long long TimeNowNanosec( void )
+{
+	return now_ns;
+} // TimeNowNanosec
+
+void TimeWaitMicrosec( long int wait_microsecs )
+{
+	if (wait_microsecs > 0)
+		VirtualClockAdvanceNanosec( wait_microsecs * 1000ULL );
+} // TimeWaitMicrosec, exact: simulated calls take no time.
+
+void TimeWaitUntilMicrosec( unsigned long long deadline_us )
+{
+	VirtualClockAdvanceTo( deadline_us * 1000 );
+} // TimeWaitUntilMicrosec
+
+void TimeSourceSleep( const unsigned long long *deadline_us, int deep )
+{
+	(void)deep;
+	if (sleep_handler)
+		sleep_handler( deadline_us );
+	else if (deadline_us)
+		VirtualClockAdvanceTo( *deadline_us * 1000 );
+} // TimeSourceSleep, deep or not: the host has no clocks to change.
+
+long StartCritical( void )
+{
+	return 0;
+} // StartCritical, the host has no interrupts.
+
+void EndCritical( long sr )
+{
+	(void)sr;
+} // EndCritical
@@ -0,0 +1,55 @@
+/*! \file virtual_clock.h
+ * Discrete-event virtual clock: the host implementation of \a time_source.
+ *
+ * Simulated time only moves when something advances it: a delay
+ * (TimeWaitMicrosec()), or the simulated hardware charging the cost of a
+ * bus access. Advancing the clock runs every software timer which falls due
+ * on the way, earliest first, with the clock set to each timer's deadline
+ * while its callback runs. So a host run takes as long as the code takes to
+ * execute, not as long as the device would, yet still reports device time.
+ *
+ * Time is kept in nanoseconds so that single GPIO accesses can be charged;
+ * TimeNowMicrosec() rounds down.
+ */
+
+#ifndef VIRTUAL_CLOCK_H
+#define VIRTUAL_CLOCK_H
+
+/*! Set simulated time back to zero and stop all timers.
+ */
+void VirtualClockReset( void );
+
+/*! Current simulated time, in nanoseconds since VirtualClockReset().
+ */
+unsigned long long VirtualClockNowNanosec( void );
+
+/*! Advance simulated time, running any timers which fall due.
+ *
+ * \param [in] nanosecs The number of nanoseconds to advance.
+ */
+void VirtualClockAdvanceNanosec( unsigned long long nanosecs );
+
+/*! Advance simulated time to \a when_ns, running any timers which fall due.
+ * Does nothing if \a when_ns is not in the future.
+ */
+void VirtualClockAdvanceTo( unsigned long long when_ns );
+
+/*! Set what TimeIdle() does to sleep.
+ *
+ * \param [in] handler Called with the deadline in microseconds, or 0 if
+ * 		no timer is running. It should advance the clock until
+ * 		something would wake the processor. Without a handler the
+ * 		clock just advances to the deadline. The host simulator
+ * 		sets this, since it knows about keypad interrupts.
+ */
+void VirtualClockSetSleepHandler( void (*handler)( const unsigned long long *deadline_us ) );
+
+/*! Pend the lowest-priority interrupt, as PendSV is on the Tiva.
+ *
+ * \param [in] handler Its handler. This is called at once, unless a timer
+ * 		callback (the host's equivalent of an interrupt handler) is
+ * 		running, when it is called as soon as that returns.
+ */
+void VirtualClockPendInterrupt( void (*handler)( void ) );
+
+#endif // of #ifndef VIRTUAL_CLOCK_H